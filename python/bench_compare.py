@@ -0,0 +1,64 @@
+# Compare benchmark results (from `make bench`) against a stored baseline, and
+# flag the cases for which the throughput has regressed.
+#
+# Usage: python3 python/bench_compare.py {baseline.json} {results.json} [threshold]
+#
+# The threshold is the allowed relative drop in MLUPS (default 0.05, so 5%).
+# The exit code is 1 if any case regressed, so it can be used in scripts.
+#
+# @file bench_compare.py
+# @author Jurriaan van den Berg
+# @author Maxim van den Berg
+# @author Melvin Seitner
+# @date 19-10-2026
+
+import json
+import sys
+
+
+def load_cases(path):
+    with open(path) as f:
+        results = json.load(f)
+    cases = {(c["file"], c["scale"], c["settings"]): c for c in results["cases"]}
+    return results["driver"], cases
+
+
+def main():
+    if len(sys.argv) < 3:
+        print(f"Usage: {sys.argv[0]} baseline.json results.json [threshold]")
+        return 2
+
+    threshold = float(sys.argv[3]) if len(sys.argv) > 3 else 0.05
+    base_driver, baseline = load_cases(sys.argv[1])
+    driver, results = load_cases(sys.argv[2])
+
+    if base_driver["renderer"] != driver["renderer"]:
+        print(f"Warning: comparing {driver['renderer']} against a baseline "
+              f"from {base_driver['renderer']}.")
+
+    regressions = 0
+    print(f"{'case':60} {'baseline':>10} {'current':>10} {'change':>8}")
+    for key, case in sorted(results.items()):
+        if key not in baseline:
+            continue
+
+        old, new = baseline[key]["mlups"], case["mlups"]
+        change = (new - old) / old
+        flag = ""
+        if change < -threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+
+        name = f"{key[0]} x{key[1]} {key[2]}"
+        print(f"{name:60} {old:10.2f} {new:10.2f} {change:+8.1%}{flag}")
+
+    missing = set(baseline) - set(results)
+    for key in sorted(missing):
+        print(f"Missing case: {key[0]} x{key[1]} {key[2]}")
+
+    print(f"{regressions} regression(s) beyond {threshold:.0%}.")
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,80 @@
+# Submit simulations to the job server (`build/main.o --server {socket}`),
+# and print their progress and results.
+#
+# Usage: python3 python/lbm_submit.py {socket} {key=value ...} [-- {key=value ...}]
+#
+# Every group of options, separated by `--`, is one job (see server.hpp for
+# the keys). For example, a viscosity series:
+#     python3 python/lbm_submit.py /tmp/lbm.sock \
+#         map=assets/river.bmp steps=10000 viscosity=0.005 -- \
+#         map=assets/river.bmp steps=10000 viscosity=0.01
+#
+# Use `status`, `cancel {id}` or `shutdown` instead of the options to send
+# those commands. The exit code is 1 if any job failed.
+#
+# @file lbm_submit.py
+# @author Jurriaan van den Berg
+# @author Maxim van den Berg
+# @author Melvin Seitner
+# @date 19-10-2026
+
+import socket
+import sys
+
+
+def lines(connection):
+    buffer = b""
+    while True:
+        data = connection.recv(4096)
+        if not data:
+            return
+        buffer += data
+        while b"\n" in buffer:
+            line, buffer = buffer.split(b"\n", 1)
+            yield line.decode()
+
+
+def main():
+    if len(sys.argv) < 3:
+        print(f"Usage: {sys.argv[0]} socket key=value ... [-- key=value ...]")
+        return 2
+
+    connection = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    connection.connect(sys.argv[1])
+    command = sys.argv[2:]
+
+    if command[0] in ("status", "cancel", "shutdown"):
+        connection.sendall((" ".join(command) + "\n").encode())
+        if command[0] == "shutdown":
+            return 0
+        for line in lines(connection):
+            print(line)
+            if line == "end" or line.split()[0] in ("cancelled", "error"):
+                return 0
+        return 0
+
+    # Split the options into jobs, and submit them all at once.
+    jobs = [[]]
+    for option in command:
+        if option == "--":
+            jobs.append([])
+        else:
+            jobs[-1].append(option)
+    jobs = [job for job in jobs if job]
+    for job in jobs:
+        connection.sendall(("submit " + " ".join(job) + "\n").encode())
+
+    pending, failed = len(jobs), 0
+    for line in lines(connection):
+        print(line, flush=True)
+        word = line.split()[0]
+        if word in ("done", "cancelled", "error"):
+            failed += word != "done"
+            pending -= 1
+            if pending == 0:
+                break
+    return 1 if failed or pending else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,150 @@
+# A Python wrapper of the LBM river model, using the shared library built
+# with `make lib` (see src/capi/pcslbm.h). Fields are returned as numpy
+# arrays which view the memory of the library without copying it, so they
+# change when the same field is read again. Walls store their f_i values
+# negated.
+#
+# Usage:
+#     import pcslbm
+#     lbm = pcslbm.Lattice("assets/river.bmp")
+#     lbm.step(1000)
+#     u = lbm.field(pcslbm.VELOCITY)  # (height, width, 2), top row first
+#
+# @file pcslbm.py
+# @author Jurriaan van den Berg
+# @author Maxim van den Berg
+# @author Melvin Seitner
+# @date 19-10-2026
+
+import ctypes
+import os
+
+import numpy as np
+
+
+FLUID, WALL, INDESTRUCTIBLE, SOURCE = range(4)
+VELOCITY, DENSITY, FLAGS, DISTRIBUTIONS, REST = range(5)
+SOURCE_SETTING, EROSION, SEDIMENTATION, SLOPE = range(4)
+
+_ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+_TYPES = {0: np.float64, 1: np.uint32}
+
+
+class _Field(ctypes.Structure):
+    _fields_ = [("data", ctypes.c_void_p),
+                ("buffer", ctypes.c_void_p),
+                ("size", ctypes.c_size_t),
+                ("type", ctypes.c_int),
+                ("ndim", ctypes.c_int),
+                ("shape", ctypes.c_size_t * 4),
+                ("strides", ctypes.c_ssize_t * 4)]
+
+
+def _load(path=None):
+    lib = ctypes.CDLL(path or os.path.join(_ROOT, "build", "libpcslbm.so"))
+    p = ctypes.c_void_p
+    signatures = {
+        "pcs_set_resource_directory": (None, [ctypes.c_char_p]),
+        "pcs_lbm_create_from_file": (p, [ctypes.c_char_p, ctypes.c_double]),
+        "pcs_lbm_create_from_array": (p, [ctypes.c_int, ctypes.c_int, p]),
+        "pcs_lbm_destroy": (None, [p]),
+        "pcs_lbm_width": (ctypes.c_int, [p]),
+        "pcs_lbm_height": (ctypes.c_int, [p]),
+        "pcs_lbm_frame": (ctypes.c_uint, [p]),
+        "pcs_lbm_set_seed": (None, [p, ctypes.c_uint]),
+        "pcs_lbm_set_viscosity": (None, [p, ctypes.c_double]),
+        "pcs_lbm_initialise_flow": (None, [p, ctypes.c_double,
+                                           ctypes.c_double]),
+        "pcs_lbm_set_setting": (None, [p, ctypes.c_int, ctypes.c_int]),
+        "pcs_lbm_step": (None, [p, ctypes.c_uint]),
+        "pcs_lbm_field": (ctypes.c_int, [p, ctypes.c_int,
+                                         ctypes.POINTER(_Field)]),
+        "pcs_lbm_save_checkpoint": (ctypes.c_int, [p, ctypes.c_char_p]),
+        "pcs_lbm_load_checkpoint": (ctypes.c_int, [p, ctypes.c_char_p]),
+    }
+    for name, (restype, argtypes) in signatures.items():
+        function = getattr(lib, name)
+        function.restype = restype
+        function.argtypes = argtypes
+
+    # The shaders are read relative to the root of the repository.
+    lib.pcs_set_resource_directory(_ROOT.encode())
+    return lib
+
+
+_lib = None
+
+
+class Lattice:
+    """A lattice of the model, created from a map file or from an array of
+    cell types (FLUID, WALL, INDESTRUCTIBLE or SOURCE) with the top row
+    first, like the fields."""
+
+    def __init__(self, source, water_level=0.1):
+        global _lib
+        if _lib is None:
+            _lib = _load()
+
+        if isinstance(source, str):
+            self._lbm = _lib.pcs_lbm_create_from_file(source.encode(),
+                                                      water_level)
+        else:
+            cells = np.ascontiguousarray(np.asarray(source)[::-1],
+                                         dtype=np.uint8)
+            self._lbm = _lib.pcs_lbm_create_from_array(
+                cells.shape[1], cells.shape[0], cells.ctypes.data)
+        if not self._lbm:
+            raise RuntimeError(f"Failed to create a lattice from {source!r}")
+
+    def close(self):
+        if self._lbm:
+            _lib.pcs_lbm_destroy(self._lbm)
+            self._lbm = None
+
+    def __del__(self):
+        self.close()
+
+    @property
+    def shape(self):
+        return (_lib.pcs_lbm_height(self._lbm), _lib.pcs_lbm_width(self._lbm))
+
+    @property
+    def frame(self):
+        return _lib.pcs_lbm_frame(self._lbm)
+
+    def set_seed(self, seed):
+        _lib.pcs_lbm_set_seed(self._lbm, seed)
+
+    def set_viscosity(self, viscosity):
+        _lib.pcs_lbm_set_viscosity(self._lbm, viscosity)
+
+    def initialise_flow(self, u_x, u_y):
+        _lib.pcs_lbm_initialise_flow(self._lbm, u_x, u_y)
+
+    def set_setting(self, index, enabled):
+        _lib.pcs_lbm_set_setting(self._lbm, index, int(enabled))
+
+    def step(self, steps=1):
+        _lib.pcs_lbm_step(self._lbm, steps)
+
+    def field(self, field):
+        """Read a field back from the GPU, as a view (not a copy) of the
+        memory of the library. The next read of the same field overwrites
+        it, so use `.copy()` to keep it. The view keeps the lattice, which
+        owns the memory, alive."""
+        f = _Field()
+        if _lib.pcs_lbm_field(self._lbm, field, ctypes.byref(f)) != 0:
+            raise ValueError(f"Unknown field {field}")
+        memory = (ctypes.c_char * f.size).from_address(f.buffer)
+        memory._lattice = self
+        return np.ndarray(tuple(f.shape[:f.ndim]), dtype=_TYPES[f.type],
+                          buffer=memory, offset=f.data - f.buffer,
+                          strides=tuple(f.strides[:f.ndim]))
+
+    def save_checkpoint(self, path):
+        if _lib.pcs_lbm_save_checkpoint(self._lbm, path.encode()) != 0:
+            raise IOError(f"Failed to save the checkpoint {path}")
+
+    def load_checkpoint(self, path):
+        if _lib.pcs_lbm_load_checkpoint(self._lbm, path.encode()) != 0:
+            raise IOError(f"Failed to load the checkpoint {path}")
@@ -0,0 +1,238 @@
+/**
+ * The C interface of the LBM river model. See pcslbm.h for details.
+ *
+ * @file pcslbm.cpp
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#include "pcslbm.h"
+
+#include <vector>
+
+#include "../print.hpp"
+#include "../sdl/window.hpp"
+#include "../opengl/opengl.hpp"
+#include "../lbm/lbm.hpp"
+#include "../lbm/importer.hpp"
+
+using namespace pcs;
+
+
+struct pcs_lbm {
+    LatticeBoltzmann* lbm;
+
+    // The host memory of every field, see `pcs_lbm_field()`.
+    std::vector<GLuint> fields[5];
+};
+
+
+// The hidden window and renderer shared by all lattices.
+static Window window;
+static GLRenderer* renderer = nullptr;
+static int lattices = 0;
+
+
+// Create the OpenGL context for the first lattice.
+static bool acquireContext() {
+    if (lattices == 0) {
+        window = createOpenGLWindow("libpcslbm", 400, 400, true);
+        if (window.sdlData == nullptr) {
+            return false;
+        }
+        renderer = new GLRenderer();
+    }
+    lattices++;
+    return true;
+}
+
+// Destroy the OpenGL context with the last lattice.
+static void releaseContext() {
+    if (--lattices == 0) {
+        renderer->close();
+        delete renderer;
+        renderer = nullptr;
+        destroyWindow(window);
+    }
+}
+
+static pcs_lbm* createLattice( GLuint flags, int width, int height ) {
+    pcs_lbm* lbm = new pcs_lbm();
+    lbm->lbm = new LatticeBoltzmann(*renderer, flags, width, height);
+    return lbm;
+}
+
+
+void pcs_set_resource_directory( const char* directory ) {
+    setResourceDirectory(directory);
+}
+
+pcs_lbm* pcs_lbm_create_from_file( const char* path, double water_level ) {
+    if (!acquireContext()) {
+        return nullptr;
+    }
+
+    MapImporter importer = MapImporter(path, water_level);
+    GLuint flags = 0;
+    if (importer.isOpen()) {
+        flags = gl::genUTexture(importer.getWidth(), importer.getHeight());
+        if (!importer.upload(flags)) {
+            glDeleteTextures(1, &flags);
+            flags = 0;
+        }
+    }
+    importer.close();
+
+    if (flags == 0) {
+        print(INFO_, "Failed to import", std::string("[") + path + "]", "!");
+        releaseContext();
+        return nullptr;
+    }
+    return createLattice(flags, importer.getWidth(), importer.getHeight());
+}
+
+pcs_lbm* pcs_lbm_create_from_array( int width, int height,
+                                    const uint8_t* cells ) {
+    if (width <= 0 || height <= 0 || !acquireContext()) {
+        return nullptr;
+    }
+
+    // The colors of the cells, as in the river bitmaps.
+    std::vector<float> pixels((size_t) width * height * 4, 0.f);
+    for (size_t i = 0; i < (size_t) width * height; ++i) {
+        float* pixel = &pixels[4 * i];
+        switch (cells[i]) {
+        case PCS_CELL_WALL:
+            pixel[1] = 1.f;
+            break;
+        case PCS_CELL_INDESTRUCTIBLE:
+            pixel[0] = 1.f;
+            pixel[1] = 1.f;
+            break;
+        case PCS_CELL_SOURCE:
+            pixel[2] = 1.f;
+            break;
+        default:
+            break;
+        }
+    }
+
+    return createLattice(genFlagsTexture(width, height, pixels.data()),
+                         width, height);
+}
+
+void pcs_lbm_destroy( pcs_lbm* lbm ) {
+    if (lbm == nullptr) {
+        return;
+    }
+    lbm->lbm->close();
+    delete lbm->lbm;
+    delete lbm;
+    releaseContext();
+}
+
+int pcs_lbm_width( const pcs_lbm* lbm ) {
+    return lbm->lbm->getWidth();
+}
+
+int pcs_lbm_height( const pcs_lbm* lbm ) {
+    return lbm->lbm->getHeight();
+}
+
+unsigned pcs_lbm_frame( const pcs_lbm* lbm ) {
+    return lbm->lbm->getFrame();
+}
+
+void pcs_lbm_set_seed( pcs_lbm* lbm, unsigned seed ) {
+    lbm->lbm->setSeed(seed);
+}
+
+void pcs_lbm_set_viscosity( pcs_lbm* lbm, double viscosity ) {
+    lbm->lbm->setViscosity(viscosity);
+}
+
+void pcs_lbm_initialise_flow( pcs_lbm* lbm, double u_x, double u_y ) {
+    lbm->lbm->initialiseFlow(u_x, u_y);
+}
+
+void pcs_lbm_set_setting( pcs_lbm* lbm, int index, int enabled ) {
+    if (index >= 0 && index < 4) {
+        lbm->lbm->setSetting(index, enabled != 0);
+    }
+}
+
+void pcs_lbm_step( pcs_lbm* lbm, unsigned steps ) {
+    lbm->lbm->step(*renderer, steps);
+}
+
+int pcs_lbm_field( pcs_lbm* lbm, int field, pcs_field* out ) {
+    if (field < PCS_FIELD_VELOCITY || field > PCS_FIELD_REST) {
+        return 1;
+    }
+
+    const size_t w = lbm->lbm->getWidth(), h = lbm->lbm->getHeight();
+    const size_t texel = 4 * sizeof(GLuint), texture = w * h * 4;
+
+    // The textures holding the field (see `LatticeBoltzmann`).
+    size_t first = 0, count = 1;
+    switch (field) {
+    case PCS_FIELD_VELOCITY:      first = 1; break;
+    case PCS_FIELD_DENSITY:       first = 2; break;
+    case PCS_FIELD_REST:          first = 2; break;
+    case PCS_FIELD_FLAGS:         first = 0; break;
+    case PCS_FIELD_DISTRIBUTIONS: first = 3; count = 4; break;
+    }
+
+    std::vector<GLuint>& data = lbm->fields[field];
+    data.resize(texture * count);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    for (size_t i = 0; i < count; ++i) {
+        glBindTexture(GL_TEXTURE_2D, lbm->lbm->getTexture(first + i));
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA_INTEGER, GL_UNSIGNED_INT,
+                      data.data() + i * texture);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // The textures start with the bottom row, so the rows are walked
+    // backwards from the last one. The doubles are packed in the texels as
+    // two pairs of unsigned integers.
+    const ptrdiff_t row = -(ptrdiff_t) (w * texel);
+    void* buffer = data.data();
+    void* last = (char*) buffer + (h - 1) * w * texel;
+    const size_t size = data.size() * sizeof(GLuint);
+
+    switch (field) {
+    case PCS_FIELD_VELOCITY:
+        *out = {last, buffer, size, PCS_FLOAT64, 3,
+                {h, w, 2}, {row, (ptrdiff_t) texel, sizeof(double)}};
+        break;
+    case PCS_FIELD_DENSITY:
+        *out = {last, buffer, size, PCS_FLOAT64, 2,
+                {h, w}, {row, (ptrdiff_t) texel}};
+        break;
+    case PCS_FIELD_FLAGS:
+        *out = {last, buffer, size, PCS_UINT32, 3,
+                {h, w, 4}, {row, (ptrdiff_t) texel, sizeof(GLuint)}};
+        break;
+    case PCS_FIELD_DISTRIBUTIONS:
+        *out = {last, buffer, size, PCS_FLOAT64, 4,
+                {4, h, w, 2}, {(ptrdiff_t) (texture * sizeof(GLuint)), row,
+                               (ptrdiff_t) texel, sizeof(double)}};
+        break;
+    case PCS_FIELD_REST:
+        *out = {(char*) last + sizeof(double), buffer, size, PCS_FLOAT64, 2,
+                {h, w}, {row, (ptrdiff_t) texel}};
+        break;
+    }
+    return 0;
+}
+
+int pcs_lbm_save_checkpoint( pcs_lbm* lbm, const char* path ) {
+    return lbm->lbm->saveCheckpoint(path) ? 0 : 1;
+}
+
+int pcs_lbm_load_checkpoint( pcs_lbm* lbm, const char* path ) {
+    return lbm->lbm->loadCheckpoint(path) ? 0 : 1;
+}
@@ -0,0 +1,128 @@
+/**
+ * A C interface to the LBM river model, for embedding it in other programs
+ * (like Python with ctypes) through the shared library `libpcslbm.so`.
+ *
+ * The model runs in a hidden OpenGL context, which is created with the
+ * first lattice and shared by all lattices. All functions must be called
+ * from the same thread.
+ *
+ * @file pcslbm.h
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#ifndef PCSLBM_H
+#define PCSLBM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A lattice, see `pcs::LatticeBoltzmann`. */
+typedef struct pcs_lbm pcs_lbm;
+
+/* The cells of a lattice created from an array. */
+enum {
+    PCS_CELL_FLUID = 0,
+    PCS_CELL_WALL = 1,
+    PCS_CELL_INDESTRUCTIBLE = 2,
+    PCS_CELL_SOURCE = 3
+};
+
+/*
+ * The fields which can be read with `pcs_lbm_field()`. Together, the flags
+ * and the nine f_i values (PCS_FIELD_REST and PCS_FIELD_DISTRIBUTIONS) are
+ * the state of a cell. Walls store their f_i values negated, so their
+ * magnitudes are the values which bounce back, and the moments of any cell
+ * are those of |f_i| (like `moments()` in `src/lbm/refine.frag`).
+ */
+enum {
+    PCS_FIELD_VELOCITY = 0,      /* float64 (height, width, 2): u_x, u_y. */
+    PCS_FIELD_DENSITY = 1,       /* float64 (height, width). */
+    PCS_FIELD_FLAGS = 2,         /* uint32 (height, width, 4): indestructible,
+                                    wall next frame, source, wall. */
+    PCS_FIELD_DISTRIBUTIONS = 3, /* float64 (4, height, width, 2), where
+                                    [i, y, x, j] is f_(2i + j + 1). */
+    PCS_FIELD_REST = 4           /* float64 (height, width): f_0. */
+};
+
+/* The element types of fields. */
+enum {
+    PCS_FLOAT64 = 0,
+    PCS_UINT32 = 1
+};
+
+/*
+ * A field read back to the host. The elements are not contiguous, so
+ * `strides` (in bytes, possibly negative) must be used, like numpy does.
+ * The first row is the top of the map. The memory belongs to the lattice,
+ * and stays valid until the same field is read again, or the lattice is
+ * destroyed.
+ */
+typedef struct {
+    void* data;          /* The first element. */
+    void* buffer;        /* The start of the memory holding the field. */
+    size_t size;         /* The size of that memory in bytes. */
+    int type;            /* PCS_FLOAT64 or PCS_UINT32. */
+    int ndim;
+    size_t shape[4];
+    ptrdiff_t strides[4];
+} pcs_field;
+
+/*
+ * Set the directory containing the `src` directory of the model, from which
+ * the shaders are read. The working directory is used by default.
+ */
+void pcs_set_resource_directory( const char* directory );
+
+/*
+ * Create a lattice from a river bitmap or PNG file (see the README), or
+ * from an array of `width * height` PCS_CELL values, bottom row first.
+ * Returns NULL on failure.
+ */
+pcs_lbm* pcs_lbm_create_from_file( const char* path, double water_level );
+pcs_lbm* pcs_lbm_create_from_array( int width, int height,
+                                    const uint8_t* cells );
+
+/* Destroy a lattice, and the OpenGL context with the last lattice. */
+void pcs_lbm_destroy( pcs_lbm* lbm );
+
+int pcs_lbm_width( const pcs_lbm* lbm );
+int pcs_lbm_height( const pcs_lbm* lbm );
+unsigned pcs_lbm_frame( const pcs_lbm* lbm );
+
+/* Parameters, see `pcs::LatticeBoltzmann`. */
+void pcs_lbm_set_seed( pcs_lbm* lbm, unsigned seed );
+void pcs_lbm_set_viscosity( pcs_lbm* lbm, double viscosity );
+void pcs_lbm_initialise_flow( pcs_lbm* lbm, double u_x, double u_y );
+
+/*
+ * Enable or disable a setting: 0 the source, 1 erosion, 2 sedimentation
+ * and 3 the slope (the Q, W, E and R keys).
+ */
+void pcs_lbm_set_setting( pcs_lbm* lbm, int index, int enabled );
+
+/* Simulate an amount of frames. */
+void pcs_lbm_step( pcs_lbm* lbm, unsigned steps );
+
+/*
+ * Read back a field of the current frame (a PCS_FIELD value). Returns 0 on
+ * success. The next call for the same field reuses the memory, which
+ * invalidates the previous `out`.
+ */
+int pcs_lbm_field( pcs_lbm* lbm, int field, pcs_field* out );
+
+/* Save or restore the state of the lattice. Return 0 on success. */
+int pcs_lbm_save_checkpoint( pcs_lbm* lbm, const char* path );
+int pcs_lbm_load_checkpoint( pcs_lbm* lbm, const char* path );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
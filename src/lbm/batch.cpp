@@ -0,0 +1,193 @@
+/**
+ * Batch runs of several river bitmaps in a texture atlas.
+ * See batch.hpp for details.
+ *
+ * @file batch.cpp
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#include "batch.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "importer.hpp"
+#include "lbm.hpp"
+#include "../print.hpp"
+
+using namespace pcs;
+
+
+bool pcs::buildAtlas( const std::vector<std::string>& files, int maxSize,
+                      int guard, Atlas& atlas ) {
+
+    // Read the sizes of all the maps.
+    atlas.entries.resize(files.size());
+
+    size_t area = 0;
+    int widest = 0;
+    for (size_t i = 0; i < files.size(); ++i) {
+        AtlasEntry& entry = atlas.entries[i];
+        entry.file = files[i];
+
+        MapImporter header(files[i]);
+        if (!header.isOpen()) {
+            return false;
+        }
+        entry.width = header.getWidth();
+        entry.height = header.getHeight();
+        header.close();
+
+        const int w = entry.width + 2 * guard;
+        const int h = entry.height + 2 * guard;
+        area += (size_t) w * h;
+        widest = std::max(widest, w);
+    }
+
+    // Place the tallest maps first, on shelves of a roughly square atlas.
+    std::vector<size_t> order(files.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&]( size_t a, size_t b ) {
+        return atlas.entries[a].height > atlas.entries[b].height;
+    });
+
+    const int shelfWidth = std::min(maxSize, std::max(widest,
+                                    (int) std::ceil(std::sqrt(area * 1.1))));
+    int x = 0, y = 0, shelfHeight = 0;
+    atlas.width = 0;
+
+    for (size_t i : order) {
+        AtlasEntry& entry = atlas.entries[i];
+        const int w = entry.width + 2 * guard;
+        const int h = entry.height + 2 * guard;
+
+        // Start a new shelf if this map does not fit on the current one.
+        if (x + w > shelfWidth) {
+            x = 0;
+            y += shelfHeight;
+            shelfHeight = 0;
+        }
+
+        entry.x = x + guard;
+        entry.y = y + guard;
+        x += w;
+        shelfHeight = std::max(shelfHeight, h);
+        atlas.width = std::max(atlas.width, x);
+    }
+    atlas.height = y + shelfHeight;
+
+    if (atlas.width > maxSize || atlas.height > maxSize) {
+        print(INFO_, "The atlas of size", atlas.width, "x", atlas.height,
+              "exceeds the maximum texture size of", maxSize, "!");
+        return false;
+    }
+
+    return true;
+}
+
+GLuint pcs::uploadAtlas( const Atlas& atlas, double waterLevel ) {
+
+    // Fill the atlas with indestructible walls (the flags of yellow), a
+    // band of rows at a time.
+    const GLuint texture = gl::genUTexture(atlas.width, atlas.height);
+    const int rows = std::min(atlas.height, 64);
+    std::vector<GLuint> walls((size_t) atlas.width * rows * 4, 0);
+    for (size_t i = 0; i < walls.size(); i += 4) {
+        walls[i] = walls[i + 1] = 1;
+    }
+    glBindTexture(GL_TEXTURE_2D, texture);
+    for (int y = 0; y < atlas.height; y += rows) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, atlas.width,
+                        std::min(rows, atlas.height - y), GL_RGBA_INTEGER,
+                        GL_UNSIGNED_INT, walls.data());
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Import every map into its place.
+    for (const AtlasEntry& entry : atlas.entries) {
+        MapImporter importer(entry.file, waterLevel);
+        const bool imported = importer.upload(texture, 0, entry.width,
+                                              entry.x, entry.y);
+        importer.close();
+        if (!imported) {
+            glDeleteTextures(1, &texture);
+            return 0;
+        }
+    }
+    return texture;
+}
+
+
+int pcs::runBatch( GLRenderer& renderer, const std::vector<std::string>& files,
+                   unsigned steps, unsigned seed, double viscosity,
+                   double waterLevel ) {
+
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+
+    // Two cells of wall, so that even diagonal streaming from a wall cell
+    // can never reach the neighbouring map.
+    Atlas atlas;
+    if (files.empty() || !buildAtlas(files, maxSize, 2, atlas)) {
+        print(INFO_, "Failed to create the batch atlas!");
+        return 1;
+    }
+
+    print("Packed", files.size(), "maps into an atlas of", atlas.width, "x",
+          atlas.height);
+
+    GLuint background = uploadAtlas(atlas, waterLevel);
+    if (background == 0) {
+        print(INFO_, "Failed to import the maps into the batch atlas!");
+        return 1;
+    }
+    LatticeBoltzmann lbm = LatticeBoltzmann(renderer, background,
+                                            atlas.width, atlas.height);
+    lbm.setSeed(seed);
+    lbm.setViscosity(viscosity);
+
+    // Simulate all maps at once.
+    glFinish();
+    const auto start = std::chrono::steady_clock::now();
+    lbm.step(renderer, steps);
+    glFinish();
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    // The throughput of the whole atlas, and of the cells which belong
+    // to an actual map.
+    size_t mapCells = 0;
+    for (const AtlasEntry& entry : atlas.entries) {
+        mapCells += (size_t) entry.width * entry.height;
+    }
+    const double atlasCells = (double) atlas.width * atlas.height;
+    const double seconds = elapsed.count();
+
+    print("Simulated", steps, "steps in", seconds, "s");
+    print("Atlas MLUPS:", atlasCells * steps / seconds / 1e6,
+          "(maps:", (double) mapCells * steps / seconds / 1e6, "MLUPS,",
+          100.0 * mapCells / atlasCells, "% of the atlas)");
+
+    // Report the results per map.
+    for (const AtlasEntry& entry : atlas.entries) {
+        LatticeBoltzmann::Summary summary =
+            lbm.summarise(entry.x, entry.y, entry.width, entry.height);
+
+        print("-------", entry.file, "--------");
+        print("position:  ", entry.x, entry.y, "size:", entry.width, "x",
+              entry.height);
+        print("cells:     ", summary.fluidCells, "fluid,",
+              summary.wallCells, "wall");
+        print("mass:      ", summary.mass);
+        print("mean |u|:  ", summary.meanSpeed);
+        print("max |u|:   ", summary.maxSpeed);
+        print("checksum:  ", summary.checksum);
+    }
+
+    lbm.close();
+    return gl::checkErrors("batch run") ? 1 : 0;
+}
@@ -0,0 +1,88 @@
+/**
+ * Batch runs of several river bitmaps, packed into a single texture atlas
+ * which is simulated as one lattice.
+ *
+ * @file batch.hpp
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "../opengl/opengl.hpp"
+
+namespace pcs {
+
+    /**
+     * The location of a single river bitmap within an atlas. The position
+     * refers to the bottom left corner of the bitmap itself, so without the
+     * guard band around it.
+     */
+    struct AtlasEntry {
+        std::string file;
+        int x, y;
+        int width, height;
+    };
+
+    /**
+     * A texture atlas which contains several river bitmaps. Every bitmap is
+     * surrounded by a band of indestructible walls (a yellow border in
+     * bitmap colors), so that neither the streaming step nor the periodic
+     * boundaries (`GL_REPEAT`) can move fluid from one map to the other.
+     * The unused space of the atlas is filled with walls as well.
+     *
+     * Note that as a consequence the maps are not periodic within the atlas,
+     * unlike when they are simulated on their own.
+     */
+    struct Atlas {
+        int width, height;
+        std::vector<AtlasEntry> entries;
+    };
+
+    /**
+     * Pack the maps into an atlas, using a simple shelf packing (tallest
+     * maps first) aiming for a square atlas. Only the sizes of the maps are
+     * read, see `uploadAtlas()`.
+     *
+     * @param files The paths to the river .bmp or .png files
+     * @param maxSize The maximum width and height of the atlas
+     * @param guard The width of the wall band around every map
+     * @param atlas Returns the packed atlas
+     * @return True if all the maps were packed, false otherwise.
+     */
+    bool buildAtlas( const std::vector<std::string>& files, int maxSize,
+                     int guard, Atlas& atlas );
+
+    /**
+     * Create the cell flags texture of an atlas (for the `LatticeBoltzmann`
+     * constructor): the walls around the maps, and every map imported into
+     * its place by the `MapImporter`, without holding the atlas in host
+     * memory.
+     *
+     * @param atlas The packed atlas
+     * @param waterLevel The water level of heightmaps
+     * @return The texture id, or 0 if a map could not be imported.
+     */
+    GLuint uploadAtlas( const Atlas& atlas, double waterLevel );
+
+    /**
+     * Simulate all the river bitmaps together in one atlas lattice for
+     * `steps` frames, and print the throughput and a summary per map.
+     *
+     * @param renderer The OpenGL instance
+     * @param files The paths to the river .bmp or .png files
+     * @param steps The amount of frames to simulate
+     * @param seed The seed for the random numbers
+     * @param viscosity The viscosity of the fluid
+     * @param waterLevel The water level of heightmaps
+     * @return The exit code, 0 on success.
+     */
+    int runBatch( GLRenderer& renderer, const std::vector<std::string>& files,
+                  unsigned steps, unsigned seed, double viscosity,
+                  double waterLevel );
+}
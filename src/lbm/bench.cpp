@@ -0,0 +1,197 @@
+/**
+ * The benchmark harness. See bench.hpp for details.
+ *
+ * @file bench.cpp
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#include "bench.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+#include "importer.hpp"
+#include "lbm.hpp"
+#include "memory.hpp"
+#include "../print.hpp"
+
+using namespace pcs;
+
+
+// The settings combinations to benchmark, as [flow, erosion, sedimentation,
+// slope]. Erosion and sedimentation add branches and random numbers to the
+// kernel, the slope drives the flow without a source.
+static const struct {
+    const char* name;
+    bool settings[4];
+} benchSettings[] = {
+    {"flow",                       {true,  false, false, false}},
+    {"flow+erosion",               {true,  true,  false, false}},
+    {"flow+sedimentation",         {true,  false, true,  false}},
+    {"flow+erosion+sedimentation", {true,  true,  true,  false}},
+    {"slope",                      {false, false, false, true}},
+};
+
+
+// Quote and escape a string for JSON.
+static std::string jsonString( const std::string& str ) {
+    std::string result = "\"";
+    for (char c : str) {
+        if (c == '"' || c == '\\') result += '\\';
+        if ((unsigned char) c < 0x20) continue;
+        result += c;
+    }
+    return result + "\"";
+}
+
+// Get an OpenGL string, like the vendor or renderer.
+static std::string glString( GLenum name ) {
+    const GLubyte* str = glGetString(name);
+    return str == nullptr ? "" : std::string((const char*) str);
+}
+
+int pcs::runBenchmark( GLRenderer& renderer, const std::vector<std::string>& files,
+                       const BenchOptions& options ) {
+
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+
+    // The timer query for the GPU time.
+    GLuint query;
+    glGenQueries(1, &query);
+
+    std::stringstream json;
+    json << "{\n"
+         << "  \"driver\": {\n"
+         << "    \"vendor\": " << jsonString(glString(GL_VENDOR)) << ",\n"
+         << "    \"renderer\": " << jsonString(glString(GL_RENDERER)) << ",\n"
+         << "    \"version\": " << jsonString(glString(GL_VERSION)) << ",\n"
+         << "    \"glsl\": "
+         << jsonString(glString(GL_SHADING_LANGUAGE_VERSION)) << "\n"
+         << "  },\n"
+         << "  \"warmup\": " << options.warmup << ",\n"
+         << "  \"steps\": " << options.steps << ",\n"
+         << "  \"cases\": [";
+
+    int failures = 0;
+    bool first = true;
+    for (const std::string& file : files) {
+
+        MapImporter header(file, options.waterLevel);
+        if (!header.isOpen()) {
+            failures++;
+            continue;
+        }
+        const int width = header.getWidth(), height = header.getHeight();
+        header.close();
+
+        for (int scale : options.scales) {
+            const int w = width * scale, h = height * scale;
+            if (scale < 1 || w > maxSize || h > maxSize) {
+                print(INFO_, "Skipping", file, "at scale", scale,
+                      ", the lattice is too large.");
+                continue;
+            }
+
+            for (const auto& combination : benchSettings) {
+
+                // Every case starts from a fresh lattice, imported scaled
+                // up to the nearest neighbour.
+                const GLuint background = gl::genUTexture(w, h);
+                MapImporter importer(file, options.waterLevel);
+                const bool imported = importer.upload(background, 0, width,
+                                                      0, 0, scale);
+                importer.close();
+                if (!imported) {
+                    glDeleteTextures(1, &background);
+                    failures++;
+                    break;
+                }
+                LatticeBoltzmann lbm = LatticeBoltzmann(renderer, background,
+                                                        w, h);
+                for (size_t i = 0; i < 4; ++i) {
+                    lbm.setSetting(i, combination.settings[i]);
+                }
+
+                lbm.step(renderer, options.warmup);
+                glFinish();
+
+                // Time the steps with the wall clock and the timer query.
+                const auto start = std::chrono::steady_clock::now();
+                glBeginQuery(GL_TIME_ELAPSED, query);
+                lbm.step(renderer, options.steps);
+                glEndQuery(GL_TIME_ELAPSED);
+                glFinish();
+                const std::chrono::duration<double> elapsed =
+                    std::chrono::steady_clock::now() - start;
+
+                GLuint64 gpuTime = 0;
+                glGetQueryObjectui64v(query, GL_QUERY_RESULT, &gpuTime);
+
+                const double cells = (double) w * h;
+                const double seconds = elapsed.count();
+                const double gpuSeconds = gpuTime * 1e-9;
+                const std::vector<LatticeBoltzmann::Allocation> usage =
+                    lbm.memoryUsage();
+                const size_t memory = LatticeBoltzmann::totalMemory(usage);
+                if (&combination == benchSettings) {
+                    printMemory(w, h, usage);
+                }
+
+                std::stringstream allocations;
+                for (size_t i = 0; i < usage.size(); ++i) {
+                    allocations << (i == 0 ? "" : ", ")
+                                << jsonString(usage[i].name) << ": "
+                                << usage[i].bytes;
+                }
+
+                print(file, "x" + toString(scale), combination.name, ":",
+                      cells * options.steps / seconds / 1e6, "MLUPS");
+
+                json << (first ? "\n" : ",\n") << "    {"
+                     << "\"file\": " << jsonString(file)
+                     << ", \"scale\": " << scale
+                     << ", \"width\": " << w
+                     << ", \"height\": " << h
+                     << ", \"settings\": " << jsonString(combination.name)
+                     << ", \"mlups\": "
+                     << cells * options.steps / seconds / 1e6
+                     << ", \"gpu_mlups\": " << (gpuTime == 0 ? "null" :
+                        toString(cells * options.steps / gpuSeconds / 1e6))
+                     << ", \"ms_per_step\": "
+                     << seconds * 1e3 / options.steps
+                     << ", \"gpu_ms_per_step\": "
+                     << gpuSeconds * 1e3 / options.steps
+                     << ", \"memory_bytes\": " << memory
+                     << ", \"bytes_per_cell\": " << memory / cells
+                     << ", \"memory\": {" << allocations.str() << "}"
+                     << "}";
+                first = false;
+
+                lbm.close();
+                if (gl::checkErrors("benchmark " + file)) {
+                    failures++;
+                }
+            }
+        }
+    }
+
+    json << "\n  ]\n}\n";
+    glDeleteQueries(1, &query);
+
+    // Write the results.
+    std::ofstream out(options.output);
+    out << json.str();
+    if (!out) {
+        print(INFO_, "Failed to write the benchmark results to",
+              options.output);
+        return 1;
+    }
+    print("Benchmark results written to", options.output);
+
+    return failures == 0 ? 0 : 1;
+}
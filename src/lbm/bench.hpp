@@ -0,0 +1,53 @@
+/**
+ * A benchmark harness, which measures the throughput of the simulation for
+ * a fixed matrix of river bitmaps, scales and settings.
+ *
+ * @file bench.hpp
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "../opengl/opengl.hpp"
+
+namespace pcs {
+
+    /**
+     * Options for a benchmark run.
+     */
+    struct BenchOptions {
+        unsigned warmup = 20;       // Frames simulated before timing.
+        unsigned steps = 200;       // Frames which are timed.
+        std::vector<int> scales = {1, 2, 4}; // Linear scales of the bitmaps.
+        double waterLevel = 0.1;    // The water level of heightmaps.
+        std::string output = "build/bench.json"; // Path of the JSON output.
+    };
+
+    /**
+     * Run the benchmark matrix. Every bitmap is scaled up (nearest
+     * neighbour) by each of the scales, so 1, 2 and 4 give 1x, 4x and 16x
+     * the area, and every scaled lattice is simulated with each settings
+     * combination. After a warm up, the timed frames are measured both with
+     * an OpenGL timer query and the wall clock.
+     *
+     * The results are written as JSON, containing the driver info and for
+     * every case the MLUPS (million lattice updates per second), the time
+     * per step and the memory footprint, in total and per allocation. The
+     * allocations are also printed once per lattice size.
+     * `python/bench_compare.py` compares such a file against a stored
+     * baseline.
+     *
+     * @param renderer The OpenGL instance
+     * @param files The paths to the river .bmp files
+     * @param options The benchmark options
+     * @return The exit code, 0 on success.
+     */
+    int runBenchmark( GLRenderer& renderer, const std::vector<std::string>& files,
+                      const BenchOptions& options );
+}
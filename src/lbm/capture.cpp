@@ -0,0 +1,237 @@
+/**
+ * Capturing the visualisation. See capture.hpp for details.
+ *
+ * @file capture.cpp
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#include "capture.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include <sys/stat.h>
+
+#include "../print.hpp"
+#include "../opengl/profiler.hpp"
+
+using namespace pcs;
+
+
+Capture::Capture( const std::string& output_, int width_, int height_,
+                  int fps, size_t depth ) {
+
+    output = output_;
+    width = width_;
+    height = height_;
+    next = inFlight = 0;
+    captured = stalls = 0;
+    quit = false;
+
+    // A video file, or a directory of images.
+    video = output.size() > 4 &&
+            output.compare(output.size() - 4, 4, ".y4m") == 0;
+    if (video) {
+        videoFile.open(output, std::ios::binary);
+        videoFile << "YUV4MPEG2 W" << width << " H" << height
+                  << " F" << fps << ":1 Ip A1:1 C444 XCOLORRANGE=FULL\n";
+        if (!videoFile) {
+            print(INFO_, "Failed to open", output, "for the capture!");
+        }
+    }
+    else {
+        mkdir(output.c_str(), 0755);
+    }
+
+    texture = gl::genTexture(width, height);
+
+    slots.resize(std::max<size_t>(1, depth));
+    for (Slot& slot : slots) {
+        glGenBuffers(1, &slot.pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (size_t) width * height * 4,
+                     nullptr, GL_STREAM_READ);
+        slot.fence = nullptr;
+        slot.frame = 0;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    thread = std::thread(&Capture::run, this);
+}
+
+void Capture::close() {
+
+    // Retire everything which is still in flight.
+    while (inFlight > 0) {
+        retire(true);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    changed.notify_all();
+    thread.join();
+
+    for (Slot& slot : slots) {
+        glDeleteBuffers(1, &slot.pbo);
+    }
+    glDeleteTextures(1, &texture);
+    videoFile.close();
+
+    print("Captured", captured, "frames to", output + ",", stalls,
+          "times waited for the read back");
+}
+
+void Capture::capture( GLRenderer& renderer, LatticeBoltzmann& lbm ) {
+
+    PROFILE_SCOPE("capture");
+    PROFILE_GPU("capture");
+
+    // Hand over the finished read backs. Only if the next slot is still in
+    // flight, the whole ring is, and we have to wait for it.
+    retire(false);
+    if (slots[next].fence != nullptr) {
+        stalls++;
+        while (slots[next].fence != nullptr) {
+            retire(true);
+        }
+    }
+
+    // Render the visualisation offscreen.
+    renderer.renderToTexture(texture);
+    renderer.clear(0.f, 0.f, 0.f, 1.f);
+    lbm.renderFields(renderer, 0.f, 0.f, width, height, width, height);
+
+    // Start the read back.
+    Slot& slot = slots[next];
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.frame = lbm.getFrame();
+    glFlush();
+
+    next = (next + 1) % slots.size();
+    inFlight++;
+    renderer.renderToScreen();
+}
+
+void Capture::retire( bool wait ) {
+
+    // The oldest slot in flight.
+    size_t index = (next + slots.size() - inFlight) % slots.size();
+
+    while (inFlight > 0) {
+        Slot& slot = slots[index];
+        const GLenum status = glClientWaitSync(
+            slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+            wait ? GL_TIMEOUT_IGNORED : 0);
+        if (status == GL_TIMEOUT_EXPIRED) {
+            break;
+        }
+        wait = false;
+
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+        inFlight--;
+
+        // Copy the frame for the writer thread, and wait if it is behind.
+        Frame frame = {std::vector<uint8_t>((size_t) width * height * 4),
+                       slot.frame};
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                                              frame.pixels.size(),
+                                              GL_MAP_READ_BIT);
+        if (pixels != nullptr) {
+            std::memcpy(frame.pixels.data(), pixels, frame.pixels.size());
+        }
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&]() { return frames.size() < slots.size(); });
+        frames.push_back(std::move(frame));
+        lock.unlock();
+        changed.notify_all();
+
+        index = (index + 1) % slots.size();
+    }
+}
+
+void Capture::run() {
+
+    while (true) {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&]() { return quit || !frames.empty(); });
+        if (frames.empty()) {
+            break;
+        }
+
+        // Keep the frame in the queue while writing it, so the queue stays
+        // bounded.
+        const Frame& frame = frames.front();
+        lock.unlock();
+        write(frame);
+
+        lock.lock();
+        frames.pop_front();
+        lock.unlock();
+        changed.notify_all();
+    }
+}
+
+void Capture::write( const Frame& frame ) {
+
+    PROFILE_SCOPE("write capture");
+
+    const size_t cells = (size_t) width * height;
+
+    // Flip the rows, so the top row comes first.
+    auto pixel = [&]( size_t i ) {
+        const size_t x = i % width, y = height - 1 - i / width;
+        return &frame.pixels[(y * width + x) * 4];
+    };
+
+    if (video) {
+        // Full range BT.601 conversion to planar YUV.
+        std::vector<uint8_t> planes(cells * 3);
+        for (size_t i = 0; i < cells; ++i) {
+            const uint8_t* p = pixel(i);
+            const float r = p[0], g = p[1], b = p[2];
+            planes[i] = std::min(255.f, 0.299f * r + 0.587f * g +
+                                        0.114f * b + 0.5f);
+            planes[cells + i] = std::min(255.f, std::max(0.f,
+                128.f - 0.168736f * r - 0.331264f * g + 0.5f * b + 0.5f));
+            planes[2 * cells + i] = std::min(255.f, std::max(0.f,
+                128.f + 0.5f * r - 0.418688f * g - 0.081312f * b + 0.5f));
+        }
+        videoFile << "FRAME\n";
+        videoFile.write((const char*) planes.data(), planes.size());
+    }
+    else {
+        std::vector<uint8_t> rgb(cells * 3);
+        for (size_t i = 0; i < cells; ++i) {
+            std::memcpy(&rgb[i * 3], pixel(i), 3);
+        }
+
+        std::stringstream path;
+        path << output << "/frame_" << std::setw(8) << std::setfill('0')
+             << frame.frame << ".ppm";
+        std::ofstream file(path.str(), std::ios::binary);
+        file << "P6\n" << width << " " << height << "\n255\n";
+        file.write((const char*) rgb.data(), rgb.size());
+        if (!file) {
+            print(INFO_, "Failed to write", path.str());
+            return;
+        }
+    }
+
+    captured++;
+}
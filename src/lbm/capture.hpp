@@ -0,0 +1,139 @@
+/**
+ * Capturing the visualisation as a video or image sequence.
+ *
+ * @file capture.hpp
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lbm.hpp"
+
+namespace pcs {
+
+    /**
+     * The Capture class records the visualisation of the model, without
+     * stalling the simulation on the read back.
+     *
+     * Every captured frame is rendered offscreen at the capture resolution,
+     * and read into the next pixel buffer of a ring, followed by a fence.
+     * Only once the fence of a buffer has passed (a few frames later) it is
+     * mapped and copied, so the simulation never waits for the GPU, unless
+     * the whole ring is still in flight. The copies are converted and
+     * written by a separate thread.
+     *
+     * If the output path ends with `.y4m` the frames are written as a
+     * single raw YUV4MPEG2 video (full range 4:4:4, which e.g. ffmpeg can
+     * encode further), otherwise the path is a directory to which every
+     * frame is written as a binary PPM image.
+     */
+    class Capture {
+
+        // A pixel buffer of the ring.
+        struct Slot {
+            GLuint pbo;
+            GLsync fence;   // Non zero while the read back is in flight.
+            unsigned frame;
+        };
+
+        // A frame waiting to be written, as RGBA rows bottom up.
+        struct Frame {
+            std::vector<uint8_t> pixels;
+            unsigned frame;
+        };
+
+    public:
+
+        /**
+         * Create the render target and pixel buffers, open the output and
+         * start the writer thread.
+         *
+         * @param output The .y4m file or the directory for .ppm files
+         * @param width The width of the captured frames
+         * @param height The height of the captured frames
+         * @param fps The frame rate stored in a video
+         * @param depth The amount of pixel buffers in the ring
+         */
+        Capture( const std::string& output, int width, int height,
+                 int fps = 30, size_t depth = 3 );
+
+        // The GPU memory of the render target and the pixel buffers.
+        static inline size_t captureMemory( int width, int height,
+                                            size_t depth = 3 ) {
+            return (1 + std::max<size_t>(1, depth)) * width * height * 4;
+        }
+
+        /**
+         * Write all the remaining frames and close the output.
+         */
+        void close();
+
+        /**
+         * Capture the current frame of the model, scaled to the capture
+         * resolution.
+         *
+         * @param renderer The OpenGL instance
+         * @param lbm The model
+         */
+        void capture( GLRenderer& renderer, LatticeBoltzmann& lbm );
+
+        // Statistics getters.
+        inline size_t getCaptured() const { return captured; }
+        inline size_t getStalls() const { return stalls; }
+
+    private:
+
+        /**
+         * Copy the frames of the slots whose read back has finished to the
+         * writer thread, oldest first. If `wait` is set the oldest slot is
+         * waited for.
+         *
+         * @param wait If the oldest slot should be waited for
+         */
+        void retire( bool wait );
+
+        /**
+         * The loop of the writer thread.
+         */
+        void run();
+
+        /**
+         * Convert and write a frame. Called on the writer thread.
+         *
+         * @param frame The frame to write
+         */
+        void write( const Frame& frame );
+
+        std::string output;
+        bool video;
+        std::ofstream videoFile;
+        int width, height;
+
+        // The offscreen render target and the ring of pixel buffers.
+        GLuint texture;
+        std::vector<Slot> slots;
+        size_t next;     // The next slot to use.
+        size_t inFlight; // The amount of slots with a fence.
+
+        size_t captured, stalls;
+
+        // The frames for the writer thread, at most `slots.size()`.
+        std::deque<Frame> frames;
+        bool quit;
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable changed;
+    };
+}
@@ -0,0 +1,371 @@
+/**
+ * Domain decomposition over worker processes.
+ * See decompose.hpp for details.
+ *
+ * @file decompose.cpp
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#include "decompose.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <vector>
+
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "importer.hpp"
+#include "lbm.hpp"
+#include "../sdl/window.hpp"
+#include "../print.hpp"
+
+using namespace pcs;
+
+
+// The results of a single worker, written to the shared memory.
+struct SlabResult {
+    bool ok;
+    double seconds;     // Time spent simulating.
+    double waitSeconds; // Time spent waiting for the other slabs.
+    LatticeBoltzmann::Summary summary;
+};
+
+// The memory shared by all workers. The halo data is double buffered (on
+// the parity of the frame), so that a single barrier per frame suffices:
+// a slab can only overwrite a buffer once all slabs have passed the next
+// barrier, and so have finished reading it.
+struct SharedMemory {
+    void* data;
+    size_t size;
+
+    pthread_barrier_t* barrier;
+    bool* failed;
+    SlabResult* results;
+    GLuint* halos;    // [parity][slab][left, right edge][haloSize(1, h)]
+    double* velocity; // [y][x][u_x, u_y] of the whole domain.
+};
+
+// The x range of a slab in the domain.
+struct Slab {
+    int x, width;
+};
+
+
+// Allocate the shared memory, which is inherited by the forked workers.
+static bool createSharedMemory( int slabs, int width, int height,
+                                SharedMemory& shared ) {
+
+    const size_t haloSize = LatticeBoltzmann::haloSize(1, height);
+    const size_t sizes[] = {
+        sizeof (pthread_barrier_t),
+        sizeof (bool),
+        slabs * sizeof (SlabResult),
+        2 * slabs * 2 * haloSize * sizeof (GLuint),
+        (size_t) width * height * 2 * sizeof (double),
+    };
+
+    // Align every part to 64 bytes.
+    size_t offsets[5];
+    shared.size = 0;
+    for (size_t i = 0; i < 5; ++i) {
+        offsets[i] = shared.size;
+        shared.size += (sizes[i] + 63) / 64 * 64;
+    }
+
+    shared.data = mmap(nullptr, shared.size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared.data == MAP_FAILED) {
+        print(INFO_, "Failed to allocate", shared.size,
+              "bytes of shared memory!");
+        return false;
+    }
+
+    char* base = (char*) shared.data;
+    shared.barrier  = (pthread_barrier_t*) (base + offsets[0]);
+    shared.failed   = (bool*) (base + offsets[1]);
+    shared.results  = (SlabResult*) (base + offsets[2]);
+    shared.halos    = (GLuint*) (base + offsets[3]);
+    shared.velocity = (double*) (base + offsets[4]);
+
+    pthread_barrierattr_t attr;
+    pthread_barrierattr_init(&attr);
+    pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_barrier_init(shared.barrier, &attr, slabs);
+    pthread_barrierattr_destroy(&attr);
+
+    return true;
+}
+
+static void destroySharedMemory( SharedMemory& shared ) {
+    pthread_barrier_destroy(shared.barrier);
+    munmap(shared.data, shared.size);
+}
+
+
+// Simulate a single slab, in a worker process. Every worker has to pass
+// through the same amount of barriers, even if it failed, or the others
+// would wait for it forever.
+static void runSlab( int index, const std::vector<Slab>& slabs,
+                     const std::string& file, double waterLevel,
+                     int width, int height,
+                     unsigned steps, unsigned seed, double viscosity,
+                     LatticeBoltzmann::Collision collision,
+                     double smagorinsky, SharedMemory& shared ) {
+
+    const Slab slab = slabs[index];
+    const int count = slabs.size();
+    const int w = slab.width + 2; // Including the halo columns.
+    const size_t haloSize = LatticeBoltzmann::haloSize(1, height);
+    SlabResult& result = shared.results[index];
+
+    Window window = createOpenGLWindow("LBM slab " + toString(index),
+                                       400, 400, true);
+    if (window.glContext == nullptr) {
+        *shared.failed = true;
+        pthread_barrier_wait(shared.barrier);
+        return;
+    }
+
+    {
+        GLRenderer renderer = GLRenderer();
+
+        GLint maxSize = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+        if (w > maxSize || height > maxSize) {
+            print(INFO_, "Slab", index, "of size", w, "x", height,
+                  "exceeds the maximum texture size of", maxSize, "!");
+            *shared.failed = true;
+        }
+
+        // Import only the columns of the slab, including the halo columns
+        // (which wrap around for the periodic boundaries).
+        const GLuint background = gl::genUTexture(w, height);
+        MapImporter importer(file, waterLevel);
+        if (!importer.upload(background, slab.x - 1, w, 0, 0)) {
+            *shared.failed = true;
+        }
+        importer.close();
+
+        LatticeBoltzmann lbm = LatticeBoltzmann(renderer, background,
+                                                w, height);
+        lbm.setSeed(seed);
+        lbm.setViscosity(viscosity);
+        lbm.setCollision(collision);
+        lbm.setSmagorinsky(smagorinsky);
+        lbm.setOrigin(slab.x - 1, 0);
+
+        // The pixel buffer for the asynchronous edge read back.
+        GLuint pbo;
+        glGenBuffers(1, &pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, 2 * haloSize * sizeof (GLuint),
+                     nullptr, GL_STREAM_READ);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        // Wait until all slabs are set up.
+        glFinish();
+        pthread_barrier_wait(shared.barrier);
+        if (*shared.failed) {
+            glDeleteBuffers(1, &pbo);
+            lbm.close();
+            renderer.close();
+            destroyWindow(window);
+            return;
+        }
+
+        double waitSeconds = 0.0;
+        const auto start = std::chrono::steady_clock::now();
+
+        for (unsigned i = 0; i < steps; ++i) {
+            GLuint* halos = shared.halos + (i % 2) * count * 2 * haloSize;
+
+            // Render the edges, and start reading them back.
+            lbm.stepRegion(renderer, 1, 0, 1, height);
+            lbm.stepRegion(renderer, slab.width, 0, 1, height);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+            lbm.readHalo(1, 0, 1, height, 0);
+            lbm.readHalo(slab.width, 0, 1, height, haloSize * sizeof (GLuint));
+            glFlush();
+
+            // Render the interior while the edges are transferred.
+            if (slab.width > 2) {
+                lbm.stepRegion(renderer, 2, 0, slab.width - 2, height);
+            }
+            lbm.finishFrame();
+
+            // Publish the edges of this slab.
+            const GLuint* edges = (const GLuint*) glMapBufferRange(
+                GL_PIXEL_PACK_BUFFER, 0, 2 * haloSize * sizeof (GLuint),
+                GL_MAP_READ_BIT);
+            if (edges != nullptr) {
+                std::memcpy(halos + index * 2 * haloSize, edges,
+                            2 * haloSize * sizeof (GLuint));
+            }
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+            const auto waitStart = std::chrono::steady_clock::now();
+            pthread_barrier_wait(shared.barrier);
+            const std::chrono::duration<double> waited =
+                std::chrono::steady_clock::now() - waitStart;
+            waitSeconds += waited.count();
+
+            // The right edge of the left neighbour and the left edge of the
+            // right neighbour become the halo columns.
+            const int left = (index + count - 1) % count;
+            const int right = (index + 1) % count;
+            lbm.writeHalo(0, 0, 1, height,
+                          halos + (left * 2 + 1) * haloSize);
+            lbm.writeHalo(slab.width + 1, 0, 1, height,
+                          halos + right * 2 * haloSize);
+        }
+
+        glFinish();
+        const std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        result.seconds = elapsed.count();
+        result.waitSeconds = waitSeconds;
+        result.summary = lbm.summarise(1, 0, slab.width, height);
+
+        // Gather the velocity field of the interior.
+        std::vector<double> u;
+        std::vector<bool> walls;
+        lbm.readVelocity(1, 0, slab.width, height, u, walls);
+        for (int y = 0; y < height; ++y) {
+            std::copy(&u[(size_t) y * slab.width * 2],
+                      &u[(size_t) (y + 1) * slab.width * 2],
+                      &shared.velocity[((size_t) y * width + slab.x) * 2]);
+        }
+
+        result.ok = !gl::checkErrors("slab " + toString(index));
+
+        glDeleteBuffers(1, &pbo);
+        lbm.close();
+        renderer.close();
+    }
+
+    destroyWindow(window);
+}
+
+
+int pcs::runDecomposed( const std::string& file, double waterLevel,
+                        int slabCount, unsigned steps, unsigned seed,
+                        double viscosity,
+                        LatticeBoltzmann::Collision collision,
+                        double smagorinsky ) {
+
+    // Only the size is read here, every worker imports its own columns.
+    MapImporter header(file, waterLevel);
+    if (!header.isOpen()) {
+        return 1;
+    }
+    const int width = header.getWidth(), height = header.getHeight();
+    header.close();
+
+    // Every slab needs two edge columns of its own.
+    if (slabCount < 1 || width / slabCount < 2) {
+        print(INFO_, "Cannot split a domain of width", width, "into",
+              slabCount, "slabs!");
+        return 1;
+    }
+
+    std::vector<Slab> slabs(slabCount);
+    for (int i = 0; i < slabCount; ++i) {
+        slabs[i].x = (int) ((long) width * i / slabCount);
+        slabs[i].width = (int) ((long) width * (i + 1) / slabCount) - slabs[i].x;
+    }
+
+    SharedMemory shared;
+    if (!createSharedMemory(slabCount, width, height, shared)) {
+        return 1;
+    }
+
+    print("Splitting", file, "of size", width, "x", height, "into",
+          slabCount, "slabs.");
+
+    // Start the workers.
+    std::vector<pid_t> workers;
+    for (int i = 0; i < slabCount; ++i) {
+        const pid_t pid = fork();
+        if (pid == 0) {
+            runSlab(i, slabs, file, waterLevel, width, height, steps, seed,
+                    viscosity, collision, smagorinsky, shared);
+            _exit(shared.results[i].ok ? 0 : 1);
+        }
+        if (pid < 0) {
+            print(INFO_, "Failed to start the worker of slab", i, "!");
+            for (pid_t worker : workers) kill(worker, SIGKILL);
+            for (pid_t worker : workers) waitpid(worker, nullptr, 0);
+            destroySharedMemory(shared);
+            return 1;
+        }
+        workers.push_back(pid);
+    }
+
+    bool ok = true;
+    for (pid_t worker : workers) {
+        int status;
+        waitpid(worker, &status, 0);
+        ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+
+    if (!ok || *shared.failed) {
+        print(INFO_, "The decomposed run failed!");
+        destroySharedMemory(shared);
+        return 1;
+    }
+
+    // Combine the results of the slabs. The run is as slow as the slowest
+    // slab.
+    LatticeBoltzmann::Summary total = {0, 0, 0.0, 0.0, 0.0, 0.0, 0.0, 0};
+    double seconds = 0.0;
+    for (int i = 0; i < slabCount; ++i) {
+        const SlabResult& result = shared.results[i];
+        const LatticeBoltzmann::Summary& s = result.summary;
+        seconds = std::max(seconds, result.seconds);
+
+        print("Slab", i, "x:", slabs[i].x, "width:", slabs[i].width,
+              "time:", result.seconds, "s", "waiting:", result.waitSeconds, "s",
+              "MLUPS:",
+              (double) slabs[i].width * height * steps / result.seconds / 1e6);
+
+        total.fluidCells += s.fluidCells;
+        total.wallCells += s.wallCells;
+        total.mass += s.mass;
+        total.totalMass += s.totalMass;
+        total.meanSpeed += s.meanSpeed * s.fluidCells;
+        total.maxSpeed = std::max(total.maxSpeed, s.maxSpeed);
+    }
+    if (total.fluidCells > 0) {
+        total.meanSpeed /= total.fluidCells;
+    }
+
+    // Hash the velocity field (FNV-1a), which is independent of the
+    // amount of slabs.
+    total.checksum = 14695981039346656037ull;
+    for (size_t i = 0; i < (size_t) width * height * 2; ++i) {
+        uint64_t value;
+        std::memcpy(&value, &shared.velocity[i], sizeof (value));
+        total.checksum = (total.checksum ^ value) * 1099511628211ull;
+    }
+
+    const double cells = (double) width * height;
+    print("Simulated", steps, "frames on", slabCount, "slabs in", seconds, "s");
+    print("Throughput:", cells * steps / seconds / 1e6, "MLUPS");
+    print("fluid:", total.fluidCells, "walls:", total.wallCells,
+          "mass:", total.mass, "total mass:", total.totalMass,
+          "mean |u|:", total.meanSpeed, "max |u|:", total.maxSpeed,
+          "velocity checksum:", total.checksum);
+
+    destroySharedMemory(shared);
+    return 0;
+}
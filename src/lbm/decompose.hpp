@@ -0,0 +1,66 @@
+/**
+ * Domain decomposition, which splits a river domain into slabs that are
+ * each simulated by their own worker process and OpenGL context.
+ *
+ * @file decompose.hpp
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#pragma once
+
+#include <string>
+
+#include "lbm.hpp"
+
+namespace pcs {
+
+    /**
+     * Simulate a river bitmap split into `slabs` vertical slabs (along x).
+     * Every slab is run by a forked worker process with its own hidden
+     * window and OpenGL context, so a domain is not limited by the memory
+     * or `GL_MAX_TEXTURE_SIZE` of a single context, only by its height.
+     *
+     * Every slab lattice has a halo column on both sides. Each frame the
+     * two edge columns of a slab are rendered first, and read back
+     * asynchronously into a pixel buffer while the interior is rendered.
+     * The edges are then exchanged with the neighbouring slabs through
+     * shared memory (synchronised with a process shared barrier), and
+     * written into the halo columns. Only the streamed f_i values are
+     * exchanged, as these are all a cell reads from its neighbours. The
+     * first and last slab are neighbours as well, for the periodic
+     * boundaries.
+     *
+     * Since the random numbers are keyed on the position in the whole
+     * domain, the results do not depend on the amount of slabs. At the end
+     * the throughput, the time spent waiting for the other slabs and a
+     * summary of the domain are printed, including a checksum of the
+     * velocity field.
+     *
+     * The collision operator acts on every cell by itself, so any of them
+     * can be used. The shallow water model and the suspended sediment are
+     * not available, as they also read the depth and bed, or the
+     * concentration, of the neighbouring cells.
+     *
+     * Every worker imports only the columns of its slab (see
+     * `MapImporter`), so the whole map is never held in host memory, and
+     * PNG maps and heightmaps can be used as well.
+     *
+     * @param file The path to the river .bmp or .png file
+     * @param waterLevel The water level, if it is a heightmap
+     * @param slabs The amount of slabs (and worker processes)
+     * @param steps The amount of frames to simulate
+     * @param seed The seed for the random numbers
+     * @param viscosity The viscosity of the fluid
+     * @param collision The collision operator
+     * @param smagorinsky The constant of the Smagorinsky model, or 0
+     * @return The exit code, 0 on success.
+     */
+    int runDecomposed( const std::string& file, double waterLevel,
+                       int slabs, unsigned steps, unsigned seed,
+                       double viscosity,
+                       LatticeBoltzmann::Collision collision,
+                       double smagorinsky );
+}
@@ -0,0 +1,146 @@
+/**
+ * Computes the derived fields of the LBM simulation: the vorticity, the
+ * strain rate, the viscous stress and the shear on the walls.
+ *
+ * @file derived.frag
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#version 430
+
+precision highp float;
+precision highp usampler2D;
+
+layout(location = 0) out uvec4 o_derived[3];
+
+layout(location = 3) uniform usampler2D u_textures[7];
+layout(location = 10) uniform double u_viscosity;
+layout(location = 11) uniform double u_smagorinsky; // The constant, or 0.
+
+
+// The constants, `wall_force()` and `smagorinsky_omega()`, without the
+// update of the cells.
+#define SHARED_ONLY
+#include "lbm.glsl"
+
+// The f_i directions of `lbm.glsl` as cell offsets.
+const ivec2 offset[9] = ivec2[9](ivec2(0, 0),  ivec2(1, 0),   ivec2(0, 1),
+                                 ivec2(-1, 0), ivec2(0, -1),  ivec2(1, 1),
+                                 ivec2(-1, 1), ivec2(-1, -1), ivec2(1, -1));
+
+
+// Get the first or second double of a texel, with periodic boundaries like
+// the repeating textures of `lbm.frag`.
+double get1f( in usampler2D textr, in ivec2 loc ) {
+    ivec2 size = textureSize(textr, 0);
+    return packDouble2x32(texelFetch(textr, (loc + size) % size, 0).rg);
+}
+
+double get2f( in usampler2D textr, in ivec2 loc ) {
+    ivec2 size = textureSize(textr, 0);
+    return packDouble2x32(texelFetch(textr, (loc + size) % size, 0).ba);
+}
+
+bool isWallAt( in ivec2 loc ) {
+    ivec2 size = textureSize(u_textures[0], 0);
+    return texelFetch(u_textures[0], (loc + size) % size, 0).a != 0;
+}
+
+// The velocity of a neighbour, where walls do not slip.
+dvec2 velocityAt( in ivec2 loc ) {
+    if (isWallAt(loc)) {
+        return dvec2(0.0);
+    }
+    return dvec2(get1f(u_textures[1], loc), get2f(u_textures[1], loc));
+}
+
+
+void main() {
+
+    double omega = 2 / (6 * u_viscosity + 1);
+
+    ivec2 loc = ivec2(gl_FragCoord.xy);
+    bool isWall = isWallAt(loc);
+
+    // The f_i values streamed to this cell, which the next frame collides,
+    // and this cell's own values.
+    double f[9] = double[9](
+        get2f(u_textures[2], loc),
+        get1f(u_textures[3], loc - offset[1]),
+        get2f(u_textures[3], loc - offset[2]),
+        get1f(u_textures[4], loc - offset[3]),
+        get2f(u_textures[4], loc - offset[4]),
+        get1f(u_textures[5], loc - offset[5]),
+        get2f(u_textures[5], loc - offset[6]),
+        get1f(u_textures[6], loc - offset[7]),
+        get2f(u_textures[6], loc - offset[8])
+    );
+
+    double vorticity = 0.0, strain = 0.0, shear = 0.0;
+    dvec3 stress = dvec3(0.0); // xx, xy, yy
+
+    if (!isWall) {
+
+        // Vorticity, with central differences.
+        dvec2 du_dx = (velocityAt(loc + ivec2(1, 0)) -
+                       velocityAt(loc - ivec2(1, 0))) / 2.0;
+        dvec2 du_dy = (velocityAt(loc + ivec2(0, 1)) -
+                       velocityAt(loc - ivec2(0, 1))) / 2.0;
+        vorticity = du_dx.y - du_dy.x;
+
+        // The moments of the streamed values, as `lbm.frag` computes them.
+        double rho = 0.0;
+        dvec2 u = dvec2(0.0);
+        for (int i = 0; i < 9; i++) {
+            rho += abs(f[i]);
+            u += dvec2(e[i]) * abs(f[i]);
+        }
+        u /= rho;
+
+        // The non-equilibrium momentum flux Pi_neq.
+        double udotu = dot(u, u);
+        double f_neq[9];
+        dvec3 pi_neq = dvec3(0.0);
+        for (int i = 0; i < 9; i++) {
+            dvec2 ei = dvec2(e[i]);
+            double edotu = 3.0 * dot(ei, u);
+            double f_eq = w[i] * rho * (1 + edotu + edotu * edotu / 2.0 -
+                                        1.5 * udotu);
+            f_neq[i] = abs(f[i]) - f_eq;
+            pi_neq += dvec3(ei.x * ei.x, ei.x * ei.y, ei.y * ei.y) *
+                      f_neq[i];
+        }
+
+        // The relaxation rate of the collision, raised by the eddy
+        // viscosity where the subgrid model is enabled.
+        if (u_smagorinsky > 0.0) {
+            omega = smagorinsky_omega(omega, f_neq, rho, u_smagorinsky);
+        }
+
+        // The strain rate S = -3 omega / (2 rho) Pi_neq, of which the
+        // magnitude is sqrt(2 S:S), and the viscous stress
+        // 2 rho nu S = -(1 - omega / 2) Pi_neq.
+        dvec3 S = -3.0 * omega / (2.0 * rho) * pi_neq;
+        strain = sqrt(2.0 * (S.x * S.x + 2.0 * S.y * S.y + S.z * S.z));
+        stress = -(1.0 - omega / 2.0) * pi_neq;
+    }
+    else {
+
+        // The force which erodes the walls in the next frame of `lbm.frag`.
+        double phi[9] = double[9](
+            0.0,
+            get1f(u_textures[3], loc), get2f(u_textures[3], loc),
+            get1f(u_textures[4], loc), get2f(u_textures[4], loc),
+            get1f(u_textures[5], loc), get2f(u_textures[5], loc),
+            get1f(u_textures[6], loc), get2f(u_textures[6], loc)
+        );
+        shear = length(wall_force(phi, f));
+    }
+
+    o_derived[0] = uvec4(unpackDouble2x32(vorticity), unpackDouble2x32(strain));
+    o_derived[1] = uvec4(unpackDouble2x32(stress.x), unpackDouble2x32(stress.y));
+    o_derived[2] = uvec4(unpackDouble2x32(stress.z), unpackDouble2x32(shear));
+}
@@ -0,0 +1,479 @@
+/**
+ * Importing river maps. See importer.hpp for details.
+ *
+ * @file importer.cpp
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#include "importer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <png.h>
+
+#include "../print.hpp"
+
+using namespace pcs;
+
+
+// The size of the converted flags of a band of rows, in bytes.
+static const size_t bandBytes = 32 << 20;
+
+// Get the amount of rows per band for a map of width `width`.
+static int bandRows( int width ) {
+    return std::max<int>(1, bandBytes / (width * 4 * sizeof (GLuint)));
+}
+
+// Run `function(first, last)` over the rows [0, rows), split up over
+// several threads.
+static void parallelRows( int rows, std::function<void(int, int)> function ) {
+    const int threads = std::max(1, std::min<int>(
+        std::thread::hardware_concurrency(), rows / 16));
+
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threads; ++i) {
+        workers.emplace_back(function, rows * i / threads,
+                             rows * (i + 1) / threads);
+    }
+    function(0, rows / threads);
+    for (std::thread& worker : workers) worker.join();
+}
+
+// Read a little endian integer from unaligned memory.
+static uint32_t read32( const uint8_t* ptr ) {
+    return ptr[0] | ptr[1] << 8 | ptr[2] << 16 | (uint32_t) ptr[3] << 24;
+}
+
+// Upload a band of flags to rows [y, y + rows) of the texture, from column
+// `x`.
+static void uploadBand( GLuint texture, int x, int width, int y, int rows,
+                        const std::vector<GLuint>& flags ) {
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, rows, GL_RGBA_INTEGER,
+                    GL_UNSIGNED_INT, flags.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// Repeat every converted row of a band `scale - 1` times, from the last
+// row, so that a band of `rows` rows becomes `rows * scale` rows.
+template<typename T>
+static void repeatRows( std::vector<T>& band, size_t rowSize, int rows,
+                        int scale ) {
+    for (int i = rows - 1; i >= 0 && scale > 1; --i) {
+        for (int j = scale - 1; j >= 0 && i * scale + j > i; --j) {
+            std::copy(band.begin() + i * rowSize,
+                      band.begin() + (i + 1) * rowSize,
+                      band.begin() + (i * scale + j) * rowSize);
+        }
+    }
+}
+
+
+// A PNG file opened for reading with libpng. Since libpng reports errors
+// with longjmp, the functions which call into it keep no objects with
+// destructors.
+struct PngFile {
+    FILE* fp = nullptr;
+    png_structp png = nullptr;
+    png_infop info = nullptr;
+};
+
+static void closePng( PngFile& file ) {
+    if (file.png != nullptr) {
+        png_destroy_read_struct(&file.png, &file.info, nullptr);
+    }
+    if (file.fp != nullptr) {
+        fclose(file.fp);
+    }
+    file = PngFile();
+}
+
+// Open a PNG file and read its header. The rows are transformed to 8 bit
+// RGB for colour images, or 16 bit (big endian) gray for heightmaps.
+static bool openPng( const char* path, PngFile& file, int* width, int* height,
+                     bool* heightmap, bool* interlaced ) {
+
+    png_byte signature[8];
+    file.fp = fopen(path, "rb");
+    if (file.fp == nullptr || fread(signature, 1, 8, file.fp) != 8 ||
+        png_sig_cmp(signature, 0, 8) != 0) {
+        return false;
+    }
+
+    file.png = png_create_read_struct(PNG_LIBPNG_VER_STRING,
+                                      nullptr, nullptr, nullptr);
+    if (file.png == nullptr) return false;
+    file.info = png_create_info_struct(file.png);
+    if (file.info == nullptr) return false;
+
+    if (setjmp(png_jmpbuf(file.png))) {
+        return false;
+    }
+
+    png_init_io(file.png, file.fp);
+    png_set_sig_bytes(file.png, 8);
+    png_read_info(file.png, file.info);
+
+    const int colorType = png_get_color_type(file.png, file.info);
+    const int bitDepth = png_get_bit_depth(file.png, file.info);
+    *heightmap = !(colorType & PNG_COLOR_MASK_COLOR);
+    *interlaced = png_get_interlace_type(file.png, file.info) !=
+                  PNG_INTERLACE_NONE;
+
+    if (colorType == PNG_COLOR_TYPE_PALETTE) {
+        png_set_palette_to_rgb(file.png);
+    }
+    if (colorType & PNG_COLOR_MASK_ALPHA) {
+        png_set_strip_alpha(file.png);
+    }
+    if (*heightmap) {
+        if (bitDepth < 8) png_set_expand_gray_1_2_4_to_8(file.png);
+        if (bitDepth < 16) png_set_expand_16(file.png);
+    }
+    else if (bitDepth == 16) {
+        png_set_strip_16(file.png);
+    }
+    png_read_update_info(file.png, file.info);
+
+    *width = png_get_image_width(file.png, file.info);
+    *height = png_get_image_height(file.png, file.info);
+    return true;
+}
+
+// Read the next `count` rows of a PNG file.
+static bool readPngRows( PngFile& file, png_bytepp rows, int count ) {
+    if (setjmp(png_jmpbuf(file.png))) {
+        return false;
+    }
+    png_read_rows(file.png, rows, nullptr, count);
+    return true;
+}
+
+
+MapImporter::MapImporter( const std::string& file_, double waterLevel_ ) {
+
+    file = file_;
+    waterLevel = waterLevel_;
+    open = heightmap = false;
+    width = height = 0;
+    map = nullptr;
+    mapSize = 0;
+
+    // PNG files are opened again when uploading, only read the header.
+    PngFile png;
+    bool interlaced;
+    if (openPng(file.c_str(), png, &width, &height, &heightmap, &interlaced)) {
+        closePng(png);
+        if (interlaced) {
+            print(INFO_, "Interlaced PNG files like", "["+file+"]",
+                  "are not supported!");
+            return;
+        }
+        open = true;
+        return;
+    }
+    closePng(png);
+
+    // Memory map the bitmap.
+    const int fd = ::open(file.c_str(), O_RDONLY);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0) {
+        print(INFO_, "Failed to load the map at", "["+file+"]",
+              "! Does it exists?");
+        if (fd >= 0) ::close(fd);
+        return;
+    }
+
+    mapSize = status.st_size;
+    void* data = mmap(nullptr, mapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        print(INFO_, "Failed to map the file", "["+file+"]", "!");
+        mapSize = 0;
+        return;
+    }
+    map = (const uint8_t*) data;
+
+    // Read the header of the bitmap.
+    if (mapSize < 54 || map[0] != 'B' || map[1] != 'M') {
+        print(INFO_, "The map", "["+file+"]", "is not a bitmap or PNG file!");
+        close();
+        return;
+    }
+
+    pixelOffset = read32(&map[10]);
+    const uint32_t hsize = read32(&map[14]);   // Header size.
+    width = (int32_t) read32(&map[18]);
+    const int32_t h = (int32_t) read32(&map[22]);
+    const int bpp = map[28] | map[29] << 8;    // Bits per pixel.
+    const uint32_t comprm = read32(&map[30]);  // Compression method.
+
+    // Uncompressed 24 or 32 bit pixels, or 32 bit pixels with bit masks.
+    if (hsize < 40 || width <= 0 || h == 0 ||
+        (bpp != 24 && bpp != 32) ||
+        !(comprm == 0 || (comprm == 3 && bpp == 32 && mapSize >= 66))) {
+
+        print(INFO_, "Bitmap type from", "["+file+"]", "is not supported!");
+        close();
+        return;
+    }
+
+    height = std::abs(h);
+    topDown = h < 0;
+    bytesPerPixel = bpp / 8;
+    rowSize = ((size_t) bpp * width + 31) / 32 * 4;
+
+    if (comprm == 3) {
+        for (int i = 0; i < 3; ++i) masks[i] = read32(&map[54 + 4 * i]);
+    }
+    else {
+        masks[0] = 0xff0000;
+        masks[1] = 0x00ff00;
+        masks[2] = 0x0000ff;
+    }
+
+    if (pixelOffset + rowSize * height > mapSize) {
+        print(INFO_, "The bitmap", "["+file+"]", "is truncated!");
+        close();
+        return;
+    }
+
+    open = true;
+}
+
+void MapImporter::close() {
+    if (map != nullptr) {
+        munmap((void*) map, mapSize);
+        map = nullptr;
+    }
+    open = false;
+}
+
+bool MapImporter::upload( GLuint texture, GLuint elevation ) {
+    return upload(texture, 0, width, 0, 0, 1, elevation);
+}
+
+bool MapImporter::upload( GLuint texture, int x, int w, int targetX,
+                          int targetY, int scale, GLuint elevation ) {
+
+    if (!open || w < 1 || scale < 1) {
+        return false;
+    }
+
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    if ((long) w * scale > maxSize || (long) height * scale > maxSize) {
+        print(INFO_, "The map", "["+file+"]", "of size", w, "x", height,
+              "at scale", scale, "exceeds the maximum texture size of",
+              maxSize, "!");
+        return false;
+    }
+
+    Region region;
+    region.columns.resize((size_t) w * scale);
+    for (size_t i = 0; i < region.columns.size(); ++i) {
+        region.columns[i] = ((x + (int) i / scale) % width + width) % width;
+    }
+    region.targetX = targetX;
+    region.targetY = targetY;
+    region.scale = scale;
+
+    const auto start = std::chrono::steady_clock::now();
+    const bool success = map != nullptr ? uploadBitmap(texture, region)
+                                        : uploadPng(texture, elevation,
+                                                    region);
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    if (success) {
+        print("Imported", file, "of size", width, "x", height, "in",
+              elapsed.count(), "s");
+    }
+    return success && !gl::checkErrors("map import");
+}
+
+bool MapImporter::uploadBitmap( GLuint texture, const Region& region ) {
+
+    const int w = region.columns.size(), scale = region.scale;
+    const int rows = std::max(1, bandRows(w) / scale);
+    std::vector<GLuint> flags((size_t) w * rows * scale * 4);
+
+    for (int y0 = 0; y0 < height; y0 += rows) {
+        const int count = std::min(rows, height - y0);
+
+        parallelRows(count, [&]( int first, int last ) {
+            for (int i = first; i < last; ++i) {
+                const int y = y0 + i;
+                const uint8_t* row = map + pixelOffset +
+                                     rowSize * (topDown ? height - 1 - y : y);
+                GLuint* dst = &flags[(size_t) i * w * 4];
+
+                for (int x : region.columns) {
+                    const uint8_t* src = row + (size_t) x * bytesPerPixel;
+                    const uint32_t pixel = bytesPerPixel == 4 ? read32(src) :
+                        src[0] | src[1] << 8 | src[2] << 16;
+                    *(dst++) = (pixel & masks[0]) != 0;
+                    *(dst++) = (pixel & masks[1]) != 0;
+                    *(dst++) = (pixel & masks[2]) != 0;
+                    *(dst++) = 0;
+                }
+            }
+        });
+
+        repeatRows(flags, (size_t) w * 4, count, scale);
+        uploadBand(texture, region.targetX, w, region.targetY + y0 * scale,
+                   count * scale, flags);
+    }
+
+    return true;
+}
+
+bool MapImporter::uploadPng( GLuint texture, GLuint elevation,
+                             const Region& region ) {
+
+    const int w = region.columns.size(), scale = region.scale;
+    const int rows = std::max(1, bandRows(std::max(width, w)) / scale);
+    const size_t rowBytes = (size_t) width * (heightmap ? 2 : 3);
+    std::vector<png_byte> band(rowBytes * rows);
+    std::vector<png_bytep> rowPointers(rows);
+    for (int i = 0; i < rows; ++i) {
+        rowPointers[i] = &band[rowBytes * i];
+    }
+
+    PngFile png;
+    bool gray, interlaced;
+    int pngWidth, pngHeight;
+
+    // For heightmaps, first find the range of the elevation to get the
+    // water level.
+    uint16_t level = 0, low = 0xffff, high = 0;
+    if (heightmap) {
+        std::mutex mutex;
+
+        if (!openPng(file.c_str(), png, &pngWidth, &pngHeight, &gray,
+                     &interlaced)) {
+            closePng(png);
+            return false;
+        }
+        for (int r0 = 0; r0 < height; r0 += rows) {
+            const int count = std::min(rows, height - r0);
+            if (!readPngRows(png, rowPointers.data(), count)) {
+                closePng(png);
+                return false;
+            }
+            parallelRows(count, [&]( int first, int last ) {
+                uint16_t localLow = 0xffff, localHigh = 0;
+                for (const png_byte* p = band.data() + rowBytes * first;
+                     p < band.data() + rowBytes * last; p += 2) {
+                    const uint16_t elevation = p[0] << 8 | p[1];
+                    localLow = std::min(localLow, elevation);
+                    localHigh = std::max(localHigh, elevation);
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                low = std::min(low, localLow);
+                high = std::max(high, localHigh);
+            });
+        }
+        closePng(png);
+
+        level = low + (uint16_t) (std::max(0.0, std::min(1.0, waterLevel)) *
+                                  (high - low));
+        print("Heightmap", file, "elevation:", low, "to", high,
+              "water level:", level);
+    }
+
+    if (!openPng(file.c_str(), png, &pngWidth, &pngHeight, &gray,
+                 &interlaced)) {
+        closePng(png);
+        return false;
+    }
+
+    // The rows of a PNG file are stored top down.
+    std::vector<GLuint> flags((size_t) w * rows * scale * 4);
+    std::vector<float> elevations;
+    if (heightmap && elevation != 0) {
+        elevations.resize((size_t) w * rows * scale);
+    }
+    const float range = high > low ? high - low : 1.f;
+    for (int r0 = 0; r0 < height; r0 += rows) {
+        const int count = std::min(rows, height - r0);
+        if (!readPngRows(png, rowPointers.data(), count)) {
+            closePng(png);
+            return false;
+        }
+
+        parallelRows(count, [&]( int first, int last ) {
+            for (int i = first; i < last; ++i) {
+                GLuint* dst = &flags[(size_t) (count - 1 - i) * w * 4];
+                float* bed = elevations.empty() ? nullptr :
+                             &elevations[(size_t) (count - 1 - i) * w];
+
+                for (int x : region.columns) {
+                    if (heightmap) {
+                        // Cells above the water level become walls.
+                        const png_byte* src = rowPointers[i] + 2 * x;
+                        const uint16_t elevation = src[0] << 8 | src[1];
+                        if (bed != nullptr) {
+                            *(bed++) = (elevation - low) / range;
+                        }
+                        *(dst++) = 0;
+                        *(dst++) = elevation > level;
+                        *(dst++) = 0;
+                    }
+                    else {
+                        const png_byte* src = rowPointers[i] + 3 * x;
+                        *(dst++) = src[0] != 0;
+                        *(dst++) = src[1] != 0;
+                        *(dst++) = src[2] != 0;
+                    }
+                    *(dst++) = 0;
+                }
+            }
+        });
+
+        const int y = region.targetY + (height - r0 - count) * scale;
+        repeatRows(flags, (size_t) w * 4, count, scale);
+        uploadBand(texture, region.targetX, w, y, count * scale, flags);
+        if (!elevations.empty()) {
+            repeatRows(elevations, (size_t) w, count, scale);
+            glBindTexture(GL_TEXTURE_2D, elevation);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, region.targetX, y, w,
+                            count * scale, GL_RED, GL_FLOAT,
+                            elevations.data());
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+    }
+
+    closePng(png);
+    return true;
+}
+
+
+GLuint pcs::genFlagsTexture( int width, int height, const float* pixels ) {
+
+    // Every non zero color becomes a flag, and walls are always added
+    // through the green (`addWall`) flag.
+    std::vector<GLuint> flags((size_t) width * height * 4);
+    for (size_t i = 0; i < flags.size(); i += 4) {
+        flags[i] = pixels[i] != 0.f;
+        flags[i + 1] = pixels[i + 1] != 0.f;
+        flags[i + 2] = pixels[i + 2] != 0.f;
+        flags[i + 3] = 0;
+    }
+    return gl::genUTexture(width, height, flags.data());
+}
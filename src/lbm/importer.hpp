@@ -0,0 +1,138 @@
+/**
+ * Importing river maps straight into the packed cell flags of the model.
+ *
+ * @file importer.hpp
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../opengl/opengl.hpp"
+
+namespace pcs {
+
+    /**
+     * The MapImporter reads a river map and converts it to the cell flags of
+     * texture 0 of the model (see `LatticeBoltzmann`), without ever keeping
+     * the whole image in memory as floats. The input is processed in bands
+     * of rows: every band is converted by several threads, and uploaded
+     * with `glTexSubImage2D`, so that very large maps load quickly.
+     *
+     * Supported are:
+     *  - BMP files with 24 or 32 bits per pixel, bottom up or top down,
+     *    which are memory mapped. The colors are interpreted as described
+     *    in the README.
+     *  - PNG files, which are streamed row by row through libpng. Colour
+     *    images are interpreted the same as bitmaps. Grayscale images
+     *    (8 or 16 bits) are heightmaps, where all cells above the water
+     *    level become walls.
+     */
+    class MapImporter {
+    public:
+
+        /**
+         * Open a map file and read its header.
+         *
+         * @param file The path to the .bmp or .png file
+         * @param waterLevel For heightmaps, the level above which cells are
+         *                   walls, relative to the lowest (0) and highest
+         *                   (1) elevation in the map
+         */
+        MapImporter( const std::string& file, double waterLevel = 0.1 );
+
+        /**
+         * Close the file.
+         */
+        void close();
+
+        /**
+         * Convert the map to cell flags and upload them to an unsigned
+         * integer texture (see `gl::genUTexture()`) of the size of the map.
+         * The elevation of a heightmap can be uploaded in the same pass, to
+         * a single channel float texture of the size of the map, relative
+         * to the lowest (0) and highest (1) elevation. It is not written
+         * for other maps.
+         *
+         * @param texture The texture to upload to
+         * @param elevation The elevation texture, or 0 to skip it
+         * @return True on success, false otherwise.
+         */
+        bool upload( GLuint texture, GLuint elevation = 0 );
+
+        /**
+         * Convert a part of the map and upload it into a larger texture,
+         * like the slab of a decomposed run (see decompose.hpp) or the
+         * place of the map in a batch atlas (see batch.hpp), so that only
+         * that part is ever converted. The columns wrap around the sides of
+         * the map, like the periodic boundaries. Every cell can be scaled
+         * up, to the nearest neighbour, like the benchmark does.
+         *
+         * @param texture The texture to upload to
+         * @param x The first column of the map
+         * @param w The amount of columns
+         * @param targetX The column of the texture of the first column
+         * @param targetY The row of the texture of the bottom row
+         * @param scale The size of every cell in the texture
+         * @param elevation The elevation texture, or 0 to skip it
+         * @return True on success, false otherwise.
+         */
+        bool upload( GLuint texture, int x, int w, int targetX, int targetY,
+                     int scale = 1, GLuint elevation = 0 );
+
+        // Getters for the state and dimensions of the map.
+        inline bool isOpen() const { return open; }
+        inline bool isHeightmap() const { return heightmap; }
+        inline int getWidth() const { return width; }
+        inline int getHeight() const { return height; }
+
+    private:
+
+        // The part of the map to upload, and where to, see `upload()`.
+        struct Region {
+            std::vector<int> columns; // The column of the map of every cell.
+            int targetX, targetY, scale;
+        };
+
+        // Convert and upload the rows of a memory mapped bitmap.
+        bool uploadBitmap( GLuint texture, const Region& region );
+
+        // Convert and upload the rows of a PNG file, and the elevation of
+        // heightmaps if `elevation` is not 0.
+        bool uploadPng( GLuint texture, GLuint elevation,
+                        const Region& region );
+
+        std::string file;
+        double waterLevel;
+        bool open, heightmap;
+        int width, height;
+
+        // The memory mapped bitmap file.
+        const uint8_t* map;
+        size_t mapSize;
+
+        // The bitmap layout.
+        size_t pixelOffset, rowSize;
+        int bytesPerPixel;
+        bool topDown;
+        uint32_t masks[3]; // The red, green and blue bits of a pixel.
+    };
+
+    /**
+     * Create a cell flags texture (for the `LatticeBoltzmann` constructor)
+     * from pixel data formatted as for `gl::genTexture()`, like the data
+     * returned by `gl::loadBitmap()`.
+     *
+     * @param width The width of the texture
+     * @param height The height of the texture
+     * @param pixels The RGBA pixel data
+     * @return The texture id.
+     */
+    GLuint genFlagsTexture( int width, int height, const float* pixels );
+}
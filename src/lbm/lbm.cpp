@@ -11,11 +11,25 @@
 
 #include "lbm.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#include "importer.hpp"
 #include "../print.hpp"
+#include "../opengl/profiler.hpp"
 
 using namespace pcs;
 
 
+// The programs shared by all lattices, which are compiled by the first
+// lattice and deleted with the last one, see `keepPrograms()`.
+static GLuint sharedPrograms[LatticeBoltzmann::programCount] = {0};
+static size_t programUsers = 0;
+static bool programsKept = false;
+
+
 // Flow constants.
 static const double e_x[9] = {0., 1.,  0., -1., 0.,  1., -1., -1., 1.};
 static const double e_y[9] = {0., 0., 1., 0., -1., 1., 1.,  -1., -1.};
@@ -32,23 +46,83 @@ static const double rho0 = 1.0;  // The initial rho (density).
 static const double u0_x = 0.0;  // The initial x velocity.
 static const double u0_y = 0.0;  // The initial y velocity.
 
-static double calc_feq( int i ) {
-    const double udotu = u0_x * u0_x + u0_y * u0_y;
-    double edotu_c = 3.0 * (e_x[i] * u0_x + e_y[i] * u0_y) / c;
+static double calc_feq( int i, double u_x, double u_y ) {
+    const double udotu = u_x * u_x + u_y * u_y;
+    double edotu_c = 3.0 * (e_x[i] * u_x + e_y[i] * u_y) / c;
     return w[i] * rho0 * (1 + edotu_c + edotu_c*edotu_c / 2.0 -
                           1.5 * udotu / (c * c));
 }
 
 
-LatticeBoltzmann::LatticeBoltzmann( GLRenderer& renderer, const std::string& riverFile ) {
+LatticeBoltzmann::LatticeBoltzmann( GLRenderer& renderer, const std::string& riverFile,
+                                    double waterLevel, Model model_,
+                                    double relief_ ) {
+
+    // Import the river configuration into the background texture, which
+    // contains the initial cell flags. Fall back to an empty lattice.
+    MapImporter importer = MapImporter(riverFile, waterLevel);
+    width = importer.isOpen() ? importer.getWidth() : 1;
+    height = importer.isOpen() ? importer.getHeight() : 1;
+
+    // The shallow water model also imports the elevation of the bed, which
+    // is flat for maps without it.
+    model = model_;
+    relief = relief_;
+    surface = waterLevel;
+    elevationTexture = 0;
+    if (model == Model::ShallowWater) {
+        const float flat = 0.f;
+        glGenTextures(1, &elevationTexture);
+        glBindTexture(GL_TEXTURE_2D, elevationTexture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32F, width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glClearTexImage(elevationTexture, 0, GL_RED, GL_FLOAT, &flat);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
 
-    // Load the background texture file, which is the river configuration.
-    backgroundTexture = gl::loadTexture(riverFile, &width, &height);
+    backgroundTexture = gl::genUTexture(width, height);
+    if (!importer.upload(backgroundTexture, elevationTexture)) {
+        print(INFO_, "Failed to import", "["+riverFile+"]", "!");
+    }
+    importer.close();
+
+    initialise(renderer);
+}
+
+LatticeBoltzmann::LatticeBoltzmann( GLRenderer& renderer, GLuint backgroundTexture_,
+                                    int width_, int height_ ) {
+    backgroundTexture = backgroundTexture_;
+    width = width_;
+    height = height_;
+    model = Model::Flow;
+    elevationTexture = 0;
+    relief = surface = 0.0;
+    initialise(renderer);
+}
+
+void LatticeBoltzmann::setDefaults() {
 
     // Set frame variables
     framestep = 10;      // Amount of simulation frames between rendering
+    tileSize = 0;        // Draw the whole lattice at once
+    blockSteps = 1;      // A pass per frame
     frame = 0;           // Frame counter
+    seed = 0;            // Random seed
+    originX = originY = 0; // Position in the domain
+    fusedDisplay = false;  // Render the display in the last frame
+    derivedInterval = 0;   // Compute the derived fields on demand
+    derivedValid = false;
+    view = View::Velocity;
+    displayValid = false;
+    viscosity = 0.005;   // Viscosity
+    collision = Collision::BGK;
+    smagorinsky = 0.0;   // No subgrid model
+    refineFactor = 1;    // No refinement patches
+    refineInterval = 500;
+    patchSize = 32;
     paused = false;
+    runFrame = false;
 
     settings[0] = true;  // enable flow
     settings[1] = false; // enable corrosion
@@ -58,7 +132,17 @@ LatticeBoltzmann::LatticeBoltzmann( GLRenderer& renderer, const std::string& riv
     // Initialise the camera position.
     screenX = screenY = 0.f;
     screenScale = 1.f;
+    viewWidth = width;
+    viewHeight = height;
     cursorX = cursorY = -1;
+}
+
+void LatticeBoltzmann::initialise( GLRenderer& renderer ) {
+
+    setDefaults();
+    statsInterval = 0;   // Accumulate no statistics
+    derivedFBO = 0;
+    suspended = false;   // No suspended sediment
 
 
     // Create the buffers, storing the flow parameters f_i.
@@ -77,78 +161,260 @@ LatticeBoltzmann::LatticeBoltzmann( GLRenderer& renderer, const std::string& riv
 
         // Bind the color attachments.
         glDrawBuffers(textureCount, drawBuffers);
+        buff.sediment = 0;
+    }
+
+    // The display image, written by the last frame of every step when the
+    // fused display is enabled, and its pyramid of reduced levels.
+    displayLevels = 1;
+    while ((std::max(width, height) >> displayLevels) > 0) {
+        ++displayLevels;
     }
+    glGenTextures(1, &displayTexture);
+    glBindTexture(GL_TEXTURE_2D, displayTexture);
+    glTexStorage2D(GL_TEXTURE_2D, displayLevels, GL_RGBA8, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glGenFramebuffers(1, &displayFBO);
+
+    // Compile the programs, unless another lattice already did.
+    if (sharedPrograms[0] == 0) {
+        const char* shaders[programCount] = {
+            "src/lbm/lbm.frag", "src/lbm/visual.frag", "src/lbm/reduce.frag",
+            "src/lbm/stats.frag", "src/lbm/derived.frag", nullptr,
+            "src/lbm/swe.frag", "src/lbm/refine.frag"};
+        for (size_t i = 0; i < programCount; ++i) {
+            if (shaders[i] != nullptr) {
+                sharedPrograms[i] = gl::compileProgram(
+                    readFile("src/opengl/main.vert"), readShader(shaders[i]));
+            }
+        }
 
-    programs[0] = gl::compileProgram(readFile("src/opengl/main.vert"),
-                                     readFile("src/lbm/lbm.frag"));
-    programs[1] = gl::compileProgram(readFile("src/opengl/main.vert"),
-                                     readFile("src/lbm/visual.frag"));
+        // Without the compute shader every frame is a pass of `lbm.frag`.
+        sharedPrograms[5] = gl::compileComputeProgram(
+            readShader("src/lbm/lbm.comp"));
+        if (sharedPrograms[5] == 0) {
+            print(INFO_, "Temporal blocking is not available");
+        }
+    }
+    std::copy(sharedPrograms, sharedPrograms + programCount, programs);
+    programUsers++;
 
     // These uniform locations are defined in the program using layout().
     for (size_t i = 0; i < textureCount; ++i) {
         u_textures[i] = i + 3;
     }
     u_settings = u_textures[textureCount - 1] + 1;
+    u_seed = u_settings + 1;
+    u_step = u_settings + 2;
+    u_viscosity = u_settings + 3;
+    u_origin = u_settings + 4;
+    u_display = u_settings + 5;
+    u_steps = u_settings + 6;
+    u_collision = u_settings + 7;
+    u_smagorinsky = u_settings + 8;
+    u_sediment = u_settings + 9;
+    u_suspended = u_settings + 10;
+
+    // The locations in `swe.frag`.
+    u_elevation = u_settings + 6;
+    u_relief = u_settings + 7;
+    u_surface = u_settings + 8;
+    u_initialise = u_settings + 9;
+
+    // The locations in `refine.frag`.
+    u_previous = u_settings;
+    u_coupling = u_settings + textureCount;
+    u_refineFactor = u_coupling + 1;
+    u_patchOffset = u_coupling + 2;
+    u_patchCells = u_coupling + 3;
+    u_couplingTime = u_coupling + 4;
+    u_couplingViscosity = u_coupling + 5;
+    u_couplingSediment = u_coupling + 6;
+
+    // The locations in `stats.frag`.
+    for (size_t i = 0; i < statsTextureCount; ++i) {
+        u_stats[i] = u_settings + i;
+    }
+    u_interval = u_settings + statsTextureCount;
+
+    // The locations in `visual.frag` and `derived.frag`.
+    u_view = u_settings;
+    for (size_t i = 0; i < derivedTextureCount; ++i) {
+        u_derived[i] = u_settings + 1 + i;
+    }
+    u_derivedViscosity = u_settings;
+    u_derivedSmagorinsky = u_settings + 1;
 
-    // Program setup.
-    for (GLuint program : programs) {
+    // Program setup, of the programs reading the lattice.
+    for (GLuint program : {programs[0], programs[1], programs[3],
+                           programs[4], programs[6], programs[7]}) {
         renderer.useProgram(program);
 
         for (size_t i = 0; i < textureCount; ++i) {
             glUniform1i(u_textures[i], i);
         }
+        if (program == programs[0]) {
+            glUniform1i(u_sediment, textureCount);
+        }
+        if (program == programs[1]) {
+            for (size_t i = 0; i < derivedTextureCount; ++i) {
+                glUniform1i(u_derived[i], textureCount + i);
+            }
+        }
+        if (program == programs[3]) {
+            for (size_t i = 0; i < statsTextureCount; ++i) {
+                glUniform1i(u_stats[i], textureCount + i);
+            }
+        }
+        if (program == programs[6]) {
+            glUniform1i(u_elevation, textureCount);
+        }
+        if (program == programs[7]) {
+            for (size_t i = 0; i < textureCount; ++i) {
+                glUniform1i(u_previous + i, textureCount + i);
+            }
+            for (size_t i = 0; i < 2; ++i) {
+                glUniform1i(u_couplingSediment + i, 2 * textureCount + i);
+            }
+        }
 
         renderer.setModelMatrix(0.f, 0.f, width, height);
         renderer.updateViewport(width, height);
     }
 
+    // The compute program, which has no model or viewport.
+    if (programs[5] != 0) {
+        renderer.useProgram(programs[5]);
+        for (size_t i = 0; i < textureCount; ++i) {
+            glUniform1i(u_textures[i], i);
+        }
+    }
+
     // Rendering setup.
     renderer.resetProgram();
     renderer.updateViewport(width, height);
 
+    clearLattice(renderer);
+    gl::checkErrors("LBM initialise");
+}
+
+void LatticeBoltzmann::reset( GLRenderer& renderer,
+                              GLuint backgroundTexture_ ) {
+
+    glDeleteTextures(1, &backgroundTexture);
+    backgroundTexture = backgroundTexture_;
+
+    enableStatistics(0);
+    setSuspendedSediment(false);
+    setDefaults();
+
+    renderer.updateViewport(width, height);
+    clearLattice(renderer);
+    gl::checkErrors("LBM reset");
+}
+
+void LatticeBoltzmann::clearLattice( GLRenderer& renderer ) {
+
+    closePatches();
+
     // Clear the textures.
     for (Buffers& buff : buffers) {
         for (GLuint& tex : buff.texture)  {
             renderer.renderToTexture(tex);
             renderer.clear(0.f, 0.f, 0.f, 0.f);
         }
+        if (buff.sediment != 0) {
+            const GLuint zero[4] = {0, 0, 0, 0};
+            glClearTexImage(buff.sediment, 0, GL_RGBA_INTEGER,
+                            GL_UNSIGNED_INT, zero);
+        }
     }
 
-    // Initialise the textures and the  f_i values.
+    // Initialise the f_i values.
+    initialiseFlow(u0_x, u0_y);
+
+    // Copy the cell flags of the river configuration.
+    glCopyImageSubData(backgroundTexture, GL_TEXTURE_2D, 0, 0, 0, 0,
+                       buffers[frame % 2].texture[0], GL_TEXTURE_2D, 0, 0, 0, 0,
+                       width, height, 1);
+
+    // The shallow water starts still, at the depth below the water surface
+    // of every cell. It is rendered into the other buffers, which are then
+    // swapped to keep the frame.
+    if (model == Model::ShallowWater) {
+        useStepProgram(renderer);
+        glUniform1i(u_initialise, true);
+        glBindTextures(0, textureCount, buffers[frame % 2].texture);
+        glBindTextures(textureCount, 1, &elevationTexture);
+        glBindFramebuffer(GL_FRAMEBUFFER, buffers[(frame + 1) % 2].fbo);
+        renderer.renderModel(renderer.getSquareModel());
+        glUniform1i(u_initialise, false);
+        std::swap(buffers[0], buffers[1]);
+        renderer.resetProgram();
+    }
+
+    renderer.renderToScreen();
+}
+
+void LatticeBoltzmann::initialiseFlow( double u_x, double u_y ) {
+
+    // Set the f_i values of every cell to the equilibrium.
     double f_eq[10] = { 0.0 }; // <-- filler
     for (int i = 0; i < 9; i++) {
-        f_eq[i+1] = calc_feq(i);
+        f_eq[i+1] = calc_feq(i, u_x, u_y);
     }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, buffers[0].fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, buffers[frame % 2].fbo);
     for (uint i = 0; i < 5; ++i) {
         glClearBufferuiv(GL_COLOR, i + 2, (GLuint*) &f_eq[i*2]);
     }
-
-    renderer.renderToTexture(buffers[0].texture[0]);
-    renderer.setRenderColor(1.0f, 1.0f, 1.0f, 0.0f);
-    renderer.renderTexture(backgroundTexture, 0, 0, width, height);
-
-    renderer.renderToScreen();
-
-    gl::checkErrors("LBM initialise");
 }
 
 void LatticeBoltzmann::close() {
 
+    closePatches();
+
     for (Buffers& buff : buffers) {
         glDeleteTextures(textureCount, buff.texture);
+        glDeleteTextures(1, &buff.sediment);
         glDeleteFramebuffers(1, &buff.fbo);
     }
 
-    for (GLuint program : programs) {
-        glDeleteProgram(program);
+    // The last lattice deletes the shared programs, unless they are kept.
+    if (--programUsers == 0 && !programsKept) {
+        keepPrograms(false);
+    }
+
+    glDeleteTextures(1, &backgroundTexture);
+    glDeleteTextures(1, &elevationTexture);
+    glDeleteTextures(1, &displayTexture);
+    glDeleteFramebuffers(1, &displayFBO);
+
+    enableStatistics(0);
+
+    if (derivedFBO != 0) {
+        glDeleteTextures(derivedTextureCount, derivedTextures);
+        glDeleteFramebuffers(1, &derivedFBO);
+    }
+}
+
+void LatticeBoltzmann::keepPrograms( bool keep ) {
+    programsKept = keep;
+    if (!keep && programUsers == 0 && sharedPrograms[0] != 0) {
+        for (GLuint& program : sharedPrograms) {
+            glDeleteProgram(program);
+            program = 0;
+        }
     }
 }
 
 void LatticeBoltzmann::handleInput( GLRenderer& renderer, InputData& input ) {
 
-    float camSpeed = 10.f;
+    // Move the same amount of pixels when zoomed out.
+    const float camSpeed = 10.f / std::min(screenScale, 1.f);
     if (input.keyMap[SDL_SCANCODE_LEFT]) screenX += camSpeed;
     if (input.keyMap[SDL_SCANCODE_RIGHT]) screenX -= camSpeed;
     if (input.keyMap[SDL_SCANCODE_DOWN]) screenY += camSpeed;
@@ -161,6 +427,19 @@ void LatticeBoltzmann::handleInput( GLRenderer& renderer, InputData& input ) {
         }
     }
 
+    // Zoom out, down to a single cell per pixel of the smallest level.
+    if (input.keyMap[SDL_SCANCODE_MINUS] == 2) {
+        screenScale = std::max(screenScale / 2.f,
+                               1.f / (float) (1 << (displayLevels - 1)));
+    }
+
+    // Fit the whole lattice in the window.
+    if (input.keyMap[SDL_SCANCODE_0] == 2) {
+        screenX = screenY = 0.0f;
+        screenScale = std::min((float) viewWidth / width,
+                               (float) viewHeight / height);
+    }
+
     // Reset the screen position and scale.
     if (input.keyMap[SDL_SCANCODE_ESCAPE] == 2) {
         screenX = screenY = 0.0f;
@@ -180,9 +459,17 @@ void LatticeBoltzmann::handleInput( GLRenderer& renderer, InputData& input ) {
 
     // Rerender the background, to restore starting walls.
     if (input.keyMap[SDL_SCANCODE_O] == 2) {
-        renderer.renderToTexture(buffers[0].texture[0]);
-        renderer.setRenderColor(1.0f, 1.0f, 1.0f, 0.0f);
-        renderer.renderTexture(backgroundTexture, 0, 0, width, height);
+        glCopyImageSubData(backgroundTexture, GL_TEXTURE_2D, 0, 0, 0, 0,
+                           buffers[frame % 2].texture[0], GL_TEXTURE_2D,
+                           0, 0, 0, 0,
+                           width, height, 1);
+        displayValid = false;
+        derivedValid = false;
+    }
+
+    // Show the next view.
+    if (input.keyMap[SDL_SCANCODE_G] == 2) {
+        view = (View) (((int) view + 1) % viewCount);
     }
 
     // Update flow settings
@@ -192,6 +479,11 @@ void LatticeBoltzmann::handleInput( GLRenderer& renderer, InputData& input ) {
             settings[i] = !settings[i];
     }
 
+    // Restart the time averaged statistics.
+    if (input.keyMap[SDL_SCANCODE_A] == 2) {
+        resetStatistics();
+    }
+
     // Enable both corrosion and sedimentation.
     if (input.keyMap[SDL_SCANCODE_T] == 2) {
         settings[1] = settings[2] = true;
@@ -201,32 +493,12 @@ void LatticeBoltzmann::handleInput( GLRenderer& renderer, InputData& input ) {
 void LatticeBoltzmann::update( GLRenderer& renderer, InputData& input,
                                int windowWidth, int windowHeight ) {
 
+    viewWidth = windowWidth;
+    viewHeight = windowHeight;
     handleInput(renderer, input);
 
     if (!paused || runFrame) {
-
-        renderer.useProgram(programs[0]);
-        renderer.updateViewport(width, height);
-        renderer.setModelMatrix(0.f, 0.f, width, height);
-
-        glUniform4i(u_settings, settings[0], settings[1], settings[2], settings[3]);
-
-        // Run for `framestep` amount of frames.
-        for (unsigned i = 0; i < framestep; ++i) {
-
-            // Bind the textures from which we render, and bind to
-            // framebuffer to which we render.
-            glBindTextures(0, 7, buffers[frame % 2].texture);
-            glBindFramebuffer(GL_FRAMEBUFFER, buffers[(frame + 1) % 2].fbo);
-
-            // Render the model.
-            renderer.renderModel(renderer.getSquareModel());
-
-            ++frame;
-        }
-
-        // Render the results.
-        renderer.resetProgram();
+        step(renderer, framestep);
     }
 
     readPixels(renderer, input);
@@ -235,16 +507,9 @@ void LatticeBoltzmann::update( GLRenderer& renderer, InputData& input,
     renderer.updateViewport(windowWidth, windowHeight);
 
     // Render the main simulation viewport.
-    renderer.useProgram(programs[1]);
-    renderer.updateViewport(windowWidth, windowHeight);
-
-    renderer.setRenderColor(1.f, 1.f, 1.f, 1.f);
-    glBindTextures(0, 3, buffers[frame % 2].texture);
-    renderer.setModelMatrix(screenX * screenScale, screenY * screenScale,
-                            width * screenScale, height * screenScale);
-
-    renderer.renderModel(renderer.getSquareModel());
-    renderer.resetProgram();
+    renderFields(renderer, screenX * screenScale, screenY * screenScale,
+                 width * screenScale, height * screenScale,
+                 windowWidth, windowHeight);
 
     // Render the cursor.
     if (cursorX >= 0 && cursorX < width &&
@@ -275,8 +540,1016 @@ void LatticeBoltzmann::update( GLRenderer& renderer, InputData& input,
 
 
 
+void LatticeBoltzmann::renderFields( GLRenderer& renderer,
+                                     float x, float y, float w, float h,
+                                     int targetWidth, int targetHeight ) {
+
+    PROFILE_SCOPE("display");
+    PROFILE_GPU("display");
+
+    // Pick the level of the display pyramid with about one texel per
+    // pixel, so zoomed out views do not sample the whole lattice.
+    const float scale = std::min(w / width, h / height);
+    int level = 0;
+    while (level + 1 < displayLevels && scale * (2 << level) <= 1.f) {
+        ++level;
+    }
+
+    // Make sure the derived fields are there, if shown. With an interval
+    // the fields of the last computation are shown.
+    if (view != View::Velocity &&
+        (!derivedValid || (derivedInterval == 0 && derivedFrame != frame))) {
+        GLint target;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+        updateDerived(renderer);
+        glBindFramebuffer(GL_FRAMEBUFFER, target);
+    }
+
+    if (level > 0) {
+        renderPyramid(renderer, x, y, w, h, targetWidth, targetHeight, level);
+        return;
+    }
+
+    // The last frame already rendered the display image.
+    if (fusedDisplay && displayValid && view == View::Velocity) {
+        renderer.updateViewport(targetWidth, targetHeight);
+        renderer.setRenderColor(1.f, 1.f, 1.f, 1.f);
+        renderer.renderTexture(displayTexture, x, y, w, h);
+        return;
+    }
+
+    useVisual(renderer);
+    renderer.updateViewport(targetWidth, targetHeight);
+    renderer.setModelMatrix(x, y, w, h);
+
+    renderer.renderModel(renderer.getSquareModel());
+    renderer.resetProgram();
+}
+
+void LatticeBoltzmann::renderPyramid( GLRenderer& renderer,
+                                      float x, float y, float w, float h,
+                                      int targetWidth, int targetHeight,
+                                      int level ) {
+
+    // The visible region of the lattice, aligned to the texels of the level
+    // so every level is reduced from up to date texels only.
+    const int align = (1 << level) - 1;
+    const int x0 = std::max(0, (int) std::floor(-x / w * width)) & ~align;
+    const int y0 = std::max(0, (int) std::floor(-y / h * height)) & ~align;
+    const int x1 = std::min(width, ((int) std::ceil(
+        (targetWidth - x) / w * width) + align) & ~align);
+    const int y1 = std::min(height, ((int) std::ceil(
+        (targetHeight - y) / h * height) + align) & ~align);
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    GLint target;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+    glBindFramebuffer(GL_FRAMEBUFFER, displayFBO);
+    glEnable(GL_SCISSOR_TEST);
+
+    // The full size display image, unless the last frame already wrote it.
+    if (!(fusedDisplay && displayValid && view == View::Velocity)) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                               GL_TEXTURE_2D, displayTexture, 0);
+        useVisual(renderer);
+        renderer.updateViewport(width, height);
+        glScissor(x0, y0, x1 - x0, y1 - y0);
+        renderer.setModelMatrix(0.f, 0.f, width, height);
+        renderer.renderModel(renderer.getSquareModel());
+    }
+
+    // Reduce the visible region level by level. Only the level which is
+    // read from is made available for sampling, as it is not allowed to
+    // sample the level which is rendered to.
+    renderer.useProgram(programs[2]);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, displayTexture);
+    for (int i = 1; i <= level; ++i) {
+        const int levelWidth = std::max(1, width >> i);
+        const int levelHeight = std::max(1, height >> i);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, i - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, i - 1);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                               GL_TEXTURE_2D, displayTexture, i);
+
+        renderer.updateViewport(levelWidth, levelHeight);
+        renderer.setModelMatrix(0.f, 0.f, levelWidth, levelHeight);
+        glScissor(x0 >> i, y0 >> i, std::max(1, (x1 - x0) >> i),
+                  std::max(1, (y1 - y0) >> i));
+        renderer.renderModel(renderer.getSquareModel());
+    }
+
+    glDisable(GL_SCISSOR_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, target);
+
+    // Render the reduced level.
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level);
+    renderer.resetProgram();
+    renderer.updateViewport(targetWidth, targetHeight);
+    renderer.setRenderColor(1.f, 1.f, 1.f, 1.f);
+    renderer.renderTexture(displayTexture, x, y, w, h);
+
+    glBindTexture(GL_TEXTURE_2D, displayTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void LatticeBoltzmann::useVisual( GLRenderer& renderer ) {
+
+    renderer.useProgram(programs[1]);
+    renderer.setRenderColor(1.f, 1.f, 1.f, 1.f);
+    glUniform1i(u_view, (int) view);
+
+    glBindTextures(0, 3, buffers[frame % 2].texture);
+    if (derivedFBO != 0) {
+        glBindTextures(textureCount, derivedTextureCount, derivedTextures);
+    }
+}
+
+void LatticeBoltzmann::updateDerived( GLRenderer& renderer ) {
+
+    if (derivedValid && derivedFrame == frame) {
+        return;
+    }
+
+    // Create the textures the first time.
+    if (derivedFBO == 0) {
+        glGenFramebuffers(1, &derivedFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, derivedFBO);
+        GLenum drawBuffers[derivedTextureCount];
+
+        for (size_t i = 0; i < derivedTextureCount; ++i) {
+            derivedTextures[i] = gl::genUTexture(width, height);
+            drawBuffers[i] = GL_COLOR_ATTACHMENT0 + i;
+            glFramebufferTexture2D(GL_FRAMEBUFFER, drawBuffers[i],
+                                   GL_TEXTURE_2D, derivedTextures[i], 0);
+        }
+        glDrawBuffers(derivedTextureCount, drawBuffers);
+    }
+
+    PROFILE_GPU("derived fields");
+    renderer.useProgram(programs[4]);
+    renderer.updateViewport(width, height);
+    renderer.setModelMatrix(0.f, 0.f, width, height);
+    glUniform1d(u_derivedViscosity, viscosity);
+    glUniform1d(u_derivedSmagorinsky, smagorinsky);
+
+    glBindTextures(0, textureCount, buffers[frame % 2].texture);
+    glBindFramebuffer(GL_FRAMEBUFFER, derivedFBO);
+    renderer.renderModel(renderer.getSquareModel());
+
+    derivedFrame = frame;
+    derivedValid = true;
+    renderer.resetProgram();
+}
+
+void LatticeBoltzmann::step( GLRenderer& renderer, unsigned steps ) {
+
+    PROFILE_SCOPE("step");
+    useStepProgram(renderer);
+
+    // Run for `steps` amount of frames.
+    for (unsigned i = 0; i < steps;) {
+
+        // Simulate a block of frames, up to the next statistics sample or
+        // derived fields.
+        const bool single = programs[5] == 0 || model != Model::Flow ||
+                            refineFactor > 1 || suspended;
+        unsigned block = single ? 1 : std::min(blockSteps, steps - i);
+        if (statsInterval > 0) {
+            block = std::min(block, statsInterval - frame % statsInterval);
+        }
+        if (derivedInterval > 0) {
+            block = std::min(block, derivedInterval - frame % derivedInterval);
+        }
+        i += block;
+
+        if (block > 1) {
+            stepBlock(renderer, block, fusedDisplay && i == steps);
+            renderer.useProgram(stepProgram());
+        }
+        else {
+            if (model == Model::Flow) {
+                glUniform1ui(u_step, frame);
+            }
+
+            // The last frame also writes the display image.
+            if (fusedDisplay && i == steps) {
+                glUniform1i(u_display, true);
+                glBindImageTexture(0, displayTexture, 0, GL_FALSE, 0,
+                                   GL_WRITE_ONLY, GL_RGBA8);
+            }
+
+            // Bind the textures from which we render, and bind to
+            // framebuffer to which we render.
+            glBindTextures(0, textureCount, buffers[frame % 2].texture);
+            if (model == Model::ShallowWater) {
+                glBindTextures(textureCount, 1, &elevationTexture);
+            }
+            else if (suspended) {
+                glBindTextures(textureCount, 1, &buffers[frame % 2].sediment);
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, buffers[(frame + 1) % 2].fbo);
+
+            // Render the model.
+            PROFILE_GPU("collide and stream");
+            if (tileSize == 0) {
+                renderer.renderModel(renderer.getSquareModel());
+            }
+            else {
+                glEnable(GL_SCISSOR_TEST);
+                for (int y = 0; y < height; y += tileSize) {
+                    for (int x = 0; x < width; x += tileSize) {
+                        glScissor(x, y, tileSize, tileSize);
+                        renderer.renderModel(renderer.getSquareModel());
+                    }
+                }
+                glDisable(GL_SCISSOR_TEST);
+            }
+
+            ++frame;
+        }
+
+        // The patches follow every frame, and are placed along the banks
+        // every interval.
+        if (refineFactor > 1) {
+            stepPatches(renderer);
+            if (frame % refineInterval == 0) {
+                regrid(renderer);
+            }
+            useStepProgram(renderer);
+        }
+
+        if (statsInterval > 0 && frame % statsInterval == 0) {
+            accumulateStatistics(renderer);
+            renderer.useProgram(stepProgram());
+        }
+        if (derivedInterval > 0 && frame % derivedInterval == 0) {
+            updateDerived(renderer);
+            renderer.useProgram(stepProgram());
+        }
+    }
+
+    if (steps > 0) {
+        displayValid = fusedDisplay;
+        if (fusedDisplay) {
+            glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+        }
+    }
+
+    renderer.resetProgram();
+}
+
+void LatticeBoltzmann::stepBlock( GLRenderer& renderer, unsigned steps,
+                                  bool display ) {
+
+    PROFILE_GPU("collide and stream block");
+    renderer.useProgram(programs[5]);
+
+    glUniform4i(u_settings, settings[0], settings[1], settings[2], settings[3]);
+    glUniform1ui(u_seed, seed);
+    glUniform1d(u_viscosity, viscosity);
+    glUniform2i(u_origin, originX, originY);
+    glUniform1ui(u_step, frame);
+    glUniform1ui(u_steps, steps);
+    glUniform1ui(u_collision, (GLuint) collision);
+    glUniform1d(u_smagorinsky, smagorinsky);
+    glUniform1i(u_display, display);
+    if (display) {
+        glBindImageTexture(0, displayTexture, 0, GL_FALSE, 0,
+                           GL_WRITE_ONLY, GL_RGBA8);
+    }
+
+    // Read the current frame, and write the next buffers.
+    glBindTextures(0, textureCount, buffers[frame % 2].texture);
+    for (size_t i = 0; i < textureCount; ++i) {
+        glBindImageTexture(i + 1, buffers[(frame + 1) % 2].texture[i], 0,
+                           GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32UI);
+    }
+
+    // The tiles of 16 by 16 cells (see `lbm.comp`) overlap by the halo.
+    const int tile = 16 - 2 * (int) steps;
+    glDispatchCompute((width + tile - 1) / tile, (height + tile - 1) / tile,
+                      1);
+
+    // The textures are read and written in every way after this.
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT |
+                    GL_SHADER_IMAGE_ACCESS_BARRIER_BIT |
+                    GL_FRAMEBUFFER_BARRIER_BIT |
+                    GL_TEXTURE_UPDATE_BARRIER_BIT |
+                    GL_PIXEL_BUFFER_BARRIER_BIT);
+
+    // The result is in the buffers of the next frame, which are the
+    // buffers of the last frame of the block after an odd amount of frames.
+    frame += steps;
+    if (steps % 2 == 0) {
+        std::swap(buffers[0], buffers[1]);
+    }
+}
+
+void LatticeBoltzmann::useStepProgram( GLRenderer& renderer ) {
+
+    renderer.useProgram(stepProgram());
+    renderer.updateViewport(width, height);
+    renderer.setModelMatrix(0.f, 0.f, width, height);
+
+    glUniform4i(u_settings, settings[0], settings[1], settings[2], settings[3]);
+    glUniform1d(u_viscosity, viscosity);
+    glUniform1i(u_display, false);
+
+    // The shallow water model has no random numbers, and only BGK.
+    if (model == Model::Flow) {
+        glUniform1ui(u_seed, seed);
+        glUniform2i(u_origin, originX, originY);
+        glUniform1ui(u_collision, (GLuint) collision);
+        glUniform1d(u_smagorinsky, smagorinsky);
+        glUniform1i(u_suspended, suspended);
+    }
+    else {
+        glUniform1d(u_relief, relief);
+        glUniform1d(u_surface, surface);
+    }
+}
+
+void LatticeBoltzmann::setSuspendedSediment( bool enabled ) {
+
+    if (enabled && model != Model::Flow) {
+        print(INFO_, "The suspended sediment is only available for the flow",
+              "model");
+        enabled = false;
+    }
+    if (enabled == suspended) {
+        return;
+    }
+    suspended = enabled;
+
+    // The texture is attached after the others, and only drawn to while
+    // it exists.
+    for (Buffers& buff : buffers) {
+        if (enabled) {
+            const GLuint zero[4] = {0, 0, 0, 0};
+            buff.sediment = gl::genUTexture(width, height);
+            glClearTexImage(buff.sediment, 0, GL_RGBA_INTEGER,
+                            GL_UNSIGNED_INT, zero);
+        }
+        else {
+            glDeleteTextures(1, &buff.sediment);
+            buff.sediment = 0;
+        }
+
+        GLenum drawBuffers[textureCount + 1];
+        for (size_t i = 0; i <= textureCount; ++i) {
+            drawBuffers[i] = GL_COLOR_ATTACHMENT0 + i;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, buff.fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, drawBuffers[textureCount],
+                               GL_TEXTURE_2D, buff.sediment, 0);
+        glDrawBuffers(textureCount + enabled, drawBuffers);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void LatticeBoltzmann::setRefinement( GLRenderer& renderer, unsigned factor,
+                                      int size, unsigned interval ) {
+
+    closePatches();
+    refineFactor = std::min(std::max(1u, factor), 4u);
+    patchSize = std::max(4, size);
+    refineInterval = std::max(1u, interval);
+    if (refineFactor > 1 && model != Model::Flow) {
+        print(INFO_, "Refinement is only available for the flow model");
+        refineFactor = 1;
+    }
+
+    if (refineFactor > 1) {
+        regrid(renderer);
+        print("Refined", patches.size(), "squares of", patchSize, "cells by",
+              refineFactor);
+    }
+}
+
+void LatticeBoltzmann::stepPatches( GLRenderer& renderer ) {
+
+    PROFILE_SCOPE("refinement");
+    for (Patch& patch : patches) {
+        LatticeBoltzmann& fine = *patch.lattice;
+
+        // The patch has the same settings, at the viscosity of its scale.
+        fine.viscosity = refineFactor * viscosity;
+        fine.collision = collision;
+        fine.smagorinsky = smagorinsky;
+        fine.setSuspendedSediment(suspended);
+        std::copy(settings, settings + 4, fine.settings);
+
+        for (unsigned i = 0; i < refineFactor; ++i) {
+            couple(renderer, patch, Coupling::Ring,
+                   (double) i / refineFactor);
+            fine.step(renderer, 1);
+        }
+        couple(renderer, patch, Coupling::Restrict, 1.0);
+    }
+    renderer.resetProgram();
+}
+
+void LatticeBoltzmann::regrid( GLRenderer& renderer ) {
+
+    PROFILE_SCOPE("regrid");
+
+    // The flags are 0 or 1, so they fit in bytes.
+    std::vector<GLubyte> flags(4 * (size_t) width * height);
+    glBindFramebuffer(GL_FRAMEBUFFER, buffers[frame % 2].fbo);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glReadPixels(0, 0, width, height, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE,
+                 flags.data());
+
+    // Cells which become a wall in the next frame count as walls, and the
+    // lattice is periodic.
+    auto cellFlags = [&]( int x, int y ) {
+        x = (x + width) % width;
+        y = (y + height) % height;
+        return &flags[4 * ((size_t) y * width + x)];
+    };
+    auto isWall = [&]( int x, int y ) {
+        const GLubyte* cell = cellFlags(x, y);
+        return cell[3] != 0 || cell[1] != 0;
+    };
+    auto isBank = [&]( int x, int y ) {
+        return isWall(x, y) && cellFlags(x, y)[0] == 0;
+    };
+
+    std::vector<Patch> placed;
+    for (int y = 0; y < height; y += patchSize) {
+        for (int x = 0; x < width; x += patchSize) {
+            const int w = std::min(patchSize, width - x);
+            const int h = std::min(patchSize, height - y);
+
+            // A square is on a bank if it has fluid next to a wall which
+            // can erode.
+            bool bank = false;
+            for (int cy = y; cy < y + h && !bank; ++cy) {
+                for (int cx = x; cx < x + w && !bank; ++cx) {
+                    bank = !isWall(cx, cy) &&
+                           (isBank(cx + 1, cy) || isBank(cx - 1, cy) ||
+                            isBank(cx, cy + 1) || isBank(cx, cy - 1));
+                }
+            }
+            if (!bank || placed.size() >= maxPatches) {
+                continue;
+            }
+
+            // Keep the patch of the square, or create one from the lattice.
+            auto kept = std::find_if(patches.begin(), patches.end(),
+                                     [&]( const Patch& patch ) {
+                return patch.x == x && patch.y == y && patch.lattice;
+            });
+            if (kept != patches.end()) {
+                placed.push_back(std::move(*kept));
+                continue;
+            }
+
+            Patch patch;
+            patch.x = x;
+            patch.y = y;
+            patch.width = w;
+            patch.height = h;
+            const int fineWidth = (w + 2) * refineFactor;
+            const int fineHeight = (h + 2) * refineFactor;
+            patch.lattice.reset(new LatticeBoltzmann(
+                renderer, gl::genUTexture(fineWidth, fineHeight),
+                fineWidth, fineHeight));
+
+            // The random numbers of the patch differ from the lattice.
+            patch.lattice->setSeed(seed);
+            patch.lattice->setOrigin((originX + x - 1) * refineFactor,
+                                     (originY + y - 1) * refineFactor);
+            patch.lattice->setSuspendedSediment(suspended);
+            couple(renderer, patch, Coupling::Full, 1.0);
+            placed.push_back(std::move(patch));
+        }
+    }
+
+    // The patches which are still on a bank were moved into `placed`, so
+    // the ones left are no longer on a bank.
+    closePatches();
+    patches = std::move(placed);
+    renderer.resetProgram();
+    gl::checkErrors("LBM regrid");
+}
+
+void LatticeBoltzmann::couple( GLRenderer& renderer, Patch& patch,
+                               Coupling coupling, double alpha ) {
+
+    PROFILE_GPU("refinement coupling");
+    LatticeBoltzmann& fine = *patch.lattice;
+    renderer.useProgram(programs[7]);
+    glUniform1ui(u_coupling, (GLuint) coupling);
+    glUniform1i(u_refineFactor, refineFactor);
+    glUniform2i(u_patchOffset, patch.x - 1, patch.y - 1);
+    glUniform2i(u_patchCells, patch.width + 2, patch.height + 2);
+    glUniform1d(u_couplingTime, alpha);
+    glUniform1d(u_couplingViscosity, viscosity);
+
+    // Restrict the patch to the square of the current frame of the lattice.
+    if (coupling == Coupling::Restrict) {
+        renderer.updateViewport(width, height);
+        renderer.setModelMatrix(0.f, 0.f, width, height);
+        glBindTextures(0, textureCount, fine.buffers[fine.frame % 2].texture);
+        glBindTextures(2 * textureCount, 1,
+                       &fine.buffers[fine.frame % 2].sediment);
+        glBindFramebuffer(GL_FRAMEBUFFER, buffers[frame % 2].fbo);
+
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(patch.x, patch.y, patch.width, patch.height);
+        renderer.renderModel(renderer.getSquareModel());
+        glDisable(GL_SCISSOR_TEST);
+    }
+
+    // Interpolate the current frame of the patch from the last two frames
+    // of the lattice.
+    else {
+        renderer.updateViewport(fine.width, fine.height);
+        renderer.setModelMatrix(0.f, 0.f, fine.width, fine.height);
+        glBindTextures(0, textureCount, buffers[frame % 2].texture);
+        glBindTextures(textureCount, textureCount,
+                       buffers[(frame + 1) % 2].texture);
+        const GLuint sediment[2] = {buffers[frame % 2].sediment,
+                                    buffers[(frame + 1) % 2].sediment};
+        glBindTextures(2 * textureCount, 2, sediment);
+        glBindFramebuffer(GL_FRAMEBUFFER, fine.buffers[fine.frame % 2].fbo);
+        renderer.renderModel(renderer.getSquareModel());
+    }
+}
+
+void LatticeBoltzmann::closePatches() {
+    for (Patch& patch : patches) {
+        if (patch.lattice) {
+            patch.lattice->close();
+        }
+    }
+    patches.clear();
+}
+
+void LatticeBoltzmann::stepRegion( GLRenderer& renderer,
+                                   int x, int y, int w, int h ) {
+
+    useStepProgram(renderer);
+    if (model == Model::Flow) {
+        glUniform1ui(u_step, frame);
+    }
+    else {
+        glBindTextures(textureCount, 1, &elevationTexture);
+    }
+    if (suspended) {
+        glBindTextures(textureCount, 1, &buffers[frame % 2].sediment);
+    }
+
+    glBindTextures(0, textureCount, buffers[frame % 2].texture);
+    glBindFramebuffer(GL_FRAMEBUFFER, buffers[(frame + 1) % 2].fbo);
+
+    // Only render the region.
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(x, y, w, h);
+    renderer.renderModel(renderer.getSquareModel());
+    glDisable(GL_SCISSOR_TEST);
+
+    renderer.resetProgram();
+}
+
+void LatticeBoltzmann::readHalo( int x, int y, int w, int h, size_t offset ) {
+
+    glBindFramebuffer(GL_FRAMEBUFFER, buffers[(frame + 1) % 2].fbo);
+    for (size_t i = 0; i < haloTextureCount; ++i) {
+        glReadBuffer(GL_COLOR_ATTACHMENT0 + haloTextureFirst + i);
+        glReadPixels(x, y, w, h, GL_RGBA_INTEGER, GL_UNSIGNED_INT,
+                     (void*) (offset + i * 4 * w * h * sizeof (GLuint)));
+    }
+}
+
+void LatticeBoltzmann::writeHalo( int x, int y, int w, int h,
+                                  const GLuint* data ) {
+
+    for (size_t i = 0; i < haloTextureCount; ++i) {
+        glBindTexture(GL_TEXTURE_2D,
+                      buffers[frame % 2].texture[haloTextureFirst + i]);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, GL_RGBA_INTEGER,
+                        GL_UNSIGNED_INT, data + i * 4 * w * h);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+
+void LatticeBoltzmann::enableStatistics( unsigned interval ) {
+
+    // Create or delete the buffers when (de)activated.
+    if (interval > 0 && statsInterval == 0) {
+        for (StatsBuffers& buff : statsBuffers) {
+            glGenFramebuffers(1, &buff.fbo);
+            glBindFramebuffer(GL_FRAMEBUFFER, buff.fbo);
+            GLenum drawBuffers[statsTextureCount];
+
+            for (size_t i = 0; i < statsTextureCount; ++i) {
+                buff.texture[i] = gl::genUTexture(width, height);
+                drawBuffers[i] = GL_COLOR_ATTACHMENT0 + i;
+                glFramebufferTexture2D(GL_FRAMEBUFFER, drawBuffers[i],
+                                       GL_TEXTURE_2D, buff.texture[i], 0);
+            }
+            glDrawBuffers(statsTextureCount, drawBuffers);
+        }
+    }
+    else if (interval == 0 && statsInterval > 0) {
+        for (StatsBuffers& buff : statsBuffers) {
+            glDeleteTextures(statsTextureCount, buff.texture);
+            glDeleteFramebuffers(1, &buff.fbo);
+        }
+    }
+
+    statsInterval = interval;
+    if (statsInterval > 0) {
+        resetStatistics();
+    }
+}
+
+void LatticeBoltzmann::resetStatistics() {
+
+    if (statsInterval == 0) {
+        return;
+    }
+
+    const GLuint zero[4] = {0, 0, 0, 0};
+    glBindFramebuffer(GL_FRAMEBUFFER, statsBuffers[0].fbo);
+    for (size_t i = 0; i < statsTextureCount; ++i) {
+        glClearBufferuiv(GL_COLOR, i, zero);
+    }
+    statsIndex = 0;
+}
+
+void LatticeBoltzmann::accumulateStatistics( GLRenderer& renderer ) {
+
+    PROFILE_GPU("statistics");
+    renderer.useProgram(programs[3]);
+    renderer.updateViewport(width, height);
+    renderer.setModelMatrix(0.f, 0.f, width, height);
+    glUniform1d(u_interval, statsInterval);
+
+    // Read the current frame and statistics, and render the new statistics
+    // to the other buffer.
+    glBindTextures(0, textureCount, buffers[frame % 2].texture);
+    glBindTextures(textureCount, statsTextureCount,
+                   statsBuffers[statsIndex % 2].texture);
+    glBindFramebuffer(GL_FRAMEBUFFER, statsBuffers[(statsIndex + 1) % 2].fbo);
+
+    renderer.renderModel(renderer.getSquareModel());
+    ++statsIndex;
+}
+
+void LatticeBoltzmann::readStatistics( int x, int y, int w, int h,
+                                       std::vector<double>& stats ) {
+
+    stats.assign(statsValues * w * h, 0.0);
+    if (statsInterval == 0) {
+        return;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, statsBuffers[statsIndex % 2].fbo);
+    std::vector<GLuint> data(4 * w * h);
+    std::vector<double> raw(statsValues * w * h);
+    for (size_t i = 0; i < statsTextureCount; ++i) {
+        glReadBuffer(GL_COLOR_ATTACHMENT0 + i);
+        glReadPixels(x, y, w, h, GL_RGBA_INTEGER, GL_UNSIGNED_INT,
+                     data.data());
+        for (int j = 0; j < w * h; ++j) {
+            std::memcpy(&raw[statsValues * j + 2 * i], &data[4 * j],
+                        2 * sizeof (double));
+        }
+    }
+
+    for (int j = 0; j < w * h; ++j) {
+        convertStatistics(&raw[statsValues * j], &stats[statsValues * j]);
+    }
+}
+
+
+std::vector<LatticeBoltzmann::Allocation> LatticeBoltzmann::memoryUsage(
+        int width, int height, const Storage& storage ) {
+
+    // The textures are RGBA32UI, of 16 bytes per cell, except for the
+    // RGBA8 display pyramid and the R32F elevation.
+    const size_t cells = (size_t) width * height;
+    int levels = 1;
+    while ((std::max(width, height) >> levels) > 0) {
+        ++levels;
+    }
+    size_t display = 0;
+    for (int i = 0; i < levels; ++i) {
+        display += (size_t) std::max(1, width >> i) *
+                   std::max(1, height >> i) * 4;
+    }
+
+    std::vector<Allocation> usage = {
+        {"lattice", 2 * textureCount * cells * 16},
+        {"background", cells * 16},
+        {"display", display}};
+    if (storage.model == Model::ShallowWater) {
+        usage.push_back({"elevation", cells * 4});
+    }
+    if (storage.sediment) {
+        usage.push_back({"sediment", 2 * cells * 16});
+    }
+    if (storage.statistics) {
+        usage.push_back({"statistics", 2 * statsTextureCount * cells * 16});
+    }
+    if (storage.derived) {
+        usage.push_back({"derived", derivedTextureCount * cells * 16});
+    }
+
+    // A patch is a lattice of its square and the ring around it.
+    if (storage.refineFactor > 1) {
+        const int size = std::max(4, storage.patchSize);
+        const size_t squares = (size_t) ((width + size - 1) / size) *
+                               ((height + size - 1) / size);
+        const int fineSize = (size + 2) * storage.refineFactor;
+        Storage fine;
+        fine.sediment = storage.sediment;
+        usage.push_back({"patches", std::min(squares, (size_t) maxPatches) *
+                         totalMemory(memoryUsage(fineSize, fineSize, fine))});
+    }
+    return usage;
+}
+
+std::vector<LatticeBoltzmann::Allocation>
+LatticeBoltzmann::memoryUsage() const {
+
+    Storage storage;
+    storage.model = model;
+    storage.sediment = suspended;
+    storage.statistics = statsInterval > 0;
+    storage.derived = derivedFBO != 0;
+    std::vector<Allocation> usage = memoryUsage(width, height, storage);
+
+    size_t refined = 0;
+    for (const Patch& patch : patches) {
+        refined += patch.lattice->memoryFootprint();
+    }
+    if (refined > 0) {
+        usage.push_back({"patches", refined});
+    }
+    return usage;
+}
+
+
+// The start of checkpoint files, followed by the version. Version 1 has
+// no suspended sediment, and versions 1 and 2 have no model, collision
+// operator, Smagorinsky constant and refinement.
+static const char checkpointMagic[8] = {'P', 'C', 'S', 'L', 'B', 'M', 3, '\n'};
+static const size_t checkpointVersionIndex = 6; // The version byte.
+
+bool LatticeBoltzmann::saveCheckpoint( const std::string& path ) {
+
+    std::ofstream file(path, std::ios::binary);
+    const int32_t size[2] = {width, height};
+    const uint32_t counters[2] = {frame, seed};
+    const uint8_t flags[5] = {settings[0], settings[1],
+                              settings[2], settings[3], suspended};
+    const uint8_t modes[2] = {(uint8_t) model, (uint8_t) collision};
+    const int32_t refinement[3] = {(int32_t) refineFactor, patchSize,
+                                   (int32_t) refineInterval};
+    file.write(checkpointMagic, sizeof checkpointMagic);
+    file.write((const char*) size, sizeof size);
+    file.write((const char*) counters, sizeof counters);
+    file.write((const char*) &viscosity, sizeof viscosity);
+    file.write((const char*) flags, sizeof flags);
+    file.write((const char*) modes, sizeof modes);
+    file.write((const char*) &smagorinsky, sizeof smagorinsky);
+    file.write((const char*) refinement, sizeof refinement);
+
+    // The sediment is read from its attachment, after the other textures.
+    std::vector<GLuint> data;
+    for (size_t i = 0; i < textureCount + suspended; ++i) {
+        readTexture(i, 0, 0, width, height, data);
+        file.write((const char*) data.data(), data.size() * sizeof (GLuint));
+    }
+
+    if (!file) {
+        print(INFO_, "Failed to write the checkpoint", path);
+        return false;
+    }
+    return true;
+}
+
+bool LatticeBoltzmann::loadCheckpoint( const std::string& path ) {
+
+    std::ifstream file(path, std::ios::binary);
+    char magic[sizeof checkpointMagic];
+    int32_t size[2];
+    uint32_t counters[2];
+    double viscosity_;
+    uint8_t flags[5] = {0};
+    file.read(magic, sizeof magic);
+    file.read((char*) size, sizeof size);
+    file.read((char*) counters, sizeof counters);
+    file.read((char*) &viscosity_, sizeof viscosity_);
+    const char version = magic[checkpointVersionIndex];
+    file.read((char*) flags, version == 1 ? 4 : sizeof flags);
+
+    // Older versions keep the current model, operator and refinement.
+    uint8_t modes[2] = {(uint8_t) model, (uint8_t) collision};
+    double smagorinsky_ = smagorinsky;
+    int32_t refinement[3] = {(int32_t) refineFactor, patchSize,
+                             (int32_t) refineInterval};
+    if (version >= 3) {
+        file.read((char*) modes, sizeof modes);
+        file.read((char*) &smagorinsky_, sizeof smagorinsky_);
+        file.read((char*) refinement, sizeof refinement);
+    }
+
+    magic[checkpointVersionIndex] = checkpointMagic[checkpointVersionIndex];
+    if (!file || std::memcmp(magic, checkpointMagic, sizeof magic) != 0 ||
+        version < 1 || version > checkpointMagic[checkpointVersionIndex] ||
+        modes[1] > (uint8_t) Collision::MRT) {
+        print(INFO_, "Failed to read the checkpoint", path);
+        return false;
+    }
+    if (size[0] != width || size[1] != height) {
+        print(INFO_, "The checkpoint", path, "of size", size[0], "x", size[1],
+              "does not fit the lattice");
+        return false;
+    }
+    if (modes[0] != (uint8_t) model) {
+        print(INFO_, "The checkpoint", path, "is of another model");
+        return false;
+    }
+    if (refinement[0] != (int32_t) refineFactor ||
+        (refineFactor > 1 && (refinement[1] != patchSize ||
+                              refinement[2] != (int32_t) refineInterval))) {
+        print(INFO_, "The checkpoint", path, "is refined by", refinement[0],
+              "in squares of", refinement[1], "cells every", refinement[2],
+              "frames, unlike the lattice");
+        return false;
+    }
+
+    // Read everything before changing the lattice.
+    const size_t count = textureCount + (flags[4] != 0);
+    std::vector<GLuint> data(count * 4 * (size_t) width * height);
+    file.read((char*) data.data(), data.size() * sizeof (GLuint));
+    if (!file) {
+        print(INFO_, "The checkpoint", path, "is incomplete");
+        return false;
+    }
+
+    frame = counters[0];
+    seed = counters[1];
+    viscosity = viscosity_;
+    collision = (Collision) modes[1];
+    smagorinsky = smagorinsky_;
+    for (size_t i = 0; i < 4; ++i) {
+        settings[i] = flags[i] != 0;
+    }
+    setSuspendedSediment(flags[4] != 0);
+
+    for (size_t i = 0; i < textureCount + suspended; ++i) {
+        glBindTexture(GL_TEXTURE_2D, i < textureCount ?
+                                     buffers[frame % 2].texture[i] :
+                                     buffers[frame % 2].sediment);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height,
+                        GL_RGBA_INTEGER, GL_UNSIGNED_INT,
+                        data.data() + i * 4 * (size_t) width * height);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    displayValid = false;
+    derivedValid = false;
+    resetStatistics();
+
+    // The patches are placed again at the next interval.
+    closePatches();
+    return true;
+}
+
+
+void LatticeBoltzmann::readTexture( size_t index, int x, int y, int w, int h,
+                                    std::vector<GLuint>& data ) {
+
+    data.resize(4 * w * h);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, buffers[frame % 2].fbo);
+    glReadBuffer(GL_COLOR_ATTACHMENT0 + index);
+    glReadPixels(x, y, w, h, GL_RGBA_INTEGER, GL_UNSIGNED_INT, data.data());
+}
+
+void LatticeBoltzmann::readVelocity( int x, int y, int w, int h,
+                                     std::vector<double>& u,
+                                     std::vector<bool>& walls ) {
+
+    std::vector<GLuint> tiles, data;
+    readTexture(0, x, y, w, h, tiles);
+    readTexture(1, x, y, w, h, data);
+
+    u.resize(2 * w * h);
+    walls.resize(w * h);
+    for (int i = 0; i < w * h; ++i) {
+        std::memcpy(&u[2*i], &data[4*i], 2 * sizeof (double));
+        walls[i] = tiles[4*i + 3] != 0;
+    }
+}
+
+void LatticeBoltzmann::readWalls( int x, int y, int w, int h,
+                                  std::vector<bool>& walls ) {
+
+    // The flags are 0 or 1, so they fit in bytes.
+    std::vector<GLubyte> tiles(4 * w * h);
+    glBindFramebuffer(GL_FRAMEBUFFER, buffers[frame % 2].fbo);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glReadPixels(x, y, w, h, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, tiles.data());
+
+    // Cells which become a wall in the next frame count as walls.
+    walls.resize(w * h);
+    for (int i = 0; i < w * h; ++i) {
+        walls[i] = tiles[4*i + 3] != 0 || tiles[4*i + 1] != 0;
+    }
+}
+
+LatticeBoltzmann::Summary LatticeBoltzmann::summarise( int x, int y,
+                                                       int w, int h ) {
+
+    // Read the wall data, u and rho of the region.
+    std::vector<GLuint> tiles, u, rho;
+    readTexture(0, x, y, w, h, tiles);
+    readTexture(1, x, y, w, h, u);
+    readTexture(2, x, y, w, h, rho);
+
+    Summary summary = {0, 0, 0.0, 0.0, 0.0, 0.0, 0.0, 0};
+    for (int i = 0; i < w * h; ++i) {
+
+        // The doubles are stored as two 32 bit unsigned integers.
+        double vals[3];
+        std::memcpy(&vals[0], &u[4*i], 2 * sizeof (double));
+        std::memcpy(&vals[2], &rho[4*i], sizeof (double));
+        summary.totalMass += vals[2];
+
+        if (tiles[4*i + 3] != 0) {
+            summary.wallCells++;
+            continue;
+        }
+
+        const double speed = std::sqrt(vals[0]*vals[0] + vals[1]*vals[1]);
+        summary.fluidCells++;
+        summary.mass += vals[2];
+        summary.meanSpeed += speed;
+        summary.maxSpeed = std::max(summary.maxSpeed, speed);
+    }
+
+    if (summary.fluidCells > 0) {
+        summary.meanSpeed /= summary.fluidCells;
+    }
+
+    // The suspended sediment is a concentration per unit of the mass the
+    // cell streams out, the sum of its f_i values.
+    if (suspended) {
+        std::vector<GLuint> sediment, f;
+        readTexture(textureCount, x, y, w, h, sediment);
+        std::vector<double> mass(w * h, 0.0);
+        for (size_t t = 2; t < textureCount; ++t) {
+            readTexture(t, x, y, w, h, f);
+            for (int i = 0; i < w * h; ++i) {
+                double vals[2];
+                std::memcpy(vals, &f[4*i], 2 * sizeof (double));
+                mass[i] += (t > 2 ? std::abs(vals[0]) : 0.0) +
+                           std::abs(vals[1]);
+            }
+        }
+        for (int i = 0; i < w * h; ++i) {
+            double vals[2];
+            std::memcpy(vals, &sediment[4*i], 2 * sizeof (double));
+            summary.sediment += vals[0] * mass[i] + vals[1];
+        }
+    }
+
+    // Hash all the texture data (FNV-1a), so that runs can be compared
+    // exactly.
+    summary.checksum = 14695981039346656037ull;
+    std::vector<GLuint> data;
+    for (size_t t = 0; t < textureCount; ++t) {
+        readTexture(t, x, y, w, h, data);
+        for (GLuint value : data) {
+            summary.checksum = (summary.checksum ^ value) * 1099511628211ull;
+        }
+    }
+
+    gl::checkErrors("LBM summarise");
+    return summary;
+}
+
+
+
 void LatticeBoltzmann::readPixels( GLRenderer& renderer, InputData& input ) {
 
+    PROFILE_SCOPE("read pixels");
+
     bool posChanged = false;
 
     // Remove pointer.
@@ -0,0 +1,460 @@
+/**
+ * The update of a single cell of the modified LBM model, shared by the
+ * fragment shader (`lbm.frag`), which advances the lattice a frame per
+ * pass, and the compute shader (`lbm.comp`), which advances tiles several
+ * frames per pass. Sharing it keeps the results of both the same.
+ *
+ * It is included (see `gl::readShader()`) after the declarations of the
+ * uniforms `u_settings`, `u_seed`, `u_viscosity`, `u_origin`, `u_collision`
+ * and `u_smagorinsky`, and expects the function `get_phi()`. The shaders
+ * which only read the lattice (`stats.frag` and `derived.frag`) define
+ * `SHARED_ONLY` first, and get only the constants, `wall_force()` and
+ * `smagorinsky_omega()`.
+ *
+ * @file lbm.glsl
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+ #define ENABLE_FLOW
+ #define ENABLE_SEDIMENTATION
+ #define ENABLE_EROSION
+ #define ENABLE_SLOPE
+
+
+// Some constants. The viscosity is set from the host (`u_viscosity`).
+const double delta_x = 1.0;                      // Lattice spacing
+const double delta_t = 1.0;                      // Time step
+double c = delta_x / delta_t;                    // Lattice speed
+const dvec2 u0 = dvec2(0.1, 0.0);                // Initial in-flow speed
+const double rho0 = 1.0;
+
+
+#ifdef ENABLE_SLOPE
+const dvec2 u_slope = dvec2(0.1, 0.0);
+#endif
+
+
+// f_i directions.
+const dvec2 e[9] = dvec2[9](dvec2(0., 0.),  dvec2(1., 0.),   dvec2(0., 1.),
+                            dvec2(-1., 0.), dvec2(0., -1.),  dvec2(1., 1.),
+                            dvec2(-1., 1.), dvec2(-1., -1.), dvec2(1., -1.));
+
+// Float f_i directions to avoid having to convert from doubles to floats.
+const vec2 ef[9] = vec2[9](vec2(0., 0.),  vec2(1., 0.),   vec2(0., 1.),
+                           vec2(-1., 0.), vec2(0., -1.),  vec2(1., 1.),
+                           vec2(-1., 1.), vec2(-1., -1.), vec2(1., -1.));
+
+// Flow weights for each f_i.
+const double w[9] = double[9](4. /  9., 1. /  9., 1. /  9.,
+                              1. /  9., 1. /  9., 1. / 36.,
+                              1. / 36., 1. / 36., 1. / 36.);
+
+
+// The activation probability function.
+float sigma( float x ) {
+    return 1 / (1 + exp(-x));
+}
+
+// Constants for erosion activation curve
+#ifdef ENABLE_EROSION
+const float ero_act   = 0.00;      // Centre of the curve
+const float ero_lim   = 1.0;     // Maximum probability
+const float ero_slope = 1000.0;      // Slope of the curve
+
+// Erosion activation curve
+float sigma_a = sigma(-ero_slope * ero_act);
+float ero_scaling = ero_lim / (1 - sigma_a);
+float ero( float x ) {
+    return (sigma(ero_slope * (x - ero_act)) - sigma_a) * ero_scaling;
+}
+#endif
+
+// Constants for sedimentation activation curve
+#ifdef ENABLE_SEDIMENTATION
+const float sed_act   = 0.00;      // Centre of the curve
+const float sed_lim   = 0.005;      // Maximum probability
+const float sed_slope = 100.0;     // Slope of the curve
+
+// Sedimentation activation curve
+float sigma_b = sigma(-sed_slope * sed_act);
+float sed_scaling = sed_lim / (1 - sigma_b);
+float sed( float x ) {
+    return sed_lim - (sigma(sed_slope * (x - sed_act)) - sigma_b) * sed_scaling;
+}
+#endif
+
+// Constants of the suspended sediment, see `setSuspendedSediment()`. The
+// amounts are in units of the sediment of a wall cell.
+const double sediment_wall = 1.0;       // The sediment of a wall cell
+const double sediment_inflow = 0.01;    // The concentration of the sources
+const double sediment_settling = 0.05;  // The fraction settling per frame
+                                        // in still water
+const double sediment_diffusion = 0.01; // Between neighbouring cells
+
+
+// The momentum exchange of a wall cell with the fluid, from the f_i values
+// of the cell before streaming, `phi`, and the streamed values, `f`. This is
+// the force which erodes the wall, and the wall shear of the statistics and
+// derived fields.
+dvec2 wall_force( in double phi[9], in double f[9] ) {
+    return (e[1] * (abs(phi[1]) + f[3]) * double(f[1] > 0) + // E  <-> W
+            e[2] * (abs(phi[2]) + f[4]) * double(f[2] > 0) + // N  <-> S
+            e[3] * (abs(phi[3]) + f[1]) * double(f[3] > 0) + // W  <-> E
+            e[4] * (abs(phi[4]) + f[2]) * double(f[4] > 0) + // S  <-> N
+            e[5] * (abs(phi[5]) + f[7]) * double(f[5] > 0) + // NE <-> SW
+            e[6] * (abs(phi[6]) + f[8]) * double(f[6] > 0) + // NW <-> SE
+            e[7] * (abs(phi[7]) + f[5]) * double(f[7] > 0) + // SW <-> NE
+            e[8] * (abs(phi[8]) + f[6]) * double(f[8] > 0))  // SE <-> NW
+           * c * delta_x;
+}
+
+
+// The relaxation rate with the eddy viscosity of the Smagorinsky model
+// added, nu_t = (C delta_x)^2 |S|. The strain rate follows from the non
+// equilibrium part `f_neq` and the total relaxation time, which gives a
+// quadratic equation for it (Hou et al., "A lattice Boltzmann subgrid
+// model for high Reynolds number flows", 1996), for the Smagorinsky
+// constant `constant`.
+double smagorinsky_omega( in double omega, in double f_neq[9],
+                          in double rho, in double constant ) {
+    double pi_xx = 0.0, pi_yy = 0.0, pi_xy = 0.0;
+    for (uint i = 1; i < 9; i++) {
+        pi_xx += e[i].x * e[i].x * f_neq[i];
+        pi_yy += e[i].y * e[i].y * f_neq[i];
+        pi_xy += e[i].x * e[i].y * f_neq[i];
+    }
+    double pi = sqrt(pi_xx * pi_xx + pi_yy * pi_yy + 2.0 * pi_xy * pi_xy);
+
+    double tau = 1.0 / omega;
+    double c_delta = constant * delta_x;
+    tau = 0.5 * (tau + sqrt(tau * tau + 18.0 * sqrt(2.0) * c_delta * c_delta *
+                            pi / rho));
+    return 1.0 / tau;
+}
+
+#ifndef SHARED_ONLY
+
+
+// PCG integer hash (Jarzynski & Olano, "Hash Functions for GPU Rendering").
+uint pcg( in uint v ) {
+    uint state = v * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+// Counter based random number in [0, 1), keyed on the seed, the cell, the
+// frame and a stream index. The same inputs always give the same number, on
+// any driver, so that runs can be replayed exactly.
+float rand( in ivec2 loc, in uint step, in uint stream ) {
+    loc += u_origin;
+    uint h = pcg(stream ^ pcg(step ^ pcg(uint(loc.y) ^
+                 pcg(uint(loc.x) ^ pcg(u_seed)))));
+    return float(h >> 8u) * (1.0 / 16777216.0);
+}
+
+// Random number streams, so that every stochastic decision is independent.
+const uint STREAM_EROSION = 0u;
+const uint STREAM_SEDIMENTATION = 1u;
+
+
+// Get the index of the opposite direction
+uint inverti( in uint i ) {
+    return ((i + 1)%4 + 1) * uint(0 < i && i < 5) + ((i - 3)%4 + 5) * uint(i > 4);
+}
+
+
+double calc_feq( in uint i , in double rho, in dvec2 u, in double udotu ) {
+    double edotu_c = 3.0*dot(e[i], u) / c;
+    return w[i] * rho * (1 + edotu_c + edotu_c*edotu_c / 2.0 - 1.5 * udotu / (c * c));
+}
+
+
+// The collision operators, see `LatticeBoltzmann::setCollision()`.
+const uint COLLISION_BGK = 0u;
+const uint COLLISION_TRT = 1u;
+const uint COLLISION_MRT = 2u;
+
+// The relaxation rate of the antisymmetric part of the TRT operator. With
+// a fixed magic parameter (Ginzburg) it would vanish at low viscosities,
+// which are then less stable than with BGK, so it is fixed instead, like
+// the energy fluxes of MRT.
+const double trt_omega_a = 1.9;
+
+// The moments of the MRT operator (Lallemand & Luo, "Theory of the lattice
+// Boltzmann method", 2000): the density, the energy and its square, the x
+// momentum and energy flux, the y momentum and energy flux, and the
+// stresses. The rows are orthogonal, with the squared lengths `mrt_norm`.
+const double mrt_m[9][9] = double[9][9](
+    double[9]( 1.,  1.,  1.,  1.,  1.,  1.,  1.,  1.,  1.),
+    double[9](-4., -1., -1., -1., -1.,  2.,  2.,  2.,  2.),
+    double[9]( 4., -2., -2., -2., -2.,  1.,  1.,  1.,  1.),
+    double[9]( 0.,  1.,  0., -1.,  0.,  1., -1., -1.,  1.),
+    double[9]( 0., -2.,  0.,  2.,  0.,  1., -1., -1.,  1.),
+    double[9]( 0.,  0.,  1.,  0., -1.,  1.,  1., -1., -1.),
+    double[9]( 0.,  0., -2.,  0.,  2.,  1.,  1., -1., -1.),
+    double[9]( 0.,  1., -1.,  1., -1.,  0.,  0.,  0.,  0.),
+    double[9]( 0.,  0.,  0.,  0.,  0.,  1., -1.,  1., -1.));
+const double mrt_norm[9] = double[9](9., 36., 36., 6., 12., 6., 12., 4., 4.);
+
+// The relaxation rates of the moments which do not set the viscosity, the
+// energy, its square and the energy fluxes, from the same paper.
+const double mrt_s_e = 1.64;
+const double mrt_s_eps = 1.54;
+const double mrt_s_q = 1.9;
+
+
+// Collision step: relax f towards the equilibrium, with `u_collision`. The
+// relaxation rate `omega` sets the viscosity in all of them.
+void collide( inout double f[9], in double rho, in dvec2 u, in double omega ) {
+
+    double udotu = dot(u, u);
+    double feq[9], f_neq[9];
+    for (uint i = 0; i < 9; i++) {
+        feq[i] = calc_feq(i, rho, u, udotu);
+        f_neq[i] = abs(f[i]) - feq[i];
+    }
+
+    if (u_smagorinsky > 0.0) {
+        omega = smagorinsky_omega(omega, f_neq, rho, u_smagorinsky);
+    }
+
+    // Two relaxation times: the part which is symmetric in opposite
+    // directions relaxes with omega, the antisymmetric part with
+    // `trt_omega_a`.
+    if (u_collision == COLLISION_TRT) {
+        for (uint i = 0; i < 9; i++) {
+            uint j = inverti(i);
+            f[i] = max(0.0, abs(f[i]) -
+                            omega * (f_neq[i] + f_neq[j]) / 2.0 -
+                            trt_omega_a * (f_neq[i] - f_neq[j]) / 2.0);
+        }
+    }
+
+    // Multiple relaxation times: every moment relaxes at its own rate, the
+    // stresses with omega. The conserved moments relax with omega as well,
+    // so that the slope force acts like with the other operators.
+    else if (u_collision == COLLISION_MRT) {
+        double s[9] = double[9](omega, mrt_s_e, mrt_s_eps, omega, mrt_s_q,
+                                omega, mrt_s_q, omega, omega);
+        double dm[9];
+        for (uint k = 0; k < 9; k++) {
+            double m = 0.0;
+            for (uint i = 0; i < 9; i++) {
+                m += mrt_m[k][i] * f_neq[i];
+            }
+            dm[k] = s[k] * m / mrt_norm[k];
+        }
+        for (uint i = 0; i < 9; i++) {
+            double df = 0.0;
+            for (uint k = 0; k < 9; k++) {
+                df += mrt_m[k][i] * dm[k];
+            }
+            f[i] = max(0.0, abs(f[i]) - df);
+        }
+    }
+
+    // A single relaxation time (BGK): interpolate f with feq.
+    else {
+        for (uint i = 0; i < 9; i++) {
+            f[i] = max(0.0, (1 - omega) * abs(f[i]) + omega * feq[i]);
+        }
+    }
+}
+
+
+// Get f_i of the cell itself before streaming, used for the erosion.
+double get_phi( in uint i );
+
+
+// Advance a cell a frame: `flags` are the flags of the cell (see texture 0
+// of the `LatticeBoltzmann` class), `f` the streamed f_i values, `loc` the
+// cell and `step` the frame. Updates the flags and `f`, and returns the
+// velocity and density.
+//
+// With `suspended`, the sedimentation follows the suspended sediment: the
+// amount carried into the cell and the settled amount of the cell, in
+// `sediment`. Walls are deposited from the settled sediment and eroded
+// into the suspended sediment, so that the total is conserved.
+void update_cell( inout uvec4 flags, inout double f[9], out dvec2 u,
+                  out double rho, in ivec2 loc, in uint step,
+                  in bool suspended, inout dvec2 sediment ) {
+
+    // Parameter for "relaxation".
+    double omega = 2 / (6 * u_viscosity * delta_t /
+                        (delta_x * delta_x) + 1);
+
+    bool isIndestructible = flags.r != 0;
+    bool addWall = flags.g != 0;
+    bool isSource = flags.b != 0;
+    bool isWall = flags.a != 0;
+
+
+    // Make the wall.
+    if (addWall) {
+        isWall = true;
+        addWall = false;
+
+        // Invert f_i's.
+        for (uint i = 1; i < 9; i++) {
+            f[i] = -abs(f[i]);
+        }
+    }
+
+
+    #ifdef ENABLE_EROSION
+    if (u_settings[1] && isWall && !isSource) {
+
+        // Memory for force and bounce-back calculations.
+        double phi[9] = double[9](
+            get_phi(0u), get_phi(1u), get_phi(2u), get_phi(3u), get_phi(4u),
+            get_phi(5u), get_phi(6u), get_phi(7u), get_phi(8u)
+        );
+
+        if (!isIndestructible) {
+
+            // Calculate the momentum exchange
+            dvec2 F = wall_force(phi, f);
+
+            // dvec2 F = dvec2(0.0);
+            // for (uint i = 0; i < 9; i++) {
+            //     F += e[i] * (f2[i] - f[i]);
+            // }
+
+            double press = length(F) * 1;
+            // double press = length(u);
+
+            if (ero(float(press) - 0.01) >
+                rand(loc, step, STREAM_EROSION)) {
+                // Erosion, remove the wall
+                isWall = false;
+
+                // Its sediment, and what settled in it, is suspended.
+                if (suspended) {
+                    sediment.x += sediment_wall + sediment.y;
+                    sediment.y = 0.0;
+                }
+            }
+        }
+    }
+    #endif
+
+
+    // Calculate rho (the density) and u (the velocity vector).
+    rho = 0.0;
+    u = vec2(0.0);
+    for (uint i = 0; i < 9; i++) {
+        rho += abs(f[i]);// * double(f[i] > 0);
+        u += e[i] * abs(f[i]);// * double(f[i] > 0);
+    }
+
+    // Add the slope 'force' to simulate a pressure gradient.
+    #ifdef ENABLE_SLOPE
+    if (u_settings[3] && !isWall && !isSource) {
+        double u_len = length(u);
+        u += u_slope;
+
+        // Normalise the flow.
+        if (length(u) != 0.0) {
+            u *= u_len / length(u);
+        }
+    }
+    #endif
+    u *= c / rho;
+
+
+
+    // Collision step.
+    collide(f, rho, u, omega);
+
+
+    // Sedimentation.
+    #ifdef ENABLE_SEDIMENTATION
+    if (u_settings[2] && !isSource && !isWall && !suspended &&
+        sed(float(length(u))) >
+        rand(loc, step, STREAM_SEDIMENTATION) + 0.003) {
+        addWall = true; // Add wall next step.
+    }
+
+    // The suspended sediment settles as fast as the probability above, and
+    // a wall is added once a wall of sediment has settled.
+    if (u_settings[2] && !isSource && !isWall && suspended) {
+        double settled = max(sediment.x, 0.0) * sediment_settling *
+                         sed(float(length(u))) / sed_lim;
+        sediment -= dvec2(settled, -settled);
+        if (sediment.y >= sediment_wall) {
+            sediment.y -= sediment_wall;
+            addWall = true;
+        }
+    }
+    #endif
+
+    // Wall bounce back.
+    if (isWall) {
+
+        // Memory for force and bounce-back calculations.
+        double f2[9] = double[9](abs(f[0]), abs(f[1]), abs(f[2]),
+                                 abs(f[3]), abs(f[4]), abs(f[5]),
+                                 abs(f[6]), abs(f[7]), abs(f[8]));
+
+        const double momentum_mod = 1.00;
+
+        // Bounce back
+        f[2] = -f2[4] * momentum_mod; // N -> S
+        f[3] = -f2[1] * momentum_mod; // W -> E
+        f[4] = -f2[2] * momentum_mod; // S -> N
+        f[1] = -f2[3] * momentum_mod; // E ->f2
+        f[6] = -f2[8] * momentum_mod; // NW -> SE
+        f[7] = -f2[5] * momentum_mod; // SW -> NE
+        f[8] = -f2[6] * momentum_mod; // SE -> NW
+        f[5] = -f2[7] * momentum_mod; // NE -> SW
+
+
+        // Bounce back (old version)
+        // double f2c = f[2]; // N
+        // double f3c = f[3]; // W
+        // double f6c = f[6]; // NW
+        // double f7c = f[7]; // SW
+
+        // f[2] = -abs(f[4]); // N -> S
+        // f[3] = -abs(f[1]); // W -> E
+        // f[4] = -abs(f2c);  // S -> N
+        // f[1] = -abs(f3c);  // E -> W
+        // f[6] = -abs(f[8]); // NW -> SE
+        // f[7] = -abs(f[5]); // SW -> NE
+        // f[8] = -abs(f6c);  // SE -> NW
+        // f[5] = -abs(f7c);  // NE -> SW
+
+        // const double p = 0.0;
+        // const double q = 1 - p;
+        // f[2] = -(f2[2]*p + f2[4]*q); // N -> S
+        // f[3] = -(f2[1]*p + f2[3]*q); // W -> E
+        // f[4] = -(f2[4]*p + f2[2]*q); // S -> N
+        // f[1] = -(f2[1]*p + f2[3]*q); // E ->f2
+        // f[6] = -(f2[6]*p + f2[8]*q); // NW -> SE
+        // f[7] = -(f2[7]*p + f2[5]*q); // SW -> NE
+        // f[8] = -(f2[8]*p + f2[6]*q); // SE -> NW
+        // f[5] = -(f2[5]*p + f2[7]*q); // NE -> SW
+    }
+
+
+    // Flow to the right.
+    #ifdef ENABLE_FLOW
+    if (u_settings[0] && isSource) {
+        u = u0;
+        double udotu = dot(u, u);
+
+        rho = rho0;
+        for (uint i = 0; i < 9; i++) {
+            f[i] = calc_feq(i, rho0, u, udotu);
+        }
+        sediment = dvec2(sediment_inflow * rho0, 0.0);
+    }
+    #endif
+
+    flags = uvec4(isIndestructible, addWall, isSource, isWall);
+}
+
+#endif
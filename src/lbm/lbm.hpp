@@ -10,6 +10,11 @@
 
 #pragma once
 
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "../opengl/opengl.hpp"
 #include "../sdl/input.hpp"
 
@@ -58,15 +63,80 @@ namespace pcs {
          * | 6.rg       f7 (SW)         In/out        |
          * | 6.ba       f8 (SE)         In/out        |
          * +------------------------------------------+
+         *
+         * The suspended sediment (see `setSuspendedSediment()`) has its own
+         * texture, attached after the others while it is enabled: .rg is
+         * its concentration per unit of mass, .ba the settled sediment.
          */
         struct Buffers {
             GLuint texture[textureCount];
+            GLuint sediment;
+            GLuint fbo;
+        };
+
+        // Textures used to accumulate the statistics. See below.
+        static constexpr size_t statsTextureCount = 4;
+
+        /**
+         * The textures of the time averaged statistics, accumulated by
+         * `stats.frag` with Welford's method, and their Frame Buffer Object.
+         * The values are doubles, stored like in `Buffers`. The mean and the
+         * sums of squared deviations only include the samples in which the
+         * cell was fluid, and the shear only those in which it was a wall.
+         *
+         * +----------+-------------------------------+
+         * | Texture  | Mapped to                     |
+         * +----------+-------------------------------+
+         * | 0.rg       Mean u flow x                 |
+         * | 0.ba       Mean u flow y                 |
+         * | 1.rg       Mean rho                      |
+         * | 1.ba       Time integrated wall shear    |
+         * | 2.rg       Sum of squares u'_x u'_x      |
+         * | 2.ba       Sum of squares u'_y u'_y      |
+         * | 3.rg       Sum of products u'_x u'_y     |
+         * | 3.ba       Fluid sample count            |
+         * +------------------------------------------+
+         */
+        struct StatsBuffers {
+            GLuint texture[statsTextureCount];
             GLuint fbo;
         };
 
 
+        // Textures containing the derived fields, see `derivedTextures`.
+        static constexpr size_t derivedTextureCount = 3;
+
+
     public:
 
+        /**
+         * The fields which can be shown, cycled through with the G key: the
+         * speed, the vorticity, the strain rate, and the shear on the walls.
+         */
+        enum class View { Velocity, Vorticity, StrainRate, WallShear };
+        static constexpr int viewCount = 4;
+
+        /**
+         * The models which can be simulated: the flow of `lbm.frag`, with
+         * erosion and sedimentation, or the depth averaged shallow water
+         * model of `swe.frag`, which follows the elevation of heightmaps.
+         */
+        enum class Model { Flow, ShallowWater };
+
+        /**
+         * The collision operators of the flow, see `setCollision()`.
+         */
+        enum class Collision { BGK, TRT, MRT };
+
+        // The lbm, visual, reduce, stats and derived programs, the compute
+        // program of the temporal blocking, the shallow water program and
+        // the coupling of the refinement patches.
+        static constexpr size_t programCount = 8;
+
+        // The most frames of a block, see `setBlockSteps()`. Longer blocks
+        // leave at most 6 by 6 of the 16 by 16 cells of a tile.
+        static constexpr unsigned maxBlockSteps = 4;
+
         /**
          * The constructor loads the specified river bitmap and initialises the
          * two `Buffer` structs (one to render from and one to render to)
@@ -74,16 +144,67 @@ namespace pcs {
          * shaders `lbm.frag` (for all computations) and `visual.frag` (for
          * rendering) and performs the rendering setup.
          *
+         * The map is imported with a `MapImporter`, so besides bitmaps it
+         * can be a PNG file, or a grayscale heightmap.
+         *
+         * With the shallow water model, the elevation of a heightmap is
+         * kept as the bed, and the water is initially still up to the
+         * water level. Other maps have a flat bed.
+         *
          * @param renderer The OpenGL instance
-         * @param riverFile The path to the river .bmp file
+         * @param riverFile The path to the river .bmp or .png file
+         * @param waterLevel For heightmaps, the relative elevation above
+         *                   which cells are walls (see `MapImporter`)
+         * @param model The model to simulate
+         * @param relief For the shallow water model, the difference between
+         *               the lowest and highest elevation, in cells
          */
-        LatticeBoltzmann( GLRenderer& renderer, const std::string& riverFile );
+        LatticeBoltzmann( GLRenderer& renderer, const std::string& riverFile,
+                          double waterLevel = 0.1, Model model = Model::Flow,
+                          double relief = 1.0 );
+
+        /**
+         * Construct the model from an already loaded background texture,
+         * which contains the initial cell flags (as created with
+         * `genFlagsTexture()`). This is used for configurations which are
+         * not read from a single file, like the texture atlas of a batch
+         * run. The model takes ownership of the texture.
+         *
+         * @param renderer The OpenGL instance
+         * @param backgroundTexture The river configuration texture
+         * @param width Width of the background texture
+         * @param height Height of the background texture
+         */
+        LatticeBoltzmann( GLRenderer& renderer, GLuint backgroundTexture,
+                          int width, int height );
 
         /**
          * Deconstruct the `Buffer` structs and OpenGL programs.
          */
         void close();
 
+        /**
+         * Restart the model with new cell flags of the same size, as if it
+         * was newly constructed, but reusing its textures and programs. The
+         * model takes ownership of the texture.
+         *
+         * @param renderer The OpenGL instance
+         * @param backgroundTexture The river configuration texture, of the
+         *                          size of the lattice
+         */
+        void reset( GLRenderer& renderer, GLuint backgroundTexture );
+
+        /**
+         * The programs are compiled by the first lattice, shared by all
+         * lattices of the context, and deleted with the last one. Keep them
+         * compiled when no lattice exists, for processes which create many
+         * lattices one after another.
+         *
+         * @param keep If the programs are kept; when false, they are
+         *             deleted if no lattice exists
+         */
+        static void keepPrograms( bool keep );
+
         /**
          * The update loop of the simulation. It advances the simulation with
          * `framestep` frames, after which it renders the current system state
@@ -103,12 +224,584 @@ namespace pcs {
         void update( GLRenderer& renderer, InputData& input,
                      int width, int height );
 
-    private:
+        /**
+         * Render the visualisation of the current frame (using
+         * `visual.frag`) to the current render target. This is done by
+         * `update()` for the window, but can also be used to render it
+         * offscreen. When the lattice is shrunk to less than half its size,
+         * a reduced level of the display pyramid is rendered instead, see
+         * `renderPyramid()`.
+         *
+         * @param renderer The OpenGL instance
+         * @param x The x position to render the lattice to
+         * @param y The y position to render the lattice to
+         * @param w The width to render the lattice with
+         * @param h The height to render the lattice with
+         * @param targetWidth The width of the render target
+         * @param targetHeight The height of the render target
+         */
+        void renderFields( GLRenderer& renderer,
+                           float x, float y, float w, float h,
+                           int targetWidth, int targetHeight );
+
+        /**
+         * Advance the simulation with `steps` frames, using the current
+         * settings, without handling input or rendering to the screen.
+         *
+         * @param renderer The OpenGL instance
+         * @param steps The amount of frames to simulate
+         */
+        void step( GLRenderer& renderer, unsigned steps );
+
+        /**
+         * Render a rectangular region of the next frame, without advancing
+         * the frame counter. This way a frame can be split up in several
+         * regions, for example to read back the edges of a lattice while its
+         * interior is still being rendered. Call `finishFrame()` once every
+         * region has been rendered.
+         *
+         * @param renderer The OpenGL instance
+         * @param x The left side of the region
+         * @param y The bottom side of the region
+         * @param w The width of the region
+         * @param h The height of the region
+         */
+        void stepRegion( GLRenderer& renderer, int x, int y, int w, int h );
+
+        /**
+         * Advance the frame counter after rendering with `stepRegion()`.
+         */
+        inline void finishFrame() {
+            ++frame;
+            displayValid = false;
+        }
+
+
+        // The textures containing the streamed f_i values (f1 to f8). These
+        // are the only values a cell reads from its neighbours, so they form
+        // the halo of a lattice which is split up.
+        static constexpr size_t haloTextureFirst = 3;
+        static constexpr size_t haloTextureCount = 4;
+
+        /**
+         * Get the size of the halo data of a region, in unsigned integers.
+         *
+         * @param w The width of the region
+         * @param h The height of the region
+         * @return The amount of unsigned integers
+         */
+        static inline size_t haloSize( int w, int h ) {
+            return haloTextureCount * 4 * w * h;
+        }
+
+        /**
+         * Start reading the streamed f_i values of a region of the frame
+         * which is being rendered by `stepRegion()`. The data is read into
+         * the bound `GL_PIXEL_PACK_BUFFER` at `offset` (in bytes), so it does
+         * not stall the pipeline, and is `haloSize()` integers long.
+         *
+         * @param x The left side of the region
+         * @param y The bottom side of the region
+         * @param w The width of the region
+         * @param h The height of the region
+         * @param offset Offset in the pixel pack buffer
+         */
+        void readHalo( int x, int y, int w, int h, size_t offset );
+
+        /**
+         * Overwrite the streamed f_i values of a region of the current frame,
+         * with data as read by `readHalo()`.
+         *
+         * @param x The left side of the region
+         * @param y The bottom side of the region
+         * @param w The width of the region
+         * @param h The height of the region
+         * @param data The halo data
+         */
+        void writeHalo( int x, int y, int w, int h, const GLuint* data );
+
+
+        /**
+         * Summarised flow data of a rectangular region of the lattice.
+         */
+        struct Summary {
+            size_t fluidCells, wallCells;
+            double mass;               // Total rho of the fluid cells.
+            double totalMass;          // Total rho of all the cells.
+            double sediment;           // The suspended and settled
+                                       // sediment, or 0 without it (see
+                                       // `setSuspendedSediment()`).
+            double meanSpeed, maxSpeed;
+            uint64_t checksum;         // Hash of all the texture data.
+        };
+
+        /**
+         * Read back the current state of a rectangular region of the lattice
+         * and summarise it. This stalls the pipeline, so it should not be
+         * called every frame.
+         *
+         * @param x The left side of the region
+         * @param y The bottom side of the region
+         * @param w The width of the region
+         * @param h The height of the region
+         * @return The summary of the region
+         */
+        Summary summarise( int x, int y, int w, int h );
+
+        /**
+         * Set the seed of the random numbers used for erosion and
+         * sedimentation. Together with the frame counter it determines all
+         * random decisions, so that runs with the same seed and input are
+         * reproducible bit for bit.
+         *
+         * @param seed The seed
+         */
+        inline void setSeed( unsigned seed_ ) { seed = seed_; }
+
+        /**
+         * Set the position of this lattice within a larger domain. The random
+         * numbers are keyed on the position in the domain, so that a domain
+         * which is split up over several lattices gives the same results as
+         * a single lattice.
+         *
+         * @param x The x position of the left side
+         * @param y The y position of the bottom side
+         */
+        inline void setOrigin( int x, int y ) {
+            originX = x;
+            originY = y;
+        }
+
+        /**
+         * Enable or disable one of the flow settings, which are (in order)
+         * [flow, erosion, sedimentation, slope]. These are the same
+         * settings as toggled with the Q, W, E and R keys.
+         *
+         * @param index The index of the setting
+         * @param enabled If the setting should be enabled
+         */
+        inline void setSetting( size_t index, bool enabled ) {
+            settings[index] = enabled;
+        }
+
+        /**
+         * Set the viscosity of the fluid. Be warned that the model becomes
+         * numerically unstable for low viscosities.
+         *
+         * @param viscosity The viscosity (in lattice units)
+         */
+        inline void setViscosity( double viscosity_ ) {
+            viscosity = viscosity_;
+        }
+
+        /**
+         * Set the collision operator of the flow: a single relaxation time
+         * (BGK), two relaxation times (TRT) for the parts of the f_i values
+         * which are symmetric and antisymmetric in opposite directions, or
+         * a relaxation time per moment (MRT). The viscosity is the same in
+         * all of them, but the other relaxation times of TRT and MRT damp
+         * the instabilities of low viscosities. The shallow water model
+         * always uses BGK.
+         *
+         * @param collision The collision operator
+         */
+        inline void setCollision( Collision collision_ ) {
+            collision = collision_;
+        }
+
+        /**
+         * Set the constant of the Smagorinsky subgrid model, which adds an
+         * eddy viscosity (C delta_x)^2 |S| for the strain rate |S| of every
+         * cell. It models the flow below the size of the cells, which keeps
+         * coarse lattices with a low viscosity stable. Values around 0.1 to
+         * 0.2 are common, 0 disables it.
+         *
+         * @param constant The Smagorinsky constant
+         */
+        inline void setSmagorinsky( double constant ) {
+            smagorinsky = std::max(0.0, constant);
+        }
+
+        /**
+         * Enable or disable the suspended sediment, which replaces the
+         * random sedimentation of the flow by one which conserves the
+         * sediment. The sediment is carried by the fluid, and settles as
+         * fast as the sedimentation would add walls, slowly in fast flow.
+         * A wall is added once a wall of sediment has settled in a cell,
+         * and eroded walls are suspended again. The sources bring in water
+         * with a little sediment, so the sediment comes from upstream and
+         * from the banks, instead of anywhere at any time.
+         *
+         * It is computed in the same pass as the flow (`lbm.frag`), so it
+         * costs a texture per cell, which only exists while it is enabled.
+         * Enabling it starts without sediment. It is only available for the
+         * flow model, and disables temporal blocking.
+         *
+         * @param enabled If the suspended sediment should be enabled
+         */
+        void setSuspendedSediment( bool enabled );
+
+        // The most refinement patches, see `setRefinement()`.
+        static constexpr size_t maxPatches = 256;
+
+        /**
+         * Refine the lattice along the banks of the river, where the
+         * erosion happens. The lattice is divided into squares, and every
+         * `interval` frames the squares with fluid next to destructible
+         * walls get a patch with `factor` times the resolution, and the
+         * other patches are removed, so the patches follow the channel.
+         *
+         * A patch covers its square and a ring of a cell around it, and
+         * takes `factor` frames per frame of the lattice. Its ring is
+         * interpolated from the lattice before every frame, and afterwards
+         * the square of the lattice is replaced by the average of the patch
+         * (see `refine.frag`), walls included. Patches do not exchange
+         * values with each other directly, only through the lattice.
+         *
+         * The probabilities of erosion and sedimentation are per frame and
+         * cell, so they act more often in the patches. Refinement is only
+         * available for the flow model, and disables temporal blocking.
+         *
+         * @param renderer The OpenGL instance
+         * @param factor The refinement, from 2 to 4, or 1 to disable it
+         * @param size The size of the squares, in cells
+         * @param interval The frames between placing the patches
+         */
+        void setRefinement( GLRenderer& renderer, unsigned factor,
+                            int size = 32, unsigned interval = 500 );
+
+        /**
+         * Enable or disable the fused display. When enabled, the last frame
+         * of every `step()` also writes the visualisation into a display
+         * texture (in `lbm.frag`), while it has all the values at hand.
+         * `renderFields()` then only has to copy that texture, instead of
+         * reading back the lattice in a separate pass.
+         *
+         * @param enabled If the fused display should be enabled
+         */
+        inline void setFusedDisplay( bool enabled ) {
+            fusedDisplay = enabled;
+            displayValid = false;
+        }
+
+        /**
+         * Set the amount of frames simulated between rendering, in
+         * `update()`.
+         *
+         * @param framestep The amount of frames, at least 1
+         */
+        inline void setFramestep( unsigned framestep_ ) {
+            framestep = std::max(1u, framestep_);
+        }
+
+        /**
+         * Set the size of the tiles in which every frame is drawn, as a
+         * draw per tile, or 0 to draw the whole lattice at once. Smaller
+         * draws can keep the data of a draw in the caches of some GPUs,
+         * and give the software rasteriser smaller jobs. The result does
+         * not depend on the tile size.
+         *
+         * @param size The width and height of the tiles, in cells
+         */
+        inline void setTileSize( int size ) { tileSize = std::max(0, size); }
+
+        /**
+         * Set the amount of frames simulated per pass with temporal blocking,
+         * or 1 to simulate a frame per pass. With temporal blocking, tiles
+         * of 16 by 16 cells are loaded into shared memory by `lbm.comp`, and
+         * advanced several frames at once, so the lattice is only read and
+         * written once per block instead of every frame. Every tile needs a
+         * halo of a cell per frame, so the tiles overlap more for longer
+         * blocks. Blocks are ended early for the statistics and derived
+         * fields. The result does not depend on the block length.
+         *
+         * Blocks are not used if the compute shader is not available.
+         *
+         * @param steps The frames per block, from 1 to `maxBlockSteps`
+         */
+        inline void setBlockSteps( unsigned steps ) {
+            blockSteps = std::min(std::max(1u, steps), maxBlockSteps);
+        }
+
+        // The amount of values of the statistics per cell.
+        static constexpr size_t statsValues = 2 * statsTextureCount;
+
+        /**
+         * Enable the time averaged flow statistics, which are accumulated
+         * on the GPU every `interval` frames of `step()`, without reading
+         * anything back. An interval of 0 disables them and frees their
+         * textures. (Re)enabling the statistics resets them.
+         *
+         * @param interval The amount of frames between the samples
+         */
+        void enableStatistics( unsigned interval );
+
+        /**
+         * Discard the accumulated statistics and start again, for example
+         * once the flow has developed.
+         */
+        void resetStatistics();
+
+        /**
+         * Read back the statistics of a rectangular region of the lattice.
+         * Every cell has `statsValues` values, see `convertStatistics()`.
+         * Like `summarise()`, this stalls the pipeline.
+         *
+         * @param x The left side of the region
+         * @param y The bottom side of the region
+         * @param w The width of the region
+         * @param h The height of the region
+         * @param stats Returns the statistics of every cell
+         */
+        void readStatistics( int x, int y, int w, int h,
+                             std::vector<double>& stats );
+
+        /**
+         * Convert the raw accumulated values of a cell (in the order of
+         * `StatsBuffers`) to the statistics, which are (in order) the mean
+         * x and y velocity, the mean density, the variance of the x and y
+         * velocity, the Reynolds shear stress -<u'_x u'_y> (per unit of
+         * density), the time integrated wall shear and the fluid sample
+         * count.
+         *
+         * @param raw The raw values of a cell
+         * @param stats Returns the statistics of the cell
+         */
+        static inline void convertStatistics( const double* raw,
+                                              double* stats ) {
+            const double n = raw[7];
+            stats[0] = raw[0];
+            stats[1] = raw[1];
+            stats[2] = raw[2];
+            stats[3] = n > 0 ? raw[4] / n : 0.0;
+            stats[4] = n > 0 ? raw[5] / n : 0.0;
+            stats[5] = n > 0 ? -raw[6] / n : 0.0;
+            stats[6] = raw[3];
+            stats[7] = n;
+        }
+
+        /**
+         * Compute the derived fields of the current frame with
+         * `derived.frag`, unless they are already up to date. These are
+         * computed on demand, by `renderFields()` when they are shown, or
+         * every frame interval set with `setDerivedInterval()`.
+         *
+         * @param renderer The OpenGL instance
+         */
+        void updateDerived( GLRenderer& renderer );
+
+        /**
+         * Compute the derived fields every `interval` frames of `step()`,
+         * instead of only on demand. When set, the shown derived fields are
+         * those of the last computation. An interval of 0 disables it.
+         *
+         * @param interval The amount of frames between the computations
+         */
+        inline void setDerivedInterval( unsigned interval ) {
+            derivedInterval = interval;
+        }
+
+        /**
+         * Get one of the derived fields textures, for example to copy it.
+         * See `derivedTextures` for the contents of the textures. They only
+         * exist once `updateDerived()` has been called.
+         *
+         * @param index The index of the texture
+         * @return The texture id
+         */
+        inline GLuint getDerivedTexture( size_t index ) const {
+            return derivedTextures[index];
+        }
+
+        // The frame of the derived fields, if they have been computed.
+        inline bool hasDerived() const { return derivedValid; }
+        inline unsigned getDerivedFrame() const { return derivedFrame; }
+
+        /**
+         * Set the field shown by `renderFields()`.
+         *
+         * @param view The field to show
+         */
+        inline void setView( View view_ ) { view = view_; }
+
+        /**
+         * Get one of the current statistics textures, for example to copy
+         * it. See `StatsBuffers` for the contents of the textures.
+         *
+         * @param index The index of the texture
+         * @return The texture id
+         */
+        inline GLuint getStatisticsTexture( size_t index ) const {
+            return statsBuffers[statsIndex % 2].texture[index];
+        }
+
+        inline bool hasStatistics() const { return statsInterval > 0; }
+
+        /**
+         * Reset the f_i values of the whole lattice to the equilibrium of
+         * a uniform flow with velocity (`u_x`, `u_y`) and the initial
+         * density. At construction the fluid is at rest.
+         *
+         * @param u_x The x velocity
+         * @param u_y The y velocity
+         */
+        void initialiseFlow( double u_x, double u_y );
+
+        /**
+         * Read back the velocity and the walls of a rectangular region of the
+         * lattice. The velocity contains two values (x and y) per cell. Like
+         * `summarise()`, this stalls the pipeline.
+         *
+         * @param x The left side of the region
+         * @param y The bottom side of the region
+         * @param w The width of the region
+         * @param h The height of the region
+         * @param u Returns the velocity of every cell
+         * @param walls Returns if every cell is a wall
+         */
+        void readVelocity( int x, int y, int w, int h,
+                           std::vector<double>& u, std::vector<bool>& walls );
+
+        /**
+         * Read back which cells of a rectangular region of the lattice are
+         * walls, or become walls in the next frame (like the walls of the
+         * river file before the first frame). Only a byte per flag is read, so this reads a quarter of
+         * the data of `readVelocity()`, but it stalls the pipeline as well.
+         *
+         * @param x The left side of the region
+         * @param y The bottom side of the region
+         * @param w The width of the region
+         * @param h The height of the region
+         * @param walls Returns if every cell is a wall
+         */
+        void readWalls( int x, int y, int w, int h, std::vector<bool>& walls );
+
+        /**
+         * Save the state of the lattice to a file: all textures of the
+         * current frame, the frame counter, the seed, the viscosity, the
+         * settings, the collision operator, the Smagorinsky constant, the
+         * model and the refinement, and the suspended sediment if it is
+         * enabled. The statistics and derived fields are not saved.
+         *
+         * @param path The path of the checkpoint file
+         * @return True on success, false otherwise.
+         */
+        bool saveCheckpoint( const std::string& path );
+
+        /**
+         * Restore the state of the lattice from a checkpoint file, which
+         * must have been saved from a lattice of the same size, model and
+         * refinement, as these decide the textures of the lattice. The run
+         * continues exactly as the saved run would have.
+         *
+         * @param path The path of the checkpoint file
+         * @return True on success, false otherwise.
+         */
+        bool loadCheckpoint( const std::string& path );
+
+        /**
+         * An allocation of GPU memory, see `memoryUsage()`.
+         */
+        struct Allocation {
+            std::string name;
+            size_t bytes;
+        };
+
+        /**
+         * What decides the memory of a lattice besides its size: the model
+         * and the optional textures.
+         */
+        struct Storage {
+            Model model = Model::Flow;
+            bool sediment = false;     // See `setSuspendedSediment()`.
+            bool statistics = false;   // See `enableStatistics()`.
+            bool derived = false;      // See `updateDerived()`.
+            unsigned refineFactor = 1; // See `setRefinement()`.
+            int patchSize = 32;
+        };
+
+        /**
+         * Get the GPU memory a lattice would allocate, per allocation,
+         * without creating it. The refinement patches are counted at their
+         * most: a patch on every square, up to `maxPatches`.
+         *
+         * @param width The width of the lattice
+         * @param height The height of the lattice
+         * @param storage The storage of the lattice
+         * @return The allocations
+         */
+        static std::vector<Allocation> memoryUsage( int width, int height,
+                                                    const Storage& storage );
+
+        /**
+         * Get the GPU memory used by the lattice, per allocation, with the
+         * patches it has.
+         *
+         * @return The allocations
+         */
+        std::vector<Allocation> memoryUsage() const;
+
+        // The total of allocations, in bytes.
+        static inline size_t totalMemory( const std::vector<Allocation>& usage ) {
+            size_t total = 0;
+            for (const Allocation& allocation : usage) {
+                total += allocation.bytes;
+            }
+            return total;
+        }
+
+        /**
+         * Get the amount of GPU memory used by the lattice textures, in bytes.
+         *
+         * @return The memory footprint in bytes
+         */
+        inline size_t memoryFootprint() const {
+            return totalMemory(memoryUsage());
+        }
+
+        /**
+         * Get one of the textures of the current frame, for example to copy
+         * it. See `Buffers` for the contents of the textures.
+         *
+         * @param index The index of the texture
+         * @return The texture id
+         */
+        inline GLuint getTexture( size_t index ) const {
+            return buffers[frame % 2].texture[index];
+        }
+
+        // Dimensions and frame counter getters.
+        inline int getWidth() const { return width; }
+        inline int getHeight() const { return height; }
+        inline unsigned getFrame() const { return frame; }
+
+        // Getters for the settings and the view, as toggled by the keys.
+        inline bool getSetting( size_t index ) const {
+            return settings[index];
+        }
+        inline View getView() const { return view; }
+        inline unsigned getFramestep() const { return framestep; }
+        inline int getTileSize() const { return tileSize; }
+        inline unsigned getBlockSteps() const { return blockSteps; }
+        inline bool hasBlocking() const { return programs[5] != 0; }
+        inline Model getModel() const { return model; }
+        inline Collision getCollision() const { return collision; }
+        inline double getSmagorinsky() const { return smagorinsky; }
+        inline size_t getPatchCount() const { return patches.size(); }
+        inline bool hasSuspendedSediment() const { return suspended; }
+        inline bool hasFusedDisplay() const { return fusedDisplay; }
+
+        /**
+         * If the flow is paused with P, and no single frame is requested
+         * with F, so that `update()` would not step.
+         */
+        inline bool isPaused() const { return paused && !runFrame; }
 
         /**
          * Redirect user input to the model. For a list of the inputs handled
          * within this function, see the first keymap list within the
-         * `README.md` file.
+         * `README.md` file. This is called by `update()`, but can be used
+         * without a window, for input from elsewhere.
          *
          * @see LatticeBoltzmann:update()
          *
@@ -117,6 +810,8 @@ namespace pcs {
          */
         void handleInput( GLRenderer& renderer, InputData& input );
 
+    private:
+
         /**
          * Data extraction according to user input. Handles the "Sherlock"
          * pointer which the user can use to extract numerical data from the
@@ -130,12 +825,151 @@ namespace pcs {
          */
         void readPixels( GLRenderer& renderer, InputData& input );
 
+        /**
+         * Render a reduced level of the display pyramid. The visible region
+         * of the display image is rendered (unless the fused display already
+         * did), and reduced to the given level by averaging 2x2 texels per
+         * level with `reduce.frag`. Only that level is sampled for the
+         * target, so zooming out does not read the whole lattice per pixel.
+         *
+         * @param renderer The OpenGL instance
+         * @param x The x position to render the lattice to
+         * @param y The y position to render the lattice to
+         * @param w The width to render the lattice with
+         * @param h The height to render the lattice with
+         * @param targetWidth The width of the render target
+         * @param targetHeight The height of the render target
+         * @param level The level of the pyramid, 1 is half the lattice size
+         */
+        void renderPyramid( GLRenderer& renderer,
+                            float x, float y, float w, float h,
+                            int targetWidth, int targetHeight, int level );
+
+        /**
+         * Initialise the buffers and programs. Called by the constructors
+         * once the background texture has been loaded.
+         *
+         * @param renderer The OpenGL instance
+         */
+        void initialise( GLRenderer& renderer );
+
+        /**
+         * Set the state and settings to those of a new lattice.
+         */
+        void setDefaults();
+
+        /**
+         * Clear the lattice to the equilibrium flow and the cell flags of
+         * the background texture.
+         *
+         * @param renderer The OpenGL instance
+         */
+        void clearLattice( GLRenderer& renderer );
+
+        /**
+         * Use `visual.frag` to render, with the textures and view bound.
+         *
+         * @param renderer The OpenGL instance
+         */
+        void useVisual( GLRenderer& renderer );
+
+        /**
+         * Add a sample of the current frame to the statistics, with
+         * `stats.frag`.
+         *
+         * @param renderer The OpenGL instance
+         */
+        void accumulateStatistics( GLRenderer& renderer );
+
+        /**
+         * Use the program of the model to render the next frame, with its
+         * uniforms set.
+         *
+         * @param renderer The OpenGL instance
+         */
+        void useStepProgram( GLRenderer& renderer );
+
+        // The program which renders the next frame of the model.
+        inline GLuint stepProgram() const {
+            return model == Model::ShallowWater ? programs[6] : programs[0];
+        }
+
+        /**
+         * Advance the simulation with a block of frames in a single pass of
+         * `lbm.comp`, see `setBlockSteps()`.
+         *
+         * @param renderer The OpenGL instance
+         * @param steps The amount of frames, from 2 to `maxBlockSteps`
+         * @param display If the display image should be written
+         */
+        void stepBlock( GLRenderer& renderer, unsigned steps, bool display );
+
+        /**
+         * What `refine.frag` renders: the ring of a patch, the whole patch
+         * (for new patches), or the square of the lattice under the patch.
+         */
+        enum class Coupling { Ring, Full, Restrict };
+
+        // A refinement patch, see `setRefinement()`. It refines the square
+        // of `width` by `height` cells from (`x`, `y`), with a ring of a
+        // cell around it.
+        struct Patch {
+            int x, y, width, height;
+            std::unique_ptr<LatticeBoltzmann> lattice;
+        };
+
+        /**
+         * Advance the patches a frame of the lattice, after the lattice, and
+         * replace the squares of the lattice under them.
+         *
+         * @param renderer The OpenGL instance
+         */
+        void stepPatches( GLRenderer& renderer );
+
+        /**
+         * Place the patches on the squares along the banks, keeping the
+         * patches which are still on a bank.
+         *
+         * @param renderer The OpenGL instance
+         */
+        void regrid( GLRenderer& renderer );
+
+        /**
+         * Render between a patch and the lattice with `refine.frag`.
+         *
+         * @param renderer The OpenGL instance
+         * @param patch The patch
+         * @param coupling What to render
+         * @param alpha The time between the last two frames of the lattice
+         */
+        void couple( GLRenderer& renderer, Patch& patch, Coupling coupling,
+                     double alpha );
+
+        // Close and remove the patches.
+        void closePatches();
+
+        /**
+         * Read a rectangular region of one of the current textures into
+         * `data`, which will contain 4 unsigned integers per cell.
+         *
+         * @param index The index of the texture, see `Buffers`
+         * @param x The left side of the region
+         * @param y The bottom side of the region
+         * @param w The width of the region
+         * @param h The height of the region
+         * @param data Returns the texture data
+         */
+        void readTexture( size_t index, int x, int y, int w, int h,
+                          std::vector<GLuint>& data );
+
 
         // Dimensions of the river texture.
         int width, height;
 
         // OpenGL references
-        GLuint programs[2]; // Contains the lbm and visual fragment shaders.
+        // The lbm, visual, reduce, stats and derived fragment shaders, and
+        // the lbm compute shader, which are shared with the other lattices.
+        GLuint programs[programCount];
         GLuint u_textures[textureCount]; // The uniform texture locations.
         GLuint backgroundTexture;
 
@@ -143,6 +977,69 @@ namespace pcs {
         // [enable flow, enable corrosion, enable sedimentation].
         GLuint u_settings;
 
+        // The random seed and the current frame, used for random numbers.
+        GLuint u_seed, u_step;
+        unsigned seed;
+
+        // The position of the lattice in the domain, see `setOrigin()`.
+        GLuint u_origin;
+        int originX, originY;
+
+        // The fused display, see `setFusedDisplay()`. The display texture
+        // is valid if it was written by the last frame. Its mipmap levels
+        // form the display pyramid, which is rendered through `displayFBO`.
+        GLuint u_display;
+        GLuint displayTexture, displayFBO;
+        int displayLevels;
+        bool fusedDisplay, displayValid;
+
+        // The statistics, see `enableStatistics()`. The samples are added
+        // to the buffers in turn, `statsIndex` counts them.
+        GLuint u_stats[statsTextureCount], u_interval;
+        StatsBuffers statsBuffers[2];
+        unsigned statsInterval, statsIndex;
+
+        // The derived fields, computed by `derived.frag`, with the frame
+        // they were computed for. The textures are only created when first
+        // needed. The values are doubles, stored like in `Buffers`:
+        // 0.rg vorticity, 0.ba strain rate magnitude sqrt(2 S:S),
+        // 1.rg viscous stress xx, 1.ba stress xy, 2.rg stress yy and
+        // 2.ba the shear of the flow on walls (the momentum exchange).
+        // The strain rate and stress are computed from the non-equilibrium
+        // part of the f_i values, the vorticity from the velocity.
+        GLuint u_derived[derivedTextureCount], u_derivedViscosity,
+               u_derivedSmagorinsky;
+        GLuint derivedTextures[derivedTextureCount], derivedFBO;
+        unsigned derivedInterval, derivedFrame;
+        bool derivedValid;
+
+        // The shown field, see `View`.
+        GLuint u_view;
+        View view;
+
+        // The viscosity of the fluid.
+        GLuint u_viscosity;
+        double viscosity;
+
+        // The collision operator and the Smagorinsky constant, see
+        // `setCollision()` and `setSmagorinsky()`.
+        GLuint u_collision, u_smagorinsky;
+        Collision collision;
+        double smagorinsky;
+
+        // The refinement, see `setRefinement()`, and the uniform locations
+        // of `refine.frag`.
+        std::vector<Patch> patches;
+        unsigned refineFactor, refineInterval;
+        int patchSize;
+        GLuint u_previous, u_coupling, u_refineFactor, u_patchOffset,
+               u_patchCells, u_couplingTime, u_couplingViscosity,
+               u_couplingSediment;
+
+        // The suspended sediment, see `setSuspendedSediment()`.
+        GLuint u_sediment, u_suspended;
+        bool suspended;
+
 
         // Buffers objects as described above. One
         // to render from and one to render to.
@@ -152,13 +1049,29 @@ namespace pcs {
         unsigned framestep;
         unsigned frame;
 
+        // The size of the tiles drawn per frame, or 0 for the lattice.
+        int tileSize;
+
+        // The frames per block, see `setBlockSteps()`.
+        GLuint u_steps;
+        unsigned blockSteps;
+
+        // The model, and for the shallow water model the elevation of the
+        // bed (relative, as a float texture), its range in cells and the
+        // relative water surface.
+        Model model;
+        GLuint u_elevation, u_relief, u_surface, u_initialise;
+        GLuint elevationTexture;
+        double relief, surface;
+
         // Settings, as described above.
         bool paused;
         bool runFrame;
         bool settings[4];
 
-        // Viewport and cursor positions.
+        // Viewport and cursor positions, and the size of the window.
         float screenX, screenY, screenScale;
+        int viewWidth, viewHeight;
         int cursorX, cursorY;
     };
 }
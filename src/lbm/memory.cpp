@@ -0,0 +1,146 @@
+/**
+ * Planning the GPU memory of a run. See memory.hpp for details.
+ *
+ * @file memory.cpp
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#include "memory.hpp"
+
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <utility>
+
+#include "capture.hpp"
+#include "output.hpp"
+#include "stream.hpp"
+#include "../print.hpp"
+
+using namespace pcs;
+
+
+// Format an amount of bytes in MiB.
+static std::string mebibytes( size_t bytes ) {
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1) << bytes / 1048576.0 << " MiB";
+    return ss.str();
+}
+
+
+std::vector<LatticeBoltzmann::Allocation> pcs::memoryUsage(
+        int width, int height, const StoragePlan& plan ) {
+
+    std::vector<LatticeBoltzmann::Allocation> usage =
+        LatticeBoltzmann::memoryUsage(width, height, plan.lattice);
+    usage.push_back({"snapshots", plan.snapshots() *
+                     OutputThread::snapshotMemory(width, height)});
+    if (plan.captureWidth > 0 && plan.captureHeight > 0) {
+        usage.push_back({"capture", Capture::captureMemory(
+                             plan.captureWidth, plan.captureHeight)});
+    }
+    if (plan.streamWidth > 0 && plan.streamHeight > 0) {
+        usage.push_back({"stream", Stream::streamMemory(
+                             plan.streamWidth, plan.streamHeight)});
+    }
+    return usage;
+}
+
+size_t pcs::deviceMemory() {
+
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i) {
+        const char* name = (const char*) glGetStringi(GL_EXTENSIONS, i);
+        if (name == nullptr) {
+            continue;
+        }
+
+        // Both report the free memory in KiB.
+        if (std::strcmp(name, "GL_NVX_gpu_memory_info") == 0) {
+            GLint available = 0;
+            glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX,
+                          &available);
+            return (size_t) available * 1024;
+        }
+        if (std::strcmp(name, "GL_ATI_meminfo") == 0) {
+            GLint info[4] = {0};
+            glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, info);
+            return (size_t) info[0] * 1024;
+        }
+    }
+    return 0;
+}
+
+bool pcs::fitMemory( int width, int height, size_t budget,
+                     StoragePlan& plan ) {
+
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    if (width > maxSize || height > maxSize) {
+        print("The lattice of", width, "x", height, "exceeds the maximum",
+              "texture size of", maxSize, "of this device");
+        return false;
+    }
+    if (budget == 0) {
+        return true;
+    }
+
+    // Only the snapshot queue is reduced, which changes when saving waits,
+    // but not the physics or the outputs of the run.
+    if (LatticeBoltzmann::totalMemory(memoryUsage(width, height, plan)) >
+            budget && plan.queue > 1) {
+        plan.queue = 1;
+        print("Using a single snapshot buffer per output to fit the memory",
+              "budget of", mebibytes(budget));
+    }
+
+    const size_t total = LatticeBoltzmann::totalMemory(
+        memoryUsage(width, height, plan));
+    if (total > budget) {
+        std::string options;
+        for (const auto& option : {
+                 std::make_pair(plan.lattice.sediment, "suspended sediment"),
+                 std::make_pair(plan.lattice.statistics, "statistics"),
+                 std::make_pair(plan.lattice.derived, "derived fields"),
+                 std::make_pair(plan.lattice.refineFactor > 1, "refinement"),
+                 std::make_pair(plan.captureWidth > 0, "capture"),
+                 std::make_pair(plan.streamWidth > 0, "stream")}) {
+            if (option.first) {
+                options += (options.empty() ? "" : ", ") +
+                           std::string(option.second);
+            }
+        }
+        print("The lattice of", width, "x", height, "needs",
+              mebibytes(total), "of GPU memory, more than the budget of",
+              mebibytes(budget));
+        if (!options.empty()) {
+            print("Use a smaller map, or leave out some of:", options);
+        }
+        return false;
+    }
+    return true;
+}
+
+void pcs::printMemory( int width, int height,
+                       const std::vector<LatticeBoltzmann::Allocation>& usage ) {
+
+    const double cells = (double) width * height;
+    auto printLine = [&]( const std::string& name, size_t bytes ) {
+        std::stringstream line;
+        line << "  " << std::left << std::setw(12) << name
+             << std::right << std::fixed << std::setprecision(1)
+             << std::setw(8) << bytes / cells << " B/cell"
+             << std::setw(14) << mebibytes(bytes);
+        print(line.str());
+    };
+
+    print("GPU memory of the lattice of", width, "x", height);
+    for (const LatticeBoltzmann::Allocation& allocation : usage) {
+        printLine(allocation.name, allocation.bytes);
+    }
+    printLine("total", LatticeBoltzmann::totalMemory(usage));
+}
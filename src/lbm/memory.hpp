@@ -0,0 +1,90 @@
+/**
+ * Planning the GPU memory of a run within the memory of the device.
+ *
+ * @file memory.hpp
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "lbm.hpp"
+
+namespace pcs {
+
+    /**
+     * What decides the GPU memory of a run: the storage of the lattice, the
+     * snapshot buffers of the `OutputThread`, of which there are `queue`
+     * per saved output (the fields, and the statistics and derived fields
+     * if they are saved), and the pixel buffers of the `Capture` and the
+     * `Stream`.
+     */
+    struct StoragePlan {
+        LatticeBoltzmann::Storage lattice;
+        size_t queue = 2;
+        bool saveDerived = false; // If the derived fields are saved, not
+                                  // only shown.
+        int captureWidth = 0, captureHeight = 0; // 0 without a capture.
+        int streamWidth = 0, streamHeight = 0;   // 0 without a stream.
+
+        // The amount of snapshot buffers.
+        inline size_t snapshots() const {
+            return queue * (1 + lattice.statistics +
+                            (lattice.derived && saveDerived));
+        }
+    };
+
+    /**
+     * Get the GPU memory of a run, per allocation, see
+     * `LatticeBoltzmann::memoryUsage()`.
+     *
+     * @param width The width of the lattice
+     * @param height The height of the lattice
+     * @param plan The storage of the run
+     * @return The allocations
+     */
+    std::vector<LatticeBoltzmann::Allocation> memoryUsage(
+        int width, int height, const StoragePlan& plan );
+
+    /**
+     * Get the GPU memory which is available on the device, as reported by
+     * the `GL_NVX_gpu_memory_info` or `GL_ATI_meminfo` extensions.
+     *
+     * @return The available memory in bytes, or 0 if it is unknown.
+     */
+    size_t deviceMemory();
+
+    /**
+     * Fit the storage of a run in a memory budget. If it does not fit, a
+     * single snapshot buffer per output is used (so saving waits, or drops
+     * the output, while one is written), which is printed. What was asked
+     * for, like the suspended sediment, statistics, derived fields and
+     * refinement, is never left out, as the run would then depend on the
+     * free memory of the device.
+     *
+     * The run is refused, with a message, if it does not fit with a single
+     * snapshot buffer, or exceeds the maximum texture size.
+     *
+     * @param width The width of the lattice
+     * @param height The height of the lattice
+     * @param budget The budget in bytes, or 0 for no budget
+     * @param plan The storage of the run, of which the queue is reduced
+     * @return False if the run does not fit.
+     */
+    bool fitMemory( int width, int height, size_t budget, StoragePlan& plan );
+
+    /**
+     * Print the memory of a run: the bytes per cell and the total of every
+     * allocation, and the total.
+     *
+     * @param width The width of the lattice
+     * @param height The height of the lattice
+     * @param usage The allocations
+     */
+    void printMemory( int width, int height,
+                      const std::vector<LatticeBoltzmann::Allocation>& usage );
+}
@@ -0,0 +1,312 @@
+/**
+ * Measuring the shape of the river. See morphology.hpp for details.
+ *
+ * @file morphology.cpp
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#include "morphology.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <queue>
+
+#include "../print.hpp"
+
+using namespace pcs;
+
+
+static constexpr float infinity = 1e9f;
+static constexpr float diagonal = 1.41421356f;
+
+
+Morphology::Morphology( int width_, int height_, const std::string& output ) {
+
+    width = width_;
+    height = height_;
+    maxDistance = 0.f;
+    evaluated = false;
+    metrics = {0.0, 0.0, 0.0, 0.0, 0.0, 0, 0};
+
+    walls.assign((size_t) width * height, false);
+    distance.assign((size_t) width * height, infinity);
+
+    log.open(output);
+    if (!log) {
+        print(INFO_, "Failed to open", output, "for the morphology!");
+    }
+    log << "frame,length,sinuosity,mean_width,width_variance,wavelength,"
+           "bends,changed_cells,seconds\n";
+}
+
+void Morphology::close() {
+    log.close();
+}
+
+const Morphology::Metrics& Morphology::evaluate( LatticeBoltzmann& lbm ) {
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<bool> current;
+    lbm.readWalls(0, 0, width, height, current);
+    measure(current);
+
+    const double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    log << lbm.getFrame() << "," << metrics.length << ","
+        << metrics.sinuosity << "," << metrics.meanWidth << ","
+        << metrics.widthVariance << "," << metrics.wavelength << ","
+        << metrics.bends << "," << metrics.changedCells << ","
+        << seconds << "\n" << std::flush;
+
+    return metrics;
+}
+
+const Morphology::Metrics& Morphology::measure(
+        const std::vector<bool>& current ) {
+
+    // Find the wall cells which changed since the last evaluation.
+    int x0 = width, y0 = height, x1 = 0, y1 = 0;
+    size_t changed = 0;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            const size_t i = (size_t) y * width + x;
+            if (current[i] != walls[i] || !evaluated) {
+                x0 = std::min(x0, x);
+                y0 = std::min(y0, y);
+                x1 = std::max(x1, x + 1);
+                y1 = std::max(y1, y + 1);
+                changed++;
+            }
+        }
+    }
+
+    metrics.changedCells = changed;
+    if (changed == 0) {
+        return metrics;
+    }
+
+    // Only the distances within the largest distance of a changed cell can
+    // change, as all others are closer to another wall.
+    walls = current;
+    const int margin = evaluated ? (int) std::ceil(maxDistance) + 2 : 0;
+    updateDistance(x0 - margin, y0 - margin, x1 + margin, y1 + margin);
+    evaluated = true;
+
+    maxDistance = 0.f;
+    for (size_t i = 0; i < distance.size(); ++i) {
+        if (distance[i] < infinity) {
+            maxDistance = std::max(maxDistance, distance[i]);
+        }
+    }
+
+    // Without any walls there is no channel.
+    if (maxDistance > 0.f && traceCenterline()) {
+        computeMetrics();
+    }
+    else {
+        path.clear();
+        centerline.clear();
+        metrics = {0.0, 0.0, 0.0, 0.0, 0.0, 0, changed};
+    }
+    return metrics;
+}
+
+void Morphology::updateDistance( int x0, int y0, int x1, int y1 ) {
+
+    x0 = std::max(0, x0);
+    y0 = std::max(0, y0);
+    x1 = std::min(width, x1);
+    y1 = std::min(height, y1);
+
+    for (int y = y0; y < y1; ++y) {
+        for (int x = x0; x < x1; ++x) {
+            const size_t i = (size_t) y * width + x;
+            distance[i] = walls[i] ? 0.f : infinity;
+        }
+    }
+
+    // Relax a cell with one of its neighbours, which may be outside the
+    // rectangle, but not outside the lattice.
+    auto relax = [&]( int x, int y, int dx, int dy, float step ) {
+        const int nx = x + dx, ny = y + dy;
+        if (nx < 0 || nx >= width || ny < 0 || ny >= height) return;
+        float& d = distance[(size_t) y * width + x];
+        d = std::min(d, distance[(size_t) ny * width + nx] + step);
+    };
+
+    // The two passes of the chamfer transform.
+    for (int y = y0; y < y1; ++y) {
+        for (int x = x0; x < x1; ++x) {
+            relax(x, y, -1,  0, 1.f);
+            relax(x, y,  0, -1, 1.f);
+            relax(x, y, -1, -1, diagonal);
+            relax(x, y,  1, -1, diagonal);
+        }
+    }
+    for (int y = y1 - 1; y >= y0; --y) {
+        for (int x = x1 - 1; x >= x0; --x) {
+            relax(x, y,  1,  0, 1.f);
+            relax(x, y,  0,  1, 1.f);
+            relax(x, y,  1,  1, diagonal);
+            relax(x, y, -1,  1, diagonal);
+        }
+    }
+}
+
+bool Morphology::traceCenterline() {
+
+    // Dijkstra's algorithm from all fluid cells on the left side, to the
+    // first fluid cell reached on the right side. A step costs its length
+    // divided by the squared distance to the nearest wall, which keeps the
+    // path in the middle of the channel.
+    const size_t cells = (size_t) width * height;
+    std::vector<double> cost(cells, INFINITY);
+    std::vector<size_t> previous(cells, cells);
+
+    typedef std::pair<double, size_t> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+    for (int y = 0; y < height; ++y) {
+        const size_t i = (size_t) y * width;
+        if (!walls[i]) {
+            cost[i] = 0.0;
+            queue.push({0.0, i});
+        }
+    }
+
+    size_t end = cells;
+    while (!queue.empty()) {
+        const Entry entry = queue.top();
+        queue.pop();
+        const size_t i = entry.second;
+        if (entry.first > cost[i]) continue;
+
+        const int x = i % width, y = i / width;
+        if (x == width - 1) {
+            end = i;
+            break;
+        }
+
+        for (int dy = -1; dy <= 1; ++dy) {
+            for (int dx = -1; dx <= 1; ++dx) {
+                const int nx = x + dx, ny = y + dy;
+                if ((dx == 0 && dy == 0) || nx < 0 || nx >= width ||
+                    ny < 0 || ny >= height) continue;
+
+                const size_t j = (size_t) ny * width + nx;
+                if (walls[j]) continue;
+
+                const double d = distance[j];
+                const double next = cost[i] +
+                    (dx != 0 && dy != 0 ? diagonal : 1.0) / (d * d);
+                if (next < cost[j]) {
+                    cost[j] = next;
+                    previous[j] = i;
+                    queue.push({next, j});
+                }
+            }
+        }
+    }
+
+    path.clear();
+    if (end == cells) {
+        return false;
+    }
+    for (size_t i = end; i != cells; i = previous[i]) {
+        path.push_back(i);
+    }
+    std::reverse(path.begin(), path.end());
+    return true;
+}
+
+void Morphology::computeMetrics() {
+
+    const size_t n = path.size();
+
+    // The width along the centerline.
+    double sum = 0.0, sumSquares = 0.0;
+    for (size_t i : path) {
+        const double w = 2.0 * distance[i] - 1.0;
+        sum += w;
+        sumSquares += w * w;
+    }
+    metrics.meanWidth = sum / n;
+    metrics.widthVariance = std::max(
+        0.0, sumSquares / n - metrics.meanWidth * metrics.meanWidth);
+
+    // Smooth the centerline over about the width of the channel, as the
+    // path of cells zigzags on smaller scales.
+    const int s = std::max(2, (int) std::lround(metrics.meanWidth / 2.0));
+    centerline.assign(2 * n, 0.0);
+    for (size_t i = 0; i < n; ++i) {
+        const size_t first = i < (size_t) s ? 0 : i - s;
+        const size_t last = std::min(n - 1, i + s);
+        for (size_t j = first; j <= last; ++j) {
+            centerline[2 * i] += path[j] % width;
+            centerline[2 * i + 1] += path[j] / width;
+        }
+        centerline[2 * i] /= last - first + 1;
+        centerline[2 * i + 1] /= last - first + 1;
+    }
+
+    // The length and sinuosity.
+    metrics.length = 0.0;
+    for (size_t i = 1; i < n; ++i) {
+        metrics.length += std::hypot(centerline[2 * i] - centerline[2 * i - 2],
+                                     centerline[2 * i + 1] -
+                                     centerline[2 * i - 1]);
+    }
+    const double span = std::hypot(centerline[2 * n - 2] - centerline[0],
+                                   centerline[2 * n - 1] - centerline[1]);
+    metrics.sinuosity = span > 0.0 ? metrics.length / span : 0.0;
+
+    // The heading along the centerline, without jumps of 2 pi.
+    std::vector<double> heading;
+    for (size_t i = 0; i + s < n; i += s) {
+        double angle = std::atan2(centerline[2 * (i + s) + 1] -
+                                  centerline[2 * i + 1],
+                                  centerline[2 * (i + s)] - centerline[2 * i]);
+        if (!heading.empty()) {
+            angle += 2 * M_PI * std::round((heading.back() - angle) /
+                                           (2 * M_PI));
+        }
+        heading.push_back(angle);
+    }
+
+    // The inflection points are the extremes of the heading. Only turns of
+    // more than `minTurn` count, so small wiggles are ignored.
+    std::vector<double> inflections;
+    int direction = 0;
+    size_t candidate = 0;
+    for (size_t i = 1; i < heading.size(); ++i) {
+        const double turn = heading[i] - heading[candidate];
+        if (direction == 0) {
+            if (std::abs(heading[i] - heading[0]) > minTurn) {
+                direction = heading[i] > heading[0] ? 1 : -1;
+                candidate = i;
+            }
+        }
+        else if (turn * direction > 0) {
+            candidate = i;
+        }
+        else if (-turn * direction > minTurn) {
+            inflections.push_back(centerline[2 * candidate * s]);
+            direction = -direction;
+            candidate = i;
+        }
+    }
+
+    metrics.bends = direction == 0 ? 0 : inflections.size() + 1;
+    metrics.wavelength = 0.0;
+    if (inflections.size() >= 2) {
+        metrics.wavelength = 2.0 * std::abs(inflections.back() -
+                                            inflections.front()) /
+                             (inflections.size() - 1);
+    }
+}
@@ -0,0 +1,139 @@
+/**
+ * Measuring the shape of the river over time.
+ *
+ * @file morphology.hpp
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "lbm.hpp"
+
+namespace pcs {
+
+    /**
+     * The Morphology class measures the channel of the river from the wall
+     * mask of the lattice, and logs the measurements as a time series.
+     *
+     * The channel is the fluid (the cells which are not walls). Its
+     * distance to the nearest wall is kept with a chamfer distance
+     * transform, and the centerline is the cheapest path through the fluid
+     * from the left to the right side of the lattice, where stepping
+     * through a cell costs more the closer it is to a wall. Along the
+     * smoothed centerline the following are measured:
+     *  - The length of the centerline, and the sinuosity: its length
+     *    divided by the distance between its ends.
+     *  - The mean and variance of the channel width, twice the distance to
+     *    the nearest wall minus one.
+     *  - The bends, found as the turns of the heading of the centerline of
+     *    more than `minTurn` radians, and the wavelength: twice the mean
+     *    distance along the x axis between the inflection points.
+     *
+     * Evaluations are incremental: only the wall cells which changed since
+     * the last evaluation are processed for the distance transform, and if
+     * none changed, the last measurements are reused.
+     */
+    class Morphology {
+
+    public:
+
+        /**
+         * The measurements of a single evaluation.
+         */
+        struct Metrics {
+            double length;       // The length of the centerline.
+            double sinuosity;
+            double meanWidth, widthVariance;
+            double wavelength;   // Zero if there are less than two bends.
+            size_t bends;
+            size_t changedCells; // Wall cells changed since the last one.
+        };
+
+        // The minimum turn of a bend, in radians.
+        static constexpr double minTurn = 0.25;
+
+        /**
+         * Create the measurement for a lattice, and open the log file.
+         *
+         * @param width The width of the lattice
+         * @param height The height of the lattice
+         * @param output The path of the CSV file to log to
+         */
+        Morphology( int width, int height, const std::string& output );
+
+        /**
+         * Close the log file.
+         */
+        void close();
+
+        /**
+         * Read the walls of the model, measure the channel and log the
+         * measurements.
+         *
+         * @param lbm The model, of the size given at construction
+         * @return The measurements
+         */
+        const Metrics& evaluate( LatticeBoltzmann& lbm );
+
+        /**
+         * Measure the channel of a wall mask, without logging.
+         *
+         * @param walls If every cell is a wall, bottom row first
+         * @return The measurements
+         */
+        const Metrics& measure( const std::vector<bool>& walls );
+
+        // Getters.
+        inline const Metrics& getMetrics() const { return metrics; }
+        inline const std::vector<double>& getCenterline() const {
+            return centerline;
+        }
+
+    private:
+
+        /**
+         * Recompute the distance transform within a rectangle, using the
+         * distances around it. The rectangle is clamped to the lattice.
+         *
+         * @param x0 The left side
+         * @param y0 The bottom side
+         * @param x1 The right side (exclusive)
+         * @param y1 The top side (exclusive)
+         */
+        void updateDistance( int x0, int y0, int x1, int y1 );
+
+        /**
+         * Find the centerline through the distance transform, and store
+         * it in `path` (cell indices from left to right).
+         *
+         * @return False if the channel does not connect both sides.
+         */
+        bool traceCenterline();
+
+        /**
+         * Compute the metrics from the traced centerline.
+         */
+        void computeMetrics();
+
+        int width, height;
+        std::ofstream log;
+
+        // The walls and distances of the last evaluation, and the largest
+        // distance.
+        std::vector<bool> walls;
+        std::vector<float> distance;
+        float maxDistance;
+        bool evaluated;
+
+        std::vector<size_t> path;
+        std::vector<double> centerline; // Smoothed x and y positions.
+        Metrics metrics;
+    };
+}
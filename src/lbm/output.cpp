@@ -0,0 +1,272 @@
+/**
+ * Writing simulation data on a background thread.
+ * See output.hpp for details.
+ *
+ * @file output.cpp
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#include "output.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include <sys/stat.h>
+
+#include "../print.hpp"
+#include "../opengl/profiler.hpp"
+
+using namespace pcs;
+
+
+// Write an array of doubles as a NumPy .npy file (format version 1.0).
+static bool writeNpy( const std::string& path, const std::vector<double>& data,
+                      const std::vector<size_t>& shape ) {
+
+    std::stringstream header;
+    header << "{'descr': '<f8', 'fortran_order': False, 'shape': (";
+    for (size_t dim : shape) header << dim << ", ";
+    header << "), }";
+
+    // The header is padded with spaces and ends with a newline, such that
+    // the data is aligned to 64 bytes.
+    std::string str = header.str();
+    const size_t length = 10 + str.size() + 1;
+    str += std::string((64 - length % 64) % 64, ' ') + "\n";
+
+    std::ofstream file(path, std::ios::binary);
+    const uint16_t headerLength = str.size();
+    file.write("\x93NUMPY\x01\x00", 8);
+    file.write((const char*) &headerLength, 2);
+    file << str;
+    file.write((const char*) data.data(), data.size() * sizeof (double));
+    return (bool) file;
+}
+
+
+OutputThread::OutputThread( Window& window_, int width_, int height_,
+                            const std::string& directory_, size_t capacity,
+                            OutputPolicy policy_ ) {
+
+    window = window_;
+    width = width_;
+    height = height_;
+    directory = directory_;
+    policy = policy_;
+    quit = false;
+    written = dropped = 0;
+
+    mkdir(directory.c_str(), 0755);
+
+    // Create the snapshot buffers.
+    snapshots.resize(std::max<size_t>(1, capacity));
+    for (size_t i = 0; i < snapshots.size(); ++i) {
+        for (GLuint& texture : snapshots[i].textures) {
+            texture = gl::genUTexture(width, height);
+        }
+        snapshots[i].fence = nullptr;
+        free.push_back(i);
+    }
+
+    // Creating the shared context makes it current, so restore the context
+    // of the simulation afterwards.
+    SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+    context = SDL_GL_CreateContext(window.sdlData);
+    SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0);
+    SDL_GL_MakeCurrent(window.sdlData, window.glContext);
+
+    if (context == nullptr) {
+        print(INFO_, "The output context could not be created! SDL Error:",
+              SDL_GetError());
+        return;
+    }
+
+    thread = std::thread(&OutputThread::run, this);
+}
+
+void OutputThread::close() {
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    changed.notify_all();
+
+    if (thread.joinable()) {
+        thread.join();
+    }
+    if (context != nullptr) {
+        SDL_GL_DeleteContext(context);
+    }
+
+    for (Snapshot& snapshot : snapshots) {
+        glDeleteTextures(4, snapshot.textures);
+    }
+
+    print("Wrote", written, "outputs to", directory + ", dropped", dropped);
+}
+
+bool OutputThread::queueFields( LatticeBoltzmann& lbm ) {
+    return queue(lbm, Kind::Fields);
+}
+
+bool OutputThread::queueStatistics( LatticeBoltzmann& lbm ) {
+    return lbm.hasStatistics() && queue(lbm, Kind::Statistics);
+}
+
+bool OutputThread::queueDerived( LatticeBoltzmann& lbm ) {
+    return lbm.hasDerived() && queue(lbm, Kind::Derived);
+}
+
+bool OutputThread::queue( LatticeBoltzmann& lbm, Kind kind ) {
+
+    // Wait for a free snapshot, or drop the output.
+    std::unique_lock<std::mutex> lock(mutex);
+    if (context == nullptr) {
+        return false;
+    }
+    if (free.empty() && policy == OutputPolicy::Drop) {
+        dropped++;
+        return false;
+    }
+    changed.wait(lock, [&]() { return !free.empty(); });
+
+    const size_t index = free.front();
+    free.pop_front();
+    lock.unlock();
+
+    // Copy the textures on the GPU, and fence the copy for the output
+    // thread.
+    Snapshot& snapshot = snapshots[index];
+    snapshot.kind = kind;
+    for (size_t i = 0; i < (kind == Kind::Statistics ? 4 : 3); ++i) {
+        GLuint texture = lbm.getTexture(i);
+        if (kind == Kind::Statistics) {
+            texture = lbm.getStatisticsTexture(i);
+        }
+        else if (kind == Kind::Derived) {
+            texture = lbm.getDerivedTexture(i);
+        }
+        glCopyImageSubData(texture, GL_TEXTURE_2D, 0, 0, 0, 0,
+                           snapshot.textures[i], GL_TEXTURE_2D, 0, 0, 0, 0,
+                           width, height, 1);
+    }
+    snapshot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    snapshot.frame = kind == Kind::Derived ? lbm.getDerivedFrame()
+                                           : lbm.getFrame();
+    glFlush();
+
+    lock.lock();
+    queued.push_back(index);
+    lock.unlock();
+    changed.notify_all();
+    return true;
+}
+
+void OutputThread::run() {
+
+    SDL_GL_MakeCurrent(window.sdlData, context);
+
+    while (true) {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&]() { return quit || !queued.empty(); });
+
+        // Only stop once everything has been written.
+        if (queued.empty()) {
+            break;
+        }
+
+        const size_t index = queued.front();
+        queued.pop_front();
+        lock.unlock();
+
+        Snapshot& snapshot = snapshots[index];
+        glWaitSync(snapshot.fence, 0, GL_TIMEOUT_IGNORED);
+        glDeleteSync(snapshot.fence);
+        snapshot.fence = nullptr;
+
+        if (write(snapshot)) {
+            written++;
+        }
+
+        lock.lock();
+        free.push_back(index);
+        lock.unlock();
+        changed.notify_all();
+    }
+
+    gl::checkErrors("output thread");
+    SDL_GL_MakeCurrent(window.sdlData, nullptr);
+}
+
+bool OutputThread::write( const Snapshot& snapshot ) {
+
+    PROFILE_SCOPE("write fields");
+
+    // Read back the textures.
+    const size_t count = snapshot.kind == Kind::Statistics ? 4 : 3;
+    std::vector<GLuint> textures[4];
+    for (size_t i = 0; i < count; ++i) {
+        textures[i].resize((size_t) width * height * 4);
+        glBindTexture(GL_TEXTURE_2D, snapshot.textures[i]);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA_INTEGER, GL_UNSIGNED_INT,
+                      textures[i].data());
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Convert to (u_x, u_y, rho, wall) per cell, or to the statistics or
+    // derived fields, top row first.
+    size_t values = 4;
+    if (snapshot.kind == Kind::Statistics) {
+        values = LatticeBoltzmann::statsValues;
+    }
+    else if (snapshot.kind == Kind::Derived) {
+        values = 6;
+    }
+    std::vector<double> fields((size_t) width * height * values);
+    double* ptr = fields.data();
+    for (int row = 0; row < height; ++row) {
+        const size_t y = height - 1 - row;
+        for (int x = 0; x < width; ++x) {
+            const size_t i = (y * width + x) * 4;
+            if (snapshot.kind == Kind::Statistics) {
+                double raw[LatticeBoltzmann::statsValues];
+                for (size_t j = 0; j < 4; ++j) {
+                    std::memcpy(&raw[2 * j], &textures[j][i],
+                                2 * sizeof (double));
+                }
+                LatticeBoltzmann::convertStatistics(raw, ptr);
+            }
+            else if (snapshot.kind == Kind::Derived) {
+                for (size_t j = 0; j < 3; ++j) {
+                    std::memcpy(ptr + 2 * j, &textures[j][i],
+                                2 * sizeof (double));
+                }
+            }
+            else {
+                std::memcpy(ptr, &textures[1][i], 2 * sizeof (double));
+                std::memcpy(ptr + 2, &textures[2][i], sizeof (double));
+                ptr[3] = textures[0][i + 3] != 0 ? 1.0 : 0.0;
+            }
+            ptr += values;
+        }
+    }
+
+    std::stringstream path;
+    const char* names[] = {"/fields_", "/stats_", "/derived_"};
+    path << directory << names[(int) snapshot.kind]
+         << std::setw(8) << std::setfill('0') << snapshot.frame << ".npy";
+
+    if (!writeNpy(path.str(), fields,
+                  {(size_t) height, (size_t) width, values})) {
+        print(INFO_, "Failed to write", path.str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,165 @@
+/**
+ * Writing simulation data to disk on a background thread.
+ *
+ * @file output.hpp
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lbm.hpp"
+#include "../sdl/window.hpp"
+
+namespace pcs {
+
+    /**
+     * What to do with a new output while all snapshot buffers are in use:
+     * wait until one is written (Block), or skip the output (Drop).
+     */
+    enum class OutputPolicy { Block, Drop };
+
+    /**
+     * The OutputThread writes fields of the simulation to disk on its own
+     * thread, which has its own OpenGL context shared with the simulation.
+     *
+     * To save the fields, the simulation thread only queues a copy on the
+     * GPU (with `glCopyImageSubData`) into a free snapshot buffer, followed
+     * by a fence, and carries on. The output thread waits for the fence,
+     * reads the snapshot back, converts it and writes it, after which the
+     * snapshot buffer is free again. The amount of snapshot buffers bounds
+     * the queue, and the policy decides what happens when it is full.
+     *
+     * The fields are written as NumPy `.npy` files, named after the frame,
+     * containing an array of doubles with shape (height, width, 4): the x
+     * and y velocity, the density and 1 for walls (0 otherwise). The first
+     * row is the top of the map, as it is shown on screen.
+     *
+     * The time averaged statistics are written in the same way, with shape
+     * (height, width, 8), containing the values described at
+     * `LatticeBoltzmann::convertStatistics()`. So are the derived fields,
+     * with shape (height, width, 6): the vorticity, the strain rate, the
+     * xx, xy and yy viscous stress and the shear on walls.
+     */
+    class OutputThread {
+
+        // What a snapshot contains.
+        enum class Kind { Fields, Statistics, Derived };
+
+        // A copy of textures 0 to 2 of the lattice, of the statistics
+        // textures or of the derived fields, see `LatticeBoltzmann`.
+        struct Snapshot {
+            GLuint textures[4];
+            Kind kind;
+            GLsync fence;
+            unsigned frame;
+        };
+
+    public:
+
+        /**
+         * Create the snapshot buffers and the shared context, and start the
+         * thread. Must be called with the context of `window` current.
+         *
+         * @param window The window of the simulation context
+         * @param width The width of the lattice
+         * @param height The height of the lattice
+         * @param directory The directory to write the files to
+         * @param capacity The amount of snapshot buffers
+         * @param policy The policy for when the queue is full
+         */
+        OutputThread( Window& window, int width, int height,
+                      const std::string& directory, size_t capacity = 2,
+                      OutputPolicy policy = OutputPolicy::Drop );
+
+        /**
+         * Write the remaining queued outputs, stop the thread and delete the
+         * snapshot buffers and shared context.
+         */
+        void close();
+
+        /**
+         * Queue the current fields of the model to be written.
+         *
+         * @param lbm The model, of the size given at construction
+         * @return False if the output was dropped, true otherwise.
+         */
+        bool queueFields( LatticeBoltzmann& lbm );
+
+        /**
+         * Queue the current statistics of the model to be written, if it
+         * accumulates them.
+         *
+         * @param lbm The model, of the size given at construction
+         * @return False if the output was dropped, true otherwise.
+         */
+        bool queueStatistics( LatticeBoltzmann& lbm );
+
+        /**
+         * Queue the derived fields of the model to be written, if they have
+         * been computed (see `LatticeBoltzmann::updateDerived()`).
+         *
+         * @param lbm The model, of the size given at construction
+         * @return False if the output was dropped, true otherwise.
+         */
+        bool queueDerived( LatticeBoltzmann& lbm );
+
+        // The GPU memory of a snapshot buffer, of four RGBA32UI textures.
+        static inline size_t snapshotMemory( int width, int height ) {
+            return 4 * (size_t) width * height * 16;
+        }
+
+        // Statistics getters.
+        inline size_t getWritten() const { return written; }
+        inline size_t getDropped() const { return dropped; }
+
+    private:
+
+        /**
+         * The loop of the output thread.
+         */
+        void run();
+
+        /**
+         * Read back a snapshot and write it to disk. Called on the output
+         * thread.
+         *
+         * @param snapshot The snapshot to write
+         * @return True on success, false otherwise.
+         */
+        bool write( const Snapshot& snapshot );
+
+        /**
+         * Queue a copy of textures of the model.
+         *
+         * @param lbm The model
+         * @param kind Which textures should be copied
+         * @return False if the output was dropped, true otherwise.
+         */
+        bool queue( LatticeBoltzmann& lbm, Kind kind );
+
+        Window window;
+        void* context; // The shared OpenGL context of the thread.
+        int width, height;
+        std::string directory;
+        OutputPolicy policy;
+
+        std::vector<Snapshot> snapshots;
+        std::deque<size_t> free, queued; // Indices in `snapshots`.
+        bool quit;
+        size_t written, dropped;
+
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable changed;
+    };
+}
@@ -0,0 +1,36 @@
+/**
+ * Reduces a level of the display pyramid to the next (smaller) level.
+ *
+ * @file reduce.frag
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#version 430
+
+precision highp float;
+
+layout(location = 0) out vec4 o_color;
+
+// The display texture, with its base level set to the level to reduce.
+layout(location = 3) uniform sampler2D u_texture;
+
+
+void main() {
+
+    // Average the 2x2 texels covered by this texel. For odd sizes the
+    // last row or column is clamped.
+    ivec2 loc = ivec2(gl_FragCoord.xy) * 2;
+    ivec2 last = textureSize(u_texture, 0) - 1;
+
+    vec4 sum = vec4(0.0);
+    for (int j = 0; j < 2; ++j) {
+        for (int i = 0; i < 2; ++i) {
+            sum += texelFetch(u_texture, min(loc + ivec2(i, j), last), 0);
+        }
+    }
+
+    o_color = sum / 4.0;
+}
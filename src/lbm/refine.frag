@@ -0,0 +1,263 @@
+/**
+ * The coupling of a refinement patch (see `LatticeBoltzmann::setRefinement()`)
+ * with the lattice. A patch has `u_factor` times the resolution of the
+ * lattice, and covers a square of it and a ring of a cell around it. Both
+ * have the same lattice speed, so the patch takes `u_factor` frames per
+ * frame of the lattice, at `u_factor` times the viscosity in lattice units.
+ *
+ * The ring is rendered into the patch before every frame of the patch,
+ * interpolated from the lattice in space, and in time between the last two
+ * frames of the lattice. After the frames of the patch the cells of the
+ * lattice inside the ring are rendered from the average of the cells of the
+ * patch on them. The non equilibrium part of the f_i values is rescaled for
+ * the relaxation times of both (Dupuis & Chopard, "Theory and applications
+ * of an alternative lattice Boltzmann grid refinement algorithm", 2003).
+ * The suspended sediment is taken from the cell of the lattice, and
+ * averaged back, without interpolation.
+ *
+ * @file refine.frag
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#version 430
+
+precision highp float;
+precision highp usampler2D;
+
+in vec2 v_tex_coords;
+
+layout(location = 0) out uvec4 o_color[8];
+
+// The textures of the lattice, or of the patch when restricting.
+layout(location = 3) uniform usampler2D u_textures[7];
+layout(location = 10) uniform usampler2D u_previous[7]; // The last frame.
+layout(location = 17) uniform uint u_mode;      // See the modes below.
+layout(location = 18) uniform int u_factor;     // The refinement factor.
+layout(location = 19) uniform ivec2 u_offset;   // The cell of the lattice
+                                                // at the corner of the patch.
+layout(location = 20) uniform ivec2 u_cells;    // The size of the patch, in
+                                                // cells of the lattice.
+layout(location = 21) uniform double u_alpha;   // The time between the last
+                                                // two frames, from 0 to 1.
+layout(location = 22) uniform double u_viscosity; // Of the lattice.
+layout(location = 23) uniform usampler2D u_sediment[2]; // The suspended
+                                                        // sediment, of the
+                                                        // current and the
+                                                        // last frame.
+
+
+// Render the ring of the patch, the whole patch, or the lattice inside the
+// ring, see `LatticeBoltzmann::Coupling`.
+const uint MODE_RING = 0u;
+const uint MODE_FULL = 1u;
+const uint MODE_RESTRICT = 2u;
+
+// f_i directions and weights, as in `lbm.frag`.
+const dvec2 e[9] = dvec2[9](dvec2(0., 0.),  dvec2(1., 0.),   dvec2(0., 1.),
+                            dvec2(-1., 0.), dvec2(0., -1.),  dvec2(1., 1.),
+                            dvec2(-1., 1.), dvec2(-1., -1.), dvec2(1., -1.));
+
+const double w[9] = double[9](4. /  9., 1. /  9., 1. /  9.,
+                              1. /  9., 1. /  9., 1. / 36.,
+                              1. / 36., 1. / 36., 1. / 36.);
+
+
+double calc_feq( in uint i, in double rho, in dvec2 u ) {
+    double edotu = 3.0 * dot(e[i], u);
+    return w[i] * rho * (1 + edotu + edotu * edotu / 2.0 - 1.5 * dot(u, u));
+}
+
+// The density and velocity of f_i values, where walls store them negated.
+void moments( in double f[9], out double rho, out dvec2 u ) {
+    rho = 0.0;
+    u = dvec2(0.0);
+    for (uint i = 0; i < 9; i++) {
+        rho += abs(f[i]);
+        u += e[i] * abs(f[i]);
+    }
+    u /= max(rho, 1e-12);
+}
+
+// Scale the non equilibrium part of the f_i values of a fluid cell.
+void rescale( inout double f[9], in double scale ) {
+    double rho;
+    dvec2 u;
+    moments(f, rho, u);
+    for (uint i = 0; i < 9; i++) {
+        double feq = calc_feq(i, rho, u);
+        f[i] = max(0.0, feq + scale * (f[i] - feq));
+    }
+}
+
+// Read the f_i values of a cell, of the current or the last frame.
+void read_f( in bool previous, in ivec2 loc, out double f[9] ) {
+    uvec4 values[5];
+    for (int i = 0; i < 5; ++i) {
+        values[i] = previous ? texelFetch(u_previous[2 + i], loc, 0)
+                             : texelFetch(u_textures[2 + i], loc, 0);
+    }
+    f[0] = packDouble2x32(values[0].ba);
+    for (int i = 0; i < 4; ++i) {
+        f[2 * i + 1] = packDouble2x32(values[i + 1].rg);
+        f[2 * i + 2] = packDouble2x32(values[i + 1].ba);
+    }
+}
+
+// The f_i values of a cell of the lattice at `u_alpha`, with periodic
+// boundaries. The cell is at least -2, so the remainder is not negative.
+// The values of walls are negated, also if it became one in the last frame.
+void lattice_f( in ivec2 cell, out double f[9] ) {
+    ivec2 size = textureSize(u_textures[0], 0);
+    cell = (cell + 2 * size) % size;
+    double f_prev[9];
+    read_f(false, cell, f);
+    read_f(true, cell, f_prev);
+    double sign = texelFetch(u_textures[0], cell, 0).a != 0 ? -1.0 : 1.0;
+    for (uint i = 0; i < 9; i++) {
+        f[i] = sign * mix(abs(f_prev[i]), abs(f[i]), u_alpha);
+    }
+}
+
+// The suspended sediment of a cell of the lattice at `u_alpha`, see
+// `LatticeBoltzmann::setSuspendedSediment()`.
+dvec2 lattice_sediment( in ivec2 cell ) {
+    ivec2 size = textureSize(u_textures[0], 0);
+    uvec4 current = texelFetch(u_sediment[0], (cell + 2 * size) % size, 0);
+    uvec4 previous = texelFetch(u_sediment[1], (cell + 2 * size) % size, 0);
+    return mix(dvec2(packDouble2x32(previous.rg), packDouble2x32(previous.ba)),
+               dvec2(packDouble2x32(current.rg), packDouble2x32(current.ba)),
+               u_alpha);
+}
+
+bool lattice_wall( in ivec2 cell ) {
+    ivec2 size = textureSize(u_textures[0], 0);
+    return texelFetch(u_textures[0], (cell + 2 * size) % size, 0).a != 0;
+}
+
+
+void main() {
+
+    ivec2 loc = ivec2(gl_FragCoord.xy);
+
+    // The relaxation times of the lattice and the patch, and the ratio of
+    // the non equilibrium parts of their f_i values. The stored f_i values
+    // are after the collision, which scales it by 1 - 1 / tau.
+    double tau = 3.0 * u_viscosity + 0.5;
+    double tau_fine = u_factor * (tau - 0.5) + 0.5;
+    double ratio = (tau_fine - 1.0) / (u_factor * (tau - 1.0));
+
+    uvec4 flags = uvec4(0);
+    double f[9];
+    dvec2 sediment = dvec2(0.0);
+
+    if (u_mode != MODE_RESTRICT) {
+
+        // The cells inside the ring keep their own values.
+        ivec2 cell = loc / u_factor;
+        if (u_mode == MODE_RING && all(greaterThan(cell, ivec2(0))) &&
+            all(lessThan(cell, u_cells - 1))) {
+            discard;
+        }
+
+        ivec2 size = textureSize(u_textures[0], 0);
+        flags = texelFetch(u_textures[0], (u_offset + cell + 2 * size) % size,
+                           0);
+
+        // Walls take the values of their cell, fluid is interpolated from
+        // the fluid cells around it.
+        lattice_f(u_offset + cell, f);
+        sediment = lattice_sediment(u_offset + cell);
+        if (flags.a == 0) {
+            dvec2 pos = (dvec2(loc) + 0.5) / u_factor - 0.5;
+            ivec2 base = ivec2(floor(pos));
+            dvec2 t = pos - dvec2(base);
+
+            double sum[9] = double[9](0., 0., 0., 0., 0., 0., 0., 0., 0.);
+            double weights = 0.0;
+            for (int dy = 0; dy < 2; ++dy) {
+                for (int dx = 0; dx < 2; ++dx) {
+                    ivec2 c = u_offset + base + ivec2(dx, dy);
+                    if (lattice_wall(c)) {
+                        continue;
+                    }
+                    double weight = (dx == 0 ? 1.0 - t.x : t.x) *
+                                    (dy == 0 ? 1.0 - t.y : t.y);
+                    double fc[9];
+                    lattice_f(c, fc);
+                    for (uint i = 0; i < 9; i++) {
+                        sum[i] += weight * fc[i];
+                    }
+                    weights += weight;
+                }
+            }
+            if (weights > 0.0) {
+                for (uint i = 0; i < 9; i++) {
+                    f[i] = sum[i] / weights;
+                }
+            }
+            rescale(f, abs(tau - 1.0) < 1e-6 ? 0.0 : ratio);
+        }
+    }
+
+    // The average of the cells of the patch on the cell. It is a wall if
+    // most of them are.
+    else {
+        ivec2 first = (loc - u_offset) * u_factor;
+        double fluid[9] = double[9](0., 0., 0., 0., 0., 0., 0., 0., 0.);
+        double walls[9] = double[9](0., 0., 0., 0., 0., 0., 0., 0., 0.);
+        int wallCount = 0;
+        for (int dy = 0; dy < u_factor; ++dy) {
+            for (int dx = 0; dx < u_factor; ++dx) {
+                ivec2 fine = first + ivec2(dx, dy);
+                uvec4 fineFlags = texelFetch(u_textures[0], fine, 0);
+                flags.r = max(flags.r, fineFlags.r);
+                flags.b = max(flags.b, fineFlags.b);
+
+                double ff[9];
+                read_f(false, fine, ff);
+                uvec4 fineSediment = texelFetch(u_sediment[0], fine, 0);
+                sediment += dvec2(packDouble2x32(fineSediment.rg),
+                                  packDouble2x32(fineSediment.ba)) /
+                            (u_factor * u_factor);
+                bool wall = fineFlags.a != 0 || fineFlags.g != 0;
+                for (uint i = 0; i < 9; i++) {
+                    walls[i] += wall ? abs(ff[i]) : 0.0;
+                    fluid[i] += wall ? 0.0 : ff[i];
+                }
+                wallCount += int(wall);
+            }
+        }
+
+        int fluidCount = u_factor * u_factor - wallCount;
+        if (2 * wallCount > u_factor * u_factor) {
+            flags.a = 1u;
+            for (uint i = 0; i < 9; i++) {
+                f[i] = -walls[i] / wallCount;
+            }
+        }
+        else {
+            for (uint i = 0; i < 9; i++) {
+                f[i] = fluid[i] / fluidCount;
+            }
+            rescale(f, abs(tau_fine - 1.0) < 1e-6 ? 0.0 : 1.0 / ratio);
+        }
+    }
+
+    double rho;
+    dvec2 u;
+    moments(f, rho, u);
+
+    // Ouput to the textures, like `lbm.frag`.
+    o_color[0] = flags;
+    o_color[1] = uvec4(unpackDouble2x32(u.x),  unpackDouble2x32(u.y));
+    o_color[2] = uvec4(unpackDouble2x32(rho),  unpackDouble2x32(f[0]));
+    o_color[3] = uvec4(unpackDouble2x32(f[1]), unpackDouble2x32(f[2]));
+    o_color[4] = uvec4(unpackDouble2x32(f[3]), unpackDouble2x32(f[4]));
+    o_color[5] = uvec4(unpackDouble2x32(f[5]), unpackDouble2x32(f[6]));
+    o_color[6] = uvec4(unpackDouble2x32(f[7]), unpackDouble2x32(f[8]));
+    o_color[7] = uvec4(unpackDouble2x32(sediment.x),
+                       unpackDouble2x32(sediment.y));
+}
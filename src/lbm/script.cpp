@@ -0,0 +1,402 @@
+/**
+ * Running experiment scripts. See script.hpp for the commands.
+ *
+ * @file script.cpp
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#include "script.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include "../print.hpp"
+
+using namespace pcs;
+
+
+static const char* settingNames[4] = {"source", "erosion", "sedimentation",
+                                      "slope"};
+static const char* viewNames[LatticeBoltzmann::viewCount] =
+    {"velocity", "vorticity", "strain", "shear"};
+
+// Get the index of a name in a list, or -1 if it is not in it.
+static int find( const char* const* names, int count,
+                 const std::string& name ) {
+    for (int i = 0; i < count; ++i) {
+        if (name == names[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Get the scancode of a key of a `press` command, or -1 if it has none.
+static int scancode( char key ) {
+    key = std::toupper(key);
+    if (key >= 'A' && key <= 'Z') return SDL_SCANCODE_A + (key - 'A');
+    if (key >= '1' && key <= '9') return SDL_SCANCODE_1 + (key - '1');
+    if (key == '0') return SDL_SCANCODE_0;
+    if (key == '-') return SDL_SCANCODE_MINUS;
+    return -1;
+}
+
+// Replace `{frame}` in a file name by the frame.
+static std::string fileName( std::string name, unsigned frame ) {
+    const size_t position = name.find("{frame}");
+    if (position != std::string::npos) {
+        name.replace(position, 7, toString(frame));
+    }
+    return name;
+}
+
+
+bool Script::load( const std::string& path_ ) {
+
+    std::ifstream file(path_);
+    if (!file) {
+        print("Could not open the script", path_);
+        return false;
+    }
+    return load(file, path_);
+}
+
+bool Script::load( std::istream& stream, const std::string& name ) {
+
+    path = name;
+    commands.clear();
+    repeats.clear();
+    next = 0;
+    waiting = false;
+
+    bool valid = true;
+    std::string text;
+    for (int line = 1; std::getline(stream, text); ++line) {
+        text = text.substr(0, text.find('#'));
+
+        Command command;
+        command.period = 0;
+        command.line = line;
+        std::istringstream words(text);
+        for (std::string word; words >> word;) {
+            command.words.push_back(word);
+        }
+        if (command.words.empty()) {
+            continue;
+        }
+
+        const std::string error = check(command.words);
+        if (!error.empty()) {
+            print(path + ":" + toString(line) + ":", error);
+            valid = false;
+        }
+        commands.push_back(command);
+    }
+
+    return valid;
+}
+
+std::string Script::check( const std::vector<std::string>& words ) {
+
+    const std::string& name = words[0];
+    const size_t size = words.size();
+    unsigned count;
+    double value;
+
+    if (name == "wait") {
+        if (size == 2 && parseNumber(words[1], count)) return "";
+        if (size == 3 && words[1] == "until" &&
+            parseNumber(words[2], count)) return "";
+        if ((size == 3 || size == 4) && words[1] == "steady" &&
+            parseNumber(words[2], value) && value >= 0.0 &&
+            (size == 3 || (parseNumber(words[3], count) && count > 0))) {
+            return "";
+        }
+        return "expected wait {frames}, wait until {frame} or "
+               "wait steady {tolerance} [{interval}]";
+    }
+    if (name == "press") {
+        if (size < 2) return "expected the keys to press";
+        for (size_t i = 1; i < size; ++i) {
+            for (char key : words[i]) {
+                if (scancode(key) < 0) {
+                    return std::string("unknown key ") + key;
+                }
+            }
+        }
+        return "";
+    }
+    if (name == "set") {
+        if (size != 3) return "expected set {name} {value}";
+        if (find(settingNames, 4, words[1]) >= 0) {
+            if (words[2] == "on" || words[2] == "off") return "";
+            return "expected on or off";
+        }
+        if (words[1] == "viscosity") {
+            if (parseNumber(words[2], value) && value > 0.0) return "";
+            return "expected a positive viscosity";
+        }
+        if (words[1] == "view") {
+            if (find(viewNames, LatticeBoltzmann::viewCount, words[2]) >= 0) {
+                return "";
+            }
+            return "expected velocity, vorticity, strain or shear";
+        }
+        return "unknown setting " + words[1];
+    }
+    if (name == "stats") {
+        if (size == 2 && parseNumber(words[1], count) && count > 0) return "";
+        return "expected stats {interval}";
+    }
+    if (name == "save" || name == "stop") {
+        if (size == 1) return "";
+        return "expected " + name + " without arguments";
+    }
+    if (name == "summary") {
+        if (size <= 2) return "";
+        return "expected summary [{file}]";
+    }
+    if (name == "probe") {
+        if ((size == 3 || size == 4) && parseNumber(words[1], count) &&
+            parseNumber(words[2], count)) return "";
+        return "expected probe {x} {y} [{file}]";
+    }
+    if (name == "profile") {
+        if ((size == 3 || size == 4) &&
+            (words[1] == "x" || words[1] == "y") &&
+            parseNumber(words[2], count)) return "";
+        return "expected profile {x|y} {position} [{file}]";
+    }
+    if (name == "checkpoint" || name == "load") {
+        if (size == 2) return "";
+        return "expected " + name + " {file}";
+    }
+    if (name == "every") {
+        if (size < 3 || !parseNumber(words[1], count) || count == 0) {
+            return "expected every {frames} {command}";
+        }
+        if (words[2] == "wait" || words[2] == "every" || words[2] == "stop") {
+            return "cannot repeat " + words[2];
+        }
+        return check(std::vector<std::string>(words.begin() + 2,
+                                              words.end()));
+    }
+    return "unknown command " + name;
+}
+
+
+void Script::run( GLRenderer& renderer, LatticeBoltzmann& lbm,
+                  InputData& input ) {
+
+    const unsigned frame = lbm.getFrame();
+    bool ran = false;
+
+    // The repeated commands.
+    for (Repeat& repeat : repeats) {
+        if (frame >= repeat.next) {
+            execute(renderer, lbm, input, repeat.command);
+            repeat.next = frame + repeat.command.period;
+            ran = true;
+        }
+    }
+
+    // Continue the timeline up to the next wait which is not over.
+    while (next < commands.size()) {
+        const Command& command = commands[next];
+        const std::vector<std::string>& words = command.words;
+
+        if (words[0] == "stop") {
+            print("The script stopped the run at frame", frame);
+            input.quit = true;
+            next = commands.size();
+            break;
+        }
+
+        if (words[0] != "wait") {
+            execute(renderer, lbm, input, command);
+            ran = true;
+            next++;
+            continue;
+        }
+
+        const bool steady = words[1] == "steady";
+        const unsigned interval = words.size() == 4 ?
+                                  std::stoul(words[3]) : 1000;
+        if (!waiting) {
+            waiting = true;
+            if (words[1] == "until") {
+                waitFrame = std::stoul(words[2]);
+            }
+            else if (steady) {
+                lastSpeed = lbm.summarise(0, 0, lbm.getWidth(),
+                                          lbm.getHeight()).meanSpeed;
+                waitFrame = frame + interval;
+                ran = true;
+            }
+            else {
+                waitFrame = frame + std::stoul(words[1]);
+            }
+        }
+        if (frame < waitFrame) {
+            break;
+        }
+
+        // The flow is steady if the mean speed hardly changed since the
+        // last check.
+        if (steady) {
+            const double speed = lbm.summarise(0, 0, lbm.getWidth(),
+                                               lbm.getHeight()).meanSpeed;
+            ran = true;
+            if (std::abs(speed - lastSpeed) >
+                std::stod(words[2]) * std::max(speed, 1e-12)) {
+                lastSpeed = speed;
+                waitFrame = frame + interval;
+                break;
+            }
+            print("The flow is steady at frame", frame);
+        }
+        waiting = false;
+        next++;
+    }
+
+    // Reading the model binds its framebuffers.
+    if (ran) {
+        renderer.renderToScreen();
+    }
+}
+
+unsigned Script::nextFrame() const {
+
+    unsigned frame = UINT_MAX;
+    for (const Repeat& repeat : repeats) {
+        frame = std::min(frame, repeat.next);
+    }
+    if (!finished()) {
+        frame = std::min(frame, waiting ? waitFrame : 0u);
+    }
+    return frame;
+}
+
+
+void Script::execute( GLRenderer& renderer, LatticeBoltzmann& lbm,
+                      InputData& input, const Command& command ) {
+
+    const std::vector<std::string>& words = command.words;
+    const std::string& name = words[0];
+    const unsigned frame = lbm.getFrame();
+    const std::string file = words.size() > 1 ? words.back() : "";
+
+    if (name == "press") {
+        for (size_t i = 1; i < words.size(); ++i) {
+            for (char key : words[i]) {
+                input.keyMap[scancode(key)] = 2;
+            }
+        }
+    }
+    else if (name == "set") {
+        const int setting = find(settingNames, 4, words[1]);
+        if (setting >= 0) {
+            lbm.setSetting(setting, words[2] == "on");
+        }
+        else if (words[1] == "viscosity") {
+            lbm.setViscosity(std::stod(words[2]));
+        }
+        else {
+            lbm.setView((LatticeBoltzmann::View) find(
+                viewNames, LatticeBoltzmann::viewCount, words[2]));
+        }
+    }
+    else if (name == "stats") {
+        lbm.enableStatistics(std::stoul(words[1]));
+    }
+    else if (name == "save") {
+        input.keyMap[SDL_SCANCODE_S] = 2;
+    }
+    else if (name == "summary") {
+        const LatticeBoltzmann::Summary summary =
+            lbm.summarise(0, 0, lbm.getWidth(), lbm.getHeight());
+        std::stringstream line;
+        line << "summary " << frame << " fluid=" << summary.fluidCells
+             << " mass=" << summary.mass << " mean=" << summary.meanSpeed
+             << " max=" << summary.maxSpeed << " checksum=" << std::hex
+             << summary.checksum;
+        log(words.size() == 2 ? file : "", line.str());
+    }
+    else if (name == "probe") {
+        const int x = std::stoi(words[1]), y = std::stoi(words[2]);
+        if (x >= lbm.getWidth() || y >= lbm.getHeight()) {
+            print(path + ":" + toString(command.line) + ":",
+                  "the cell is outside of the lattice");
+            return;
+        }
+        std::vector<double> u;
+        std::vector<bool> walls;
+        lbm.readVelocity(x, y, 1, 1, u, walls);
+        log(words.size() == 4 ? file : "", "probe " + toString(frame) +
+            " " + toString(x) + " " + toString(y) + " " + toString(u[0]) +
+            " " + toString(u[1]) + (walls[0] ? " wall" : ""));
+    }
+    else if (name == "profile") {
+        const bool column = words[1] == "x";
+        const int position = std::stoi(words[2]);
+        if (position >= (column ? lbm.getWidth() : lbm.getHeight())) {
+            print(path + ":" + toString(command.line) + ":",
+                  "the position is outside of the lattice");
+            return;
+        }
+        std::vector<double> u;
+        std::vector<bool> walls;
+        if (column) {
+            lbm.readVelocity(position, 0, 1, lbm.getHeight(), u, walls);
+        }
+        else {
+            lbm.readVelocity(0, position, lbm.getWidth(), 1, u, walls);
+        }
+        std::string line = "profile " + toString(frame) + " " + words[1] +
+                           " " + words[2];
+        for (size_t i = 0; i < walls.size(); ++i) {
+            line += walls[i] ? " nan" : " " + toString(u[2*i + !column]);
+        }
+        log(words.size() == 4 ? file : "", line);
+    }
+    else if (name == "checkpoint") {
+        if (!lbm.saveCheckpoint(fileName(file, frame))) {
+            print(path + ":" + toString(command.line) + ":",
+                  "could not save the checkpoint");
+        }
+    }
+    else if (name == "load") {
+        if (!lbm.loadCheckpoint(fileName(file, frame))) {
+            print(path + ":" + toString(command.line) + ":",
+                  "could not load the checkpoint");
+        }
+    }
+    else if (name == "every") {
+        Command repeated;
+        repeated.words.assign(words.begin() + 2, words.end());
+        repeated.period = std::stoul(words[1]);
+        repeated.line = command.line;
+        execute(renderer, lbm, input, repeated);
+        repeats.push_back({repeated, frame + repeated.period});
+    }
+}
+
+void Script::log( const std::string& file, const std::string& line ) {
+    if (file.empty()) {
+        print(line);
+        return;
+    }
+    std::ofstream out(file, std::ios::app);
+    out << line << std::endl;
+    if (!out) {
+        print("Could not write to", file);
+    }
+}
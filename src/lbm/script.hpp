@@ -0,0 +1,144 @@
+/**
+ * Experiment scripts, which run a timeline of actions on the model.
+ *
+ * @file script.hpp
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#pragma once
+
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "lbm.hpp"
+
+namespace pcs {
+
+    /**
+     * The Script class runs an experiment script: a timeline of commands,
+     * one per line, which replaces pressing keys at the right moments. The
+     * commands run in order, where the `wait` commands hold the timeline
+     * until the model gets there. Text after a `#` is ignored.
+     *
+     * The timeline is held by:
+     *  - `wait {{frames}}` for an amount of frames.
+     *  - `wait until {{frame}}` until a frame.
+     *  - `wait steady {{tolerance}} [{{interval}}]` until the flow is
+     *    steady: until the mean speed changes less than the relative
+     *    tolerance between two checks, which are `interval` frames apart
+     *    (1000 by default).
+     *
+     * The other commands run immediately:
+     *  - `press {{keys}}` presses keys, like `T` or `O`, as in the window.
+     *  - `set {{source|erosion|sedimentation|slope}} {{on|off}}`, `set
+     *    viscosity {{value}}` and `set view {{velocity|vorticity|strain|
+     *    shear}}` change the model.
+     *  - `stats {{interval}}` starts the time averaged statistics.
+     *  - `save` saves the fields, like `S`.
+     *  - `probe {{x}} {{y}} [{{file}}]` logs the velocity of a cell.
+     *  - `profile {{x|y}} {{position}} [{{file}}]` logs the x velocity of
+     *    the column, or the y velocity of the row, at a position, like `X`
+     *    and `Y` (walls are logged as `nan`).
+     *  - `summary [{{file}}]` logs the summary of the lattice (see
+     *    `LatticeBoltzmann::Summary`).
+     *  - `checkpoint {{file}}` and `load {{file}}` save and restore the
+     *    state, where `{frame}` in the name is replaced by the frame.
+     *  - `stop` ends the run.
+     *  - `every {{frames}} {{command}}` runs a command from now on, every
+     *    amount of frames.
+     * Logged lines start with the command and the frame, and are printed,
+     * or appended to the given file.
+     */
+    class Script {
+
+        // A parsed command, with the line it came from.
+        struct Command {
+            std::vector<std::string> words;
+            unsigned period; // For `every`, with the command after it.
+            int line;
+        };
+
+        // A command which runs every `period` frames.
+        struct Repeat {
+            Command command;
+            unsigned next;
+        };
+
+    public:
+
+        /**
+         * Read and check a script. Errors are printed with their line.
+         *
+         * @param path The path of the script
+         * @return True on success, false otherwise.
+         */
+        bool load( const std::string& path );
+
+        /**
+         * Read and check a script from a stream, like `load()`.
+         *
+         * @param stream The script
+         * @param name The name of the script in the errors
+         * @return True on success, false otherwise.
+         */
+        bool load( std::istream& stream, const std::string& name );
+
+        /**
+         * Run the commands which are due at the current frame of the model.
+         * Keys are pressed by adding them to the input, and `stop` sets
+         * `input.quit`.
+         *
+         * @param renderer The OpenGL instance
+         * @param lbm The model
+         * @param input The input of this frame
+         */
+        void run( GLRenderer& renderer, LatticeBoltzmann& lbm,
+                  InputData& input );
+
+        /**
+         * Get the next frame at which the script has to run, so a run
+         * without a window can simulate up to it at once.
+         *
+         * @return The frame, or the largest value if there is none.
+         */
+        unsigned nextFrame() const;
+
+        // If the timeline has ended, apart from the repeated commands.
+        inline bool finished() const { return next >= commands.size(); }
+
+    private:
+
+        /**
+         * Check a command while loading.
+         *
+         * @return An error message, or an empty string if it is valid.
+         */
+        static std::string check( const std::vector<std::string>& words );
+
+        /**
+         * Run a command which does not wait.
+         */
+        void execute( GLRenderer& renderer, LatticeBoltzmann& lbm,
+                      InputData& input, const Command& command );
+
+        /**
+         * Log a line to a file, or print it if the file is empty.
+         */
+        static void log( const std::string& file, const std::string& line );
+
+        std::string path;
+        std::vector<Command> commands;
+        std::vector<Repeat> repeats;
+
+        // The next command of the timeline, and if it is waiting: until
+        // `waitFrame`, or for a steady flow, checked at `waitFrame`.
+        size_t next = 0;
+        bool waiting = false;
+        unsigned waitFrame = 0;
+        double lastSpeed = 0.0;
+    };
+}
@@ -0,0 +1,574 @@
+/**
+ * The job server. See server.hpp for details.
+ *
+ * @file server.cpp
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#include "server.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "importer.hpp"
+#include "lbm.hpp"
+#include "output.hpp"
+#include "../print.hpp"
+
+using namespace pcs;
+
+
+// Set by SIGINT and SIGTERM, to shut down the server.
+static volatile std::sig_atomic_t interrupted = 0;
+
+static void interrupt( int ) {
+    interrupted = 1;
+}
+
+
+// A submitted simulation.
+struct Job {
+    unsigned id;
+    int client; // The socket of the client, or -1 if it disconnected.
+
+    // The description, see `runServer()`.
+    std::string map, checkpoint, dumpDir;
+    unsigned steps, seed, statsEvery, dumpEvery;
+    double viscosity, waterLevel;
+    bool settings[4];
+
+    // The state of a running job.
+    std::unique_ptr<LatticeBoltzmann> lbm;
+    std::unique_ptr<OutputThread> output;
+    unsigned nextDump;
+    double seconds;
+};
+
+// A connected client, with the input which does not form a line yet.
+struct Client {
+    int fd;
+    std::string input;
+};
+
+
+class Server {
+
+public:
+
+    Server( Window& window_, GLRenderer& renderer_,
+            const ServerOptions& options_ )
+        : window(window_), renderer(renderer_), options(options_),
+          nextId(1), next(0), stopping(false) {}
+
+    int run( const std::string& socketPath );
+
+private:
+
+    // Handle the socket events, waiting for them if there is nothing to run.
+    void poll( int listener, bool wait );
+
+    // Handle a command of a client.
+    void handle( int fd, const std::string& line );
+    void submit( int fd, std::istringstream& words );
+    void status( int fd );
+    void cancel( int fd, unsigned id );
+
+    // Create the lattice of a job, reusing an idle one if possible.
+    bool start( Job& job );
+
+    // Run a job for a slice, and finish it when done.
+    void runSlice( Job& job );
+
+    // Save the results of a job and release its lattice.
+    void finish( Job& job );
+    void release( Job& job );
+
+    // Send a line to a client, closing it if that fails.
+    void send( int fd, const std::string& line );
+    void disconnect( int fd );
+
+    Window& window;
+    GLRenderer& renderer;
+    const ServerOptions options;
+
+    std::vector<Client> clients;
+    std::deque<std::unique_ptr<Job>> queued;
+    std::vector<std::unique_ptr<Job>> active;
+    std::vector<std::unique_ptr<LatticeBoltzmann>> idle;
+
+    unsigned nextId;
+    size_t next; // The active job which runs the next slice.
+    bool stopping;
+};
+
+
+int Server::run( const std::string& socketPath ) {
+
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof address);
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof address.sun_path) {
+        print(INFO_, "The socket path", socketPath, "is too long!");
+        return 1;
+    }
+    std::strcpy(address.sun_path, socketPath.c_str());
+
+    const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socketPath.c_str());
+    if (listener < 0 ||
+        bind(listener, (sockaddr*) &address, sizeof address) != 0 ||
+        listen(listener, 16) != 0) {
+        print(INFO_, "Failed to listen on", socketPath, ":",
+              std::strerror(errno));
+        if (listener >= 0) close(listener);
+        return 1;
+    }
+    fcntl(listener, F_SETFL, O_NONBLOCK);
+
+    std::signal(SIGINT, interrupt);
+    std::signal(SIGTERM, interrupt);
+
+    // Compile the programs once for all jobs.
+    LatticeBoltzmann::keepPrograms(true);
+    print("Listening on", socketPath);
+
+    while (!stopping && !interrupted) {
+        poll(listener, active.empty() && queued.empty());
+
+        // Start the queued jobs while there is room.
+        while (!stopping && active.size() < options.maxActive &&
+               !queued.empty()) {
+            std::unique_ptr<Job> job = std::move(queued.front());
+            queued.pop_front();
+            if (start(*job)) {
+                active.push_back(std::move(job));
+            }
+        }
+
+        // Run the active jobs in turn.
+        if (!stopping && !active.empty()) {
+            next %= active.size();
+            runSlice(*active[next]);
+            if (active[next]->lbm) {
+                next++;
+            }
+            else {
+                active.erase(active.begin() + next);
+            }
+        }
+    }
+
+    // Cancel everything which is left.
+    for (std::unique_ptr<Job>& job : active) {
+        release(*job);
+        send(job->client, "cancelled " + toString(job->id));
+    }
+    for (std::unique_ptr<Job>& job : queued) {
+        send(job->client, "cancelled " + toString(job->id));
+    }
+    for (std::unique_ptr<LatticeBoltzmann>& lbm : idle) {
+        lbm->close();
+    }
+    for (Client& client : clients) {
+        close(client.fd);
+    }
+    LatticeBoltzmann::keepPrograms(false);
+
+    close(listener);
+    unlink(socketPath.c_str());
+    print("Server stopped");
+    return 0;
+}
+
+void Server::poll( int listener, bool wait ) {
+
+    std::vector<pollfd> fds = {{listener, POLLIN, 0}};
+    for (const Client& client : clients) {
+        fds.push_back({client.fd, POLLIN, 0});
+    }
+
+    // Wake up regularly when waiting, to notice interrupts.
+    if (::poll(fds.data(), fds.size(), wait ? 1000 : 0) <= 0) {
+        return;
+    }
+
+    if (fds[0].revents & POLLIN) {
+        int fd;
+        while ((fd = accept(listener, nullptr, nullptr)) >= 0) {
+            fcntl(fd, F_SETFL, O_NONBLOCK);
+            clients.push_back({fd, ""});
+        }
+    }
+
+    // Read the clients, and handle every complete line. Clients may be
+    // disconnected while handling, so they are looked up by socket.
+    for (size_t i = 1; i < fds.size(); ++i) {
+        if (fds[i].revents == 0) continue;
+
+        char buffer[4096];
+        const ssize_t size = read(fds[i].fd, buffer, sizeof buffer);
+        if (size <= 0) {
+            disconnect(fds[i].fd);
+            continue;
+        }
+
+        auto find = [&]() {
+            return std::find_if(clients.begin(), clients.end(),
+                                [&]( const Client& c ) {
+                                    return c.fd == fds[i].fd;
+                                });
+        };
+        auto client = find();
+        if (client == clients.end()) continue;
+
+        client->input.append(buffer, size);
+        size_t end;
+        while (client != clients.end() &&
+               (end = client->input.find('\n')) != std::string::npos) {
+            const std::string line = client->input.substr(0, end);
+            client->input.erase(0, end + 1);
+            handle(fds[i].fd, line);
+            client = find();
+        }
+    }
+}
+
+void Server::handle( int fd, const std::string& line ) {
+
+    std::istringstream words(line);
+    std::string command;
+    words >> command;
+
+    if (command == "submit") {
+        submit(fd, words);
+    }
+    else if (command == "status") {
+        status(fd);
+    }
+    else if (command == "cancel") {
+        std::string id;
+        unsigned value;
+        words >> id;
+        if (parseNumber(id, value)) {
+            cancel(fd, value);
+        }
+        else {
+            send(fd, "error invalid job id '" + id + "'");
+        }
+    }
+    else if (command == "shutdown") {
+        stopping = true;
+    }
+    else if (!command.empty()) {
+        send(fd, "error unknown command '" + command + "'");
+    }
+}
+
+void Server::submit( int fd, std::istringstream& words ) {
+
+    std::unique_ptr<Job> job(new Job());
+    job->client = fd;
+    job->steps = 0;
+    job->seed = 0;
+    job->statsEvery = 0;
+    job->dumpEvery = 0;
+    job->viscosity = 0.005;
+    job->waterLevel = 0.1;
+    job->dumpDir = "output";
+    job->settings[0] = true;
+    job->settings[1] = job->settings[2] = job->settings[3] = false;
+
+    // Every word is a key and a value.
+    const char* settingKeys[4] = {"source", "erosion", "sedimentation",
+                                  "slope"};
+    std::string word;
+    while (words >> word) {
+        const size_t split = word.find('=');
+        const std::string key = word.substr(0, split);
+        const std::string value = split == std::string::npos ?
+                                  "" : word.substr(split + 1);
+
+        bool valid = true;
+        unsigned flag = 0;
+        if (key == "map") job->map = value;
+        else if (key == "checkpoint") job->checkpoint = value;
+        else if (key == "dump-dir") job->dumpDir = value;
+        else if (key == "steps") valid = parseNumber(value, job->steps);
+        else if (key == "seed") valid = parseNumber(value, job->seed);
+        else if (key == "stats-every") {
+            valid = parseNumber(value, job->statsEvery);
+        }
+        else if (key == "dump-every") {
+            valid = parseNumber(value, job->dumpEvery);
+        }
+        else if (key == "viscosity") {
+            valid = parseNumber(value, job->viscosity);
+        }
+        else if (key == "water-level") {
+            valid = parseNumber(value, job->waterLevel);
+        }
+        else {
+            valid = false;
+            for (size_t i = 0; i < 4; ++i) {
+                if (key == settingKeys[i]) {
+                    valid = parseNumber(value, flag) && flag <= 1;
+                    job->settings[i] = flag;
+                }
+            }
+        }
+
+        if (!valid) {
+            send(fd, "error invalid option '" + word + "'");
+            return;
+        }
+    }
+
+    if (job->map.empty() || job->steps == 0) {
+        send(fd, "error a job needs a map and steps");
+        return;
+    }
+
+    job->id = nextId++;
+    send(fd, "accepted " + toString(job->id));
+    queued.push_back(std::move(job));
+}
+
+void Server::status( int fd ) {
+    for (const std::unique_ptr<Job>& job : active) {
+        send(fd, "job " + toString(job->id) + " running " +
+             toString(job->lbm->getFrame()) + " " + toString(job->steps));
+    }
+    for (const std::unique_ptr<Job>& job : queued) {
+        send(fd, "job " + toString(job->id) + " queued 0 " +
+             toString(job->steps));
+    }
+    send(fd, "end");
+}
+
+void Server::cancel( int fd, unsigned id ) {
+
+    auto matches = [&]( const std::unique_ptr<Job>& job ) {
+        return job->id == id;
+    };
+
+    // The reply goes to the client which cancelled the job, and to the
+    // client which submitted it, if that is another one.
+    int owner = -1;
+    auto running = std::find_if(active.begin(), active.end(), matches);
+    auto waiting = std::find_if(queued.begin(), queued.end(), matches);
+    if (running != active.end()) {
+        release(**running);
+        owner = (*running)->client;
+        active.erase(running);
+    }
+    else if (waiting != queued.end()) {
+        owner = (*waiting)->client;
+        queued.erase(waiting);
+    }
+    else {
+        send(fd, "error no job " + toString(id));
+        return;
+    }
+
+    send(fd, "cancelled " + toString(id));
+    if (owner != fd) {
+        send(owner, "cancelled " + toString(id));
+    }
+}
+
+bool Server::start( Job& job ) {
+
+    // Import the map into a new flags texture.
+    MapImporter importer = MapImporter(job.map, job.waterLevel);
+    GLuint flags = 0;
+    if (importer.isOpen()) {
+        flags = gl::genUTexture(importer.getWidth(), importer.getHeight());
+        if (!importer.upload(flags)) {
+            glDeleteTextures(1, &flags);
+            flags = 0;
+        }
+    }
+    importer.close();
+
+    if (flags == 0) {
+        send(job.client, "error job " + toString(job.id) +
+             " failed to import '" + job.map + "'");
+        return false;
+    }
+
+    // Reset an idle lattice of the same size, or create a new one.
+    const int width = importer.getWidth(), height = importer.getHeight();
+    auto reusable = std::find_if(
+        idle.begin(), idle.end(),
+        [&]( const std::unique_ptr<LatticeBoltzmann>& lbm ) {
+            return lbm->getWidth() == width && lbm->getHeight() == height;
+        });
+    if (reusable != idle.end()) {
+        job.lbm = std::move(*reusable);
+        idle.erase(reusable);
+        job.lbm->reset(renderer, flags);
+        print("Started job", job.id, "of", job.map, "on an idle lattice");
+    }
+    else {
+        job.lbm.reset(new LatticeBoltzmann(renderer, flags, width, height));
+        print("Started job", job.id, "of", job.map, "on a new lattice");
+    }
+
+    LatticeBoltzmann& lbm = *job.lbm;
+    lbm.setSeed(job.seed);
+    lbm.setViscosity(job.viscosity);
+    for (size_t i = 0; i < 4; ++i) {
+        lbm.setSetting(i, job.settings[i]);
+    }
+    lbm.enableStatistics(job.statsEvery);
+
+    // Jobs are not dropping outputs, unlike the interactive program.
+    if (job.dumpEvery > 0) {
+        const size_t outputs = 1 + (job.statsEvery > 0);
+        job.output.reset(new OutputThread(window, width, height, job.dumpDir,
+                                          2 * outputs, OutputPolicy::Block));
+    }
+    job.nextDump = job.dumpEvery;
+    job.seconds = 0.0;
+
+    renderer.renderToScreen();
+    return true;
+}
+
+void Server::runSlice( Job& job ) {
+
+    LatticeBoltzmann& lbm = *job.lbm;
+
+    // Run up to the end of the slice or the next output.
+    unsigned target = std::min(job.steps,
+                               lbm.getFrame() + options.sliceSteps);
+    if (job.dumpEvery > 0) {
+        target = std::min(target, job.nextDump);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    lbm.step(renderer, target - std::min(target, lbm.getFrame()));
+    glFinish();
+    job.seconds += std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    if (job.output && lbm.getFrame() >= job.nextDump) {
+        job.output->queueFields(lbm);
+        job.output->queueStatistics(lbm);
+        job.nextDump = (lbm.getFrame() / job.dumpEvery + 1) * job.dumpEvery;
+    }
+
+    const double mlups = job.seconds > 0.0 ?
+        (double) lbm.getFrame() * lbm.getWidth() * lbm.getHeight() /
+        job.seconds / 1e6 : 0.0;
+    send(job.client, "progress " + toString(job.id) + " " +
+         toString(lbm.getFrame()) + " " + toString(job.steps) + " " +
+         toString(mlups));
+
+    if (lbm.getFrame() >= job.steps) {
+        finish(job);
+    }
+}
+
+void Server::finish( Job& job ) {
+
+    LatticeBoltzmann& lbm = *job.lbm;
+    const LatticeBoltzmann::Summary summary =
+        lbm.summarise(0, 0, lbm.getWidth(), lbm.getHeight());
+
+    const bool saved = job.checkpoint.empty() ||
+                       lbm.saveCheckpoint(job.checkpoint);
+
+    const double mlups = job.seconds > 0.0 ?
+        (double) lbm.getFrame() * lbm.getWidth() * lbm.getHeight() /
+        job.seconds / 1e6 : 0.0;
+    std::ostringstream done;
+    done << "done " << job.id
+         << " frames=" << lbm.getFrame()
+         << " seconds=" << job.seconds
+         << " mlups=" << mlups
+         << " mean_speed=" << summary.meanSpeed
+         << " max_speed=" << summary.maxSpeed
+         << " mass=" << summary.mass
+         << " checksum=" << summary.checksum;
+    if (!saved) {
+        done << " checkpoint=failed";
+    }
+
+    release(job);
+    send(job.client, done.str());
+    print("Finished job", job.id, "in", job.seconds, "s,", mlups, "MLUPS");
+}
+
+void Server::release( Job& job ) {
+
+    if (job.output) {
+        job.output->close();
+        job.output.reset();
+    }
+
+    // Keep the lattice for a later job, and close the oldest idle lattice
+    // when there are too many.
+    job.lbm->enableStatistics(0);
+    idle.push_back(std::move(job.lbm));
+    if (idle.size() > options.poolSize) {
+        idle.front()->close();
+        idle.erase(idle.begin());
+    }
+    renderer.renderToScreen();
+}
+
+void Server::send( int fd, const std::string& line ) {
+    if (fd < 0) {
+        return;
+    }
+    const std::string data = line + "\n";
+    if (::send(fd, data.data(), data.size(), MSG_NOSIGNAL) !=
+        (ssize_t) data.size()) {
+        disconnect(fd);
+    }
+}
+
+void Server::disconnect( int fd ) {
+
+    auto client = std::find_if(clients.begin(), clients.end(),
+                               [&]( const Client& c ) { return c.fd == fd; });
+    if (client == clients.end()) {
+        return;
+    }
+    close(fd);
+    clients.erase(client);
+
+    // The jobs of the client keep running, without replies.
+    for (std::unique_ptr<Job>& job : active) {
+        if (job->client == fd) job->client = -1;
+    }
+    for (std::unique_ptr<Job>& job : queued) {
+        if (job->client == fd) job->client = -1;
+    }
+}
+
+
+int pcs::runServer( Window& window, GLRenderer& renderer,
+                    const std::string& socketPath,
+                    const ServerOptions& options ) {
+    Server server(window, renderer, options);
+    return server.run(socketPath);
+}
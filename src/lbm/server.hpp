@@ -0,0 +1,71 @@
+/**
+ * A job server, which runs the simulations submitted through a Unix domain
+ * socket in a single, long lived OpenGL context.
+ *
+ * @file server.hpp
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#pragma once
+
+#include <string>
+
+#include "../sdl/window.hpp"
+#include "../opengl/opengl.hpp"
+
+namespace pcs {
+
+    /**
+     * The options of the job server.
+     */
+    struct ServerOptions {
+        unsigned sliceSteps = 500; // Frames a job runs before the next one.
+        size_t maxActive = 4;      // Jobs with a lattice at the same time.
+        size_t poolSize = 4;       // Idle lattices kept for later jobs.
+    };
+
+    /**
+     * Run the job server until it is shut down. The server avoids the setup
+     * of a process per simulation: the programs are compiled once, and the
+     * lattices of finished jobs are kept, to be reset for later jobs of the
+     * same size.
+     *
+     * Clients connect to the socket and send commands, one per line, and
+     * receive replies as lines as well:
+     *  - `submit key=value ...` queues a job, replying `accepted {{id}}`.
+     *    The keys are `map` (required), `steps` (required), `seed`,
+     *    `viscosity`, `water-level`, the settings `source`, `erosion`,
+     *    `sedimentation` and `slope` (0 or 1), `stats-every`, `dump-every`
+     *    and `dump-dir` (see output.hpp), and `checkpoint`, a file to which
+     *    the final state is saved.
+     *    While it runs, `progress {{id}} {{frame}} {{steps}} {{mlups}}` is
+     *    sent after every slice, and finally `done {{id}} key=value ...`,
+     *    with the frames, seconds, MLUPS, mean and max speed, fluid mass
+     *    and checksum (see `LatticeBoltzmann::Summary`), and
+     *    `checkpoint=failed` if the checkpoint could not be saved.
+     *  - `status` replies `job {{id}} {{queued|running}} {{frame}}
+     *    {{steps}}` for every job, followed by `end`.
+     *  - `cancel {{id}}` stops a job, replying `cancelled {{id}}`, which
+     *    is also sent to the client which submitted it.
+     *  - `shutdown` cancels all jobs and stops the server.
+     * Errors are replied as `error {{message}}`. The replies about a job go
+     * to the client which submitted it, if it is still connected.
+     *
+     * Up to `maxActive` jobs have a lattice at the same time, and are run in
+     * turn for `sliceSteps` frames each, so short jobs are not stuck behind
+     * long ones. The others wait in submission order.
+     *
+     * @param window The window of the context, for the output threads
+     * @param renderer The OpenGL instance
+     * @param socketPath The path of the socket, which is replaced if it
+     *                   exists
+     * @param options The options of the server
+     * @return The exit code, 0 on success.
+     */
+    int runServer( Window& window, GLRenderer& renderer,
+                   const std::string& socketPath,
+                   const ServerOptions& options );
+}
@@ -0,0 +1,104 @@
+/**
+ * Accumulates the time averaged flow statistics of the LBM simulation.
+ *
+ * @file stats.frag
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#version 430
+
+precision highp float;
+precision highp usampler2D;
+
+layout(location = 0) out uvec4 o_stats[4];
+
+layout(location = 3) uniform usampler2D u_textures[7];
+layout(location = 10) uniform usampler2D u_stats[4];
+layout(location = 14) uniform double u_interval; // Frames per sample.
+
+
+// The constants and `wall_force()`, without the update of the cells.
+#define SHARED_ONLY
+#include "lbm.glsl"
+
+// The f_i directions of `lbm.glsl` as cell offsets.
+const ivec2 offset[9] = ivec2[9](ivec2(0, 0),  ivec2(1, 0),   ivec2(0, 1),
+                                 ivec2(-1, 0), ivec2(0, -1),  ivec2(1, 1),
+                                 ivec2(-1, 1), ivec2(-1, -1), ivec2(1, -1));
+
+
+// Get the first or second double of a texel, with periodic boundaries like
+// the repeating textures of `lbm.frag`.
+double get1f( in usampler2D textr, in ivec2 loc ) {
+    ivec2 size = textureSize(textr, 0);
+    return packDouble2x32(texelFetch(textr, (loc + size) % size, 0).rg);
+}
+
+double get2f( in usampler2D textr, in ivec2 loc ) {
+    ivec2 size = textureSize(textr, 0);
+    return packDouble2x32(texelFetch(textr, (loc + size) % size, 0).ba);
+}
+
+
+void main() {
+
+    ivec2 loc = ivec2(gl_FragCoord.xy);
+
+    bool isWall = texelFetch(u_textures[0], loc, 0).a != 0;
+
+    // The statistics so far, see `StatsBuffers` in `lbm.hpp`.
+    dvec2 mean_u = dvec2(get1f(u_stats[0], loc), get2f(u_stats[0], loc));
+    double mean_rho = get1f(u_stats[1], loc);
+    double shear = get2f(u_stats[1], loc);
+    dvec2 m2_u = dvec2(get1f(u_stats[2], loc), get2f(u_stats[2], loc));
+    double c_uv = get1f(u_stats[3], loc);
+    double n = get2f(u_stats[3], loc);
+
+    if (!isWall) {
+
+        // Welford update of the means and the (co)variance sums of the
+        // fluid, using the new mean for the second factor.
+        dvec2 u = dvec2(get1f(u_textures[1], loc), get2f(u_textures[1], loc));
+        double rho = get1f(u_textures[2], loc);
+
+        n += 1.0;
+        dvec2 delta = u - mean_u;
+        mean_u += delta / n;
+        mean_rho += (rho - mean_rho) / n;
+        m2_u += delta * (u - mean_u);
+        c_uv += delta.x * (u.y - mean_u.y);
+    }
+    else {
+
+        // The force which erodes the walls in the next frame of `lbm.frag`.
+        double phi[9] = double[9](
+            0.0,
+            get1f(u_textures[3], loc), get2f(u_textures[3], loc),
+            get1f(u_textures[4], loc), get2f(u_textures[4], loc),
+            get1f(u_textures[5], loc), get2f(u_textures[5], loc),
+            get1f(u_textures[6], loc), get2f(u_textures[6], loc)
+        );
+        double f[9] = double[9](
+            0.0,
+            get1f(u_textures[3], loc - offset[1]),
+            get2f(u_textures[3], loc - offset[2]),
+            get1f(u_textures[4], loc - offset[3]),
+            get2f(u_textures[4], loc - offset[4]),
+            get1f(u_textures[5], loc - offset[5]),
+            get2f(u_textures[5], loc - offset[6]),
+            get1f(u_textures[6], loc - offset[7]),
+            get2f(u_textures[6], loc - offset[8])
+        );
+
+        // Integrate over the frames since the last sample.
+        shear += length(wall_force(phi, f)) * u_interval;
+    }
+
+    o_stats[0] = uvec4(unpackDouble2x32(mean_u.x), unpackDouble2x32(mean_u.y));
+    o_stats[1] = uvec4(unpackDouble2x32(mean_rho), unpackDouble2x32(shear));
+    o_stats[2] = uvec4(unpackDouble2x32(m2_u.x), unpackDouble2x32(m2_u.y));
+    o_stats[3] = uvec4(unpackDouble2x32(c_uv), unpackDouble2x32(n));
+}
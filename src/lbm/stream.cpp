@@ -0,0 +1,466 @@
+/**
+ * Streaming the visualisation. See stream.hpp for details.
+ *
+ * @file stream.cpp
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#include "stream.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../print.hpp"
+#include "../opengl/profiler.hpp"
+
+using namespace pcs;
+
+
+// The keys which viewers can press.
+static const char streamKeys[] = "QWERTPFGOA";
+
+// Run length encode the delta of a frame, see `StreamHeader`.
+static void encode( const std::vector<uint8_t>& delta,
+                    std::vector<uint8_t>& data ) {
+
+    auto push16 = [&]( size_t value ) {
+        data.push_back(value & 0xff);
+        data.push_back(value >> 8);
+    };
+
+    const size_t n = delta.size();
+    size_t i = 0;
+    while (i < n) {
+        size_t zeros = 0;
+        while (i < n && delta[i] == 0 && zeros < 0xffff) {
+            zeros++;
+            i++;
+        }
+
+        // The literals continue up to the next run of at least four zeros.
+        const size_t start = i;
+        while (i < n && i - start < 0xffff &&
+               !(delta[i] == 0 && i + 3 < n && delta[i + 1] == 0 &&
+                 delta[i + 2] == 0 && delta[i + 3] == 0)) {
+            i++;
+        }
+
+        push16(zeros);
+        push16(i - start);
+        data.insert(data.end(), delta.begin() + start, delta.begin() + i);
+    }
+}
+
+// Write all the data to a socket, waiting at most a second for a viewer
+// which is behind. Returns false on failure.
+static bool sendAll( int fd, const void* data, size_t size ) {
+    const char* bytes = (const char*) data;
+    while (size > 0) {
+        const ssize_t written = ::send(fd, bytes, size, MSG_NOSIGNAL);
+        if (written > 0) {
+            bytes += written;
+            size -= written;
+            continue;
+        }
+        pollfd writable = {fd, POLLOUT, 0};
+        if (written < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            return false;
+        }
+        if (poll(&writable, 1, 1000) <= 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+Stream::Stream( const std::string& address, int width_, int height_,
+                double fps, size_t depth ) {
+
+    width = width_;
+    height = height_;
+    interval = std::chrono::duration<double>(1.0 / std::max(fps, 0.01));
+    listener = -1;
+    next = inFlight = 0;
+    lastTime = std::chrono::steady_clock::now();
+    lastFrame = 0;
+    sent = bytes = viewers = 0;
+    region[0] = region[1] = region[2] = region[3] = 0;
+    quit = false;
+
+    // A port number is a local TCP port, anything else a Unix socket.
+    const bool tcp = !address.empty() &&
+        address.find_first_not_of("0123456789") == std::string::npos;
+    if (tcp) {
+        sockaddr_in local;
+        std::memset(&local, 0, sizeof local);
+        local.sin_family = AF_INET;
+        local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        local.sin_port = htons(std::stoi(address));
+
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        const int reuse = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof reuse);
+        if (bind(listener, (sockaddr*) &local, sizeof local) != 0) {
+            ::close(listener);
+            listener = -1;
+        }
+    }
+    else if (address.size() < sizeof sockaddr_un().sun_path) {
+        sockaddr_un local;
+        std::memset(&local, 0, sizeof local);
+        local.sun_family = AF_UNIX;
+        std::strcpy(local.sun_path, address.c_str());
+
+        socketPath = address;
+        unlink(socketPath.c_str());
+        listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (bind(listener, (sockaddr*) &local, sizeof local) != 0) {
+            ::close(listener);
+            listener = -1;
+        }
+    }
+
+    if (listener < 0 || listen(listener, 4) != 0) {
+        print(INFO_, "Failed to open the stream at", address, ":",
+              std::strerror(errno));
+        if (listener >= 0) ::close(listener);
+        listener = -1;
+        wake[0] = wake[1] = -1;
+        texture = 0;
+        return;
+    }
+    fcntl(listener, F_SETFL, O_NONBLOCK);
+    if (pipe(wake) != 0) {
+        wake[0] = wake[1] = -1;
+    }
+
+    texture = gl::genTexture(width, height);
+
+    slots.resize(std::max<size_t>(1, depth));
+    for (Slot& slot : slots) {
+        glGenBuffers(1, &slot.pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (size_t) width * height * 4,
+                     nullptr, GL_STREAM_READ);
+        slot.fence = nullptr;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    print("Streaming at", address);
+    thread = std::thread(&Stream::run, this);
+}
+
+void Stream::close() {
+
+    if (!isOpen()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    if (write(wake[1], "", 1) < 0) {}
+    thread.join();
+
+    for (Slot& slot : slots) {
+        if (slot.fence != nullptr) {
+            glDeleteSync(slot.fence);
+        }
+        glDeleteBuffers(1, &slot.pbo);
+    }
+    glDeleteTextures(1, &texture);
+
+    ::close(listener);
+    ::close(wake[0]);
+    ::close(wake[1]);
+    listener = -1;
+    if (!socketPath.empty()) {
+        unlink(socketPath.c_str());
+    }
+
+    print("Streamed", (size_t) sent, "frames in", (size_t) bytes, "bytes");
+}
+
+bool Stream::due() const {
+    return isOpen() && viewers > 0 &&
+           std::chrono::steady_clock::now() - lastTime >= interval;
+}
+
+void Stream::publish( GLRenderer& renderer, LatticeBoltzmann& lbm ) {
+
+    PROFILE_SCOPE("publish stream frame");
+    PROFILE_GPU("publish stream frame");
+
+    // Skip the frame if the whole ring is still in flight, rather than
+    // waiting for it.
+    retire();
+    if (slots[next].fence != nullptr) {
+        return;
+    }
+
+    // The region asked for by the viewers, or the whole lattice.
+    int shown[4];
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::copy(region, region + 4, shown);
+    }
+    if (shown[2] <= 0 || shown[3] <= 0) {
+        shown[0] = shown[1] = 0;
+        shown[2] = lbm.getWidth();
+        shown[3] = lbm.getHeight();
+    }
+
+    // Render the region to fit the frame, with square cells.
+    const float scale = std::min((float) width / shown[2],
+                                 (float) height / shown[3]);
+    renderer.renderToTexture(texture);
+    renderer.clear(0.f, 0.f, 0.f, 1.f);
+    lbm.renderFields(renderer, -shown[0] * scale, -shown[1] * scale,
+                     lbm.getWidth() * scale, lbm.getHeight() * scale,
+                     width, height);
+
+    // Start the read back.
+    Slot& slot = slots[next];
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+
+    // The metrics of the frame.
+    const auto now = std::chrono::steady_clock::now();
+    const double seconds =
+        std::chrono::duration<double>(now - lastTime).count();
+    const unsigned steps = lbm.getFrame() -
+                           std::min(lastFrame, lbm.getFrame());
+    lastTime = now;
+    lastFrame = lbm.getFrame();
+
+    StreamHeader& header = slot.header;
+    std::memcpy(header.magic, "PCSV", 4);
+    header.size = 0;
+    header.width = width;
+    header.height = height;
+    header.frame = lbm.getFrame();
+    header.flags = (lbm.isPaused() ? Paused : 0) |
+                   ((uint32_t) lbm.getView() << 8);
+    for (size_t i = 0; i < 4; ++i) {
+        header.flags |= lbm.getSetting(i) << i;
+        header.region[i] = shown[i];
+    }
+    header.mlups = seconds > 0.0 ?
+        (double) steps * lbm.getWidth() * lbm.getHeight() / seconds / 1e6 :
+        0.0;
+    header.latticeWidth = lbm.getWidth();
+    header.latticeHeight = lbm.getHeight();
+
+    next = (next + 1) % slots.size();
+    inFlight++;
+    renderer.renderToScreen();
+}
+
+void Stream::pollKeys( InputData& input ) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int key : keys) {
+        input.keyMap[key] = 2;
+    }
+    keys.clear();
+}
+
+void Stream::retire() {
+
+    // The oldest slot in flight.
+    size_t index = (next + slots.size() - inFlight) % slots.size();
+
+    while (inFlight > 0) {
+        Slot& slot = slots[index];
+        if (glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) ==
+            GL_TIMEOUT_EXPIRED) {
+            break;
+        }
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+        inFlight--;
+
+        Frame frame = {std::vector<uint8_t>((size_t) width * height * 4),
+                       slot.header};
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                                              frame.pixels.size(),
+                                              GL_MAP_READ_BIT);
+        if (pixels != nullptr) {
+            std::memcpy(frame.pixels.data(), pixels, frame.pixels.size());
+        }
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        // Drop the oldest frame if the sending thread is behind.
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            frames.push_back(std::move(frame));
+            if (frames.size() > slots.size()) {
+                frames.pop_front();
+            }
+        }
+        if (write(wake[1], "", 1) < 0) {}
+
+        index = (index + 1) % slots.size();
+    }
+}
+
+void Stream::run() {
+
+    std::vector<Viewer> list;
+
+    while (true) {
+        std::vector<pollfd> fds = {{wake[0], POLLIN, 0},
+                                   {listener, POLLIN, 0}};
+        for (const Viewer& viewer : list) {
+            fds.push_back({viewer.fd, POLLIN, 0});
+        }
+        poll(fds.data(), fds.size(), 1000);
+
+        if (fds[0].revents & POLLIN) {
+            char buffer[64];
+            if (read(wake[0], buffer, sizeof buffer) < 0) {}
+        }
+
+        if (fds[1].revents & POLLIN) {
+            int fd;
+            while ((fd = accept(listener, nullptr, nullptr)) >= 0) {
+                fcntl(fd, F_SETFL, O_NONBLOCK);
+                list.push_back({fd, "", {}});
+            }
+        }
+
+        // Handle the commands of the viewers.
+        for (size_t i = 2; i < fds.size(); ++i) {
+            if (fds[i].revents == 0) continue;
+
+            Viewer& viewer = list[i - 2];
+            char buffer[1024];
+            const ssize_t size = read(viewer.fd, buffer, sizeof buffer);
+            if (size <= 0) {
+                ::close(viewer.fd);
+                viewer.fd = -1;
+                continue;
+            }
+            viewer.input.append(buffer, size);
+
+            size_t end;
+            while ((end = viewer.input.find('\n')) != std::string::npos) {
+                handle(viewer.input.substr(0, end));
+                viewer.input.erase(0, end + 1);
+            }
+        }
+
+        // Send the new frames.
+        std::deque<Frame> ready;
+        bool stop;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.swap(frames);
+            stop = quit;
+        }
+        for (const Frame& frame : ready) {
+            for (Viewer& viewer : list) {
+                if (viewer.fd >= 0 && !send(viewer, frame)) {
+                    ::close(viewer.fd);
+                    viewer.fd = -1;
+                }
+            }
+        }
+
+        list.erase(std::remove_if(list.begin(), list.end(),
+                                  []( const Viewer& viewer ) {
+                                      return viewer.fd < 0;
+                                  }),
+                   list.end());
+        viewers = list.size();
+
+        if (stop) {
+            break;
+        }
+    }
+
+    for (Viewer& viewer : list) {
+        ::close(viewer.fd);
+    }
+}
+
+void Stream::handle( const std::string& line ) {
+
+    std::istringstream words(line);
+    std::string command;
+    words >> command;
+
+    if (command == "key") {
+        std::string name;
+        words >> name;
+        const char* key = name.size() == 1 ?
+            std::strchr(streamKeys, std::toupper(name[0])) : nullptr;
+        if (key != nullptr && *key != '\0') {
+            std::lock_guard<std::mutex> lock(mutex);
+            keys.push_back(SDL_SCANCODE_A + (*key - 'A'));
+        }
+    }
+    else if (command == "view") {
+        int values[4];
+        if (words >> values[0] >> values[1] >> values[2] >> values[3]) {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::copy(values, values + 4, region);
+        }
+    }
+}
+
+bool Stream::send( Viewer& viewer, const Frame& frame ) {
+
+    PROFILE_SCOPE("send stream frame");
+
+    // The RGB bytes, XORed with the last frame sent to the viewer.
+    const size_t cells = (size_t) frame.header.width * frame.header.height;
+    std::vector<uint8_t> rgb(cells * 3), delta(cells * 3);
+    const bool keyFrame = viewer.previous.size() != rgb.size();
+    for (size_t i = 0; i < cells; ++i) {
+        for (size_t c = 0; c < 3; ++c) {
+            rgb[3 * i + c] = frame.pixels[4 * i + c];
+            delta[3 * i + c] = rgb[3 * i + c] ^
+                               (keyFrame ? 0 : viewer.previous[3 * i + c]);
+        }
+    }
+
+    std::vector<uint8_t> data;
+    encode(delta, data);
+
+    StreamHeader header = frame.header;
+    header.size = data.size();
+    if (keyFrame) {
+        header.flags |= KeyFrame;
+    }
+
+    if (!sendAll(viewer.fd, &header, sizeof header) ||
+        !sendAll(viewer.fd, data.data(), data.size())) {
+        return false;
+    }
+
+    viewer.previous.swap(rgb);
+    sent++;
+    bytes += sizeof header + data.size();
+    return true;
+}
@@ -0,0 +1,196 @@
+/**
+ * Streaming the visualisation to remote viewers.
+ *
+ * @file stream.hpp
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lbm.hpp"
+
+namespace pcs {
+
+    /**
+     * The header of every frame sent to a viewer, followed by `size` bytes
+     * of pixel data. All values are little endian.
+     *
+     * The pixels are the RGB bytes of the frame, rows bottom up, XORed
+     * with the previous frame sent to the same viewer (or with zeros for a
+     * key frame), and run length encoded as a sequence of: a uint16 amount
+     * of zero bytes, a uint16 amount of literal bytes, and those bytes.
+     */
+    struct StreamHeader {
+        char magic[4];        // "PCSV"
+        uint32_t size;        // The bytes of pixel data which follow.
+        uint32_t width, height;
+        uint32_t frame;
+        uint32_t flags;       // See the `Stream::Flag` values.
+        float mlups;          // The throughput since the last frame.
+        int32_t region[4];    // The x, y, width and height of the shown
+                              // region, in cells.
+        uint32_t latticeWidth, latticeHeight;
+    };
+
+    /**
+     * The Stream class publishes the visualisation of the model to viewers
+     * (see `src/viewer`), which connect to a local TCP port or Unix domain
+     * socket, at a limited frame rate.
+     *
+     * Frames are rendered and read back like the frames of a `Capture`, at
+     * the stream resolution and of the region of the lattice the viewer
+     * asks for, so zoomed out views use the display pyramid. The encoding
+     * and sending happens on a separate thread, and frames are dropped
+     * rather than waited for, so the simulation never waits for a viewer.
+     *
+     * Viewers send commands as lines of text:
+     *  - `key {{name}}` presses one of the toggle keys Q, W, E, R, T, P, F,
+     *    G, O or A, as in the window.
+     *  - `view {{x}} {{y}} {{width}} {{height}}` sets the region of the
+     *    lattice to show.
+     */
+    class Stream {
+
+        // A pixel buffer of the ring, see `Capture`.
+        struct Slot {
+            GLuint pbo;
+            GLsync fence;
+            StreamHeader header;
+        };
+
+        // A frame waiting to be sent.
+        struct Frame {
+            std::vector<uint8_t> pixels; // RGBA rows bottom up.
+            StreamHeader header;
+        };
+
+        // A connected viewer, with its unfinished command and the last
+        // frame it was sent.
+        struct Viewer {
+            int fd;
+            std::string input;
+            std::vector<uint8_t> previous;
+        };
+
+    public:
+
+        // The bits of `StreamHeader::flags`: the four settings, followed by
+        // these, and the `LatticeBoltzmann::View` from bit 8 on.
+        enum Flag { Paused = 1 << 4, KeyFrame = 1 << 5 };
+
+        /**
+         * Open the socket and start the sending thread.
+         *
+         * @param address A port number for a local TCP port, or otherwise
+         *                the path of a Unix domain socket
+         * @param width The width of the streamed frames
+         * @param height The height of the streamed frames
+         * @param fps The maximum amount of frames per second
+         * @param depth The amount of pixel buffers in the ring
+         */
+        Stream( const std::string& address, int width, int height,
+                double fps = 10.0, size_t depth = 3 );
+
+        // The GPU memory of the render target and the pixel buffers.
+        static inline size_t streamMemory( int width, int height,
+                                           size_t depth = 3 ) {
+            return (1 + std::max<size_t>(1, depth)) * width * height * 4;
+        }
+
+        /**
+         * Stop the thread and close the socket and all viewers.
+         */
+        void close();
+
+        /**
+         * If a frame should be published: a viewer is connected, and the
+         * last frame was at least 1 / fps seconds ago.
+         */
+        bool due() const;
+
+        /**
+         * Render and read back the current frame of the model, to be sent
+         * once the read back has finished.
+         *
+         * @param renderer The OpenGL instance
+         * @param lbm The model
+         */
+        void publish( GLRenderer& renderer, LatticeBoltzmann& lbm );
+
+        /**
+         * Add the keys pressed by viewers since the last call to the input,
+         * as pressed this frame.
+         *
+         * @param input The input to add to
+         */
+        void pollKeys( InputData& input );
+
+        // Statistics getters.
+        inline bool isOpen() const { return listener >= 0; }
+        inline size_t getSent() const { return sent; }
+        inline size_t getBytes() const { return bytes; }
+
+    private:
+
+        /**
+         * Move the frames of the finished read backs to the sending thread,
+         * dropping the oldest frame if it is behind.
+         */
+        void retire();
+
+        /**
+         * The loop of the sending thread, which accepts viewers, handles
+         * their commands and sends the frames.
+         */
+        void run();
+
+        /**
+         * Handle a line of commands from a viewer. Called on the sending
+         * thread.
+         */
+        void handle( const std::string& line );
+
+        /**
+         * Encode and send a frame to a viewer. Called on the sending thread.
+         *
+         * @return False if the viewer disconnected.
+         */
+        bool send( Viewer& viewer, const Frame& frame );
+
+        int width, height;
+        std::chrono::duration<double> interval;
+        std::string socketPath;
+        int listener;
+        int wake[2]; // A pipe to wake up the sending thread.
+
+        // The offscreen render target and the ring of pixel buffers.
+        GLuint texture;
+        std::vector<Slot> slots;
+        size_t next, inFlight;
+
+        // The throughput since the last published frame.
+        std::chrono::steady_clock::time_point lastTime;
+        unsigned lastFrame;
+
+        // Shared with the sending thread.
+        std::atomic<size_t> sent, bytes, viewers;
+        std::deque<Frame> frames;
+        std::vector<int> keys;
+        int region[4];      // The shown region, or zero width for all.
+        bool quit;
+        std::thread thread;
+        std::mutex mutex;
+    };
+}
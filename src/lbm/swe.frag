@@ -0,0 +1,226 @@
+/**
+ * The shallow water model: a depth averaged lattice Boltzmann model of the
+ * shallow water equations (LABSWE, J.G. Zhou, "Lattice Boltzmann Methods
+ * for Shallow Water Flows", 2004), on the same D2Q9 lattice and textures
+ * as `lbm.frag`. The conserved quantity is the water depth, which is
+ * stored in place of the density, and the elevation of the bed enters as
+ * a force.
+ *
+ * The cells above the water surface are walls, with the same bounce back
+ * as `lbm.frag`, so the shoreline does not move. The slope setting drives
+ * the flow down the x direction, balanced by the friction of the bed.
+ *
+ * @file swe.frag
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#version 430
+
+precision highp float;
+precision highp usampler2D;
+
+in vec2 v_tex_coords;
+
+layout(location = 0) out uvec4 o_color[7];
+
+// The same locations as in `lbm.frag`.
+layout(location = 3) uniform usampler2D u_textures[7];
+layout(location = 10) uniform bvec4 u_settings;
+layout(location = 13) uniform double u_viscosity;
+layout(location = 15) uniform bool u_display;  // Write the display image.
+
+layout(location = 16) uniform sampler2D u_elevation; // The bed, 0 to 1.
+layout(location = 17) uniform double u_relief;  // The bed range in cells.
+layout(location = 18) uniform double u_surface; // The water surface, 0 to 1.
+layout(location = 19) uniform bool u_initialise; // Set still water.
+
+// The visualisation, written when `u_display` is set.
+layout(binding = 0, rgba8) uniform writeonly image2D u_display_image;
+
+
+// Some constants, in lattice units.
+const double g = 0.1;                 // Gravity
+const double bed_friction = 0.003;    // Friction coefficient of the bed
+const double bed_slope = 1e-4;        // The slope of the slope setting
+const dvec2 u0 = dvec2(0.05, 0.0);    // In-flow speed of the sources
+const double h_min = 1e-6;            // The least depth, against dividing by 0
+const double h_dry = 0.01;            // Shallower cells are walls, relative
+                                      // to the relief
+
+// f_i directions.
+const ivec2 e[9] = ivec2[9](ivec2(0, 0),  ivec2(1, 0),   ivec2(0, 1),
+                            ivec2(-1, 0), ivec2(0, -1),  ivec2(1, 1),
+                            ivec2(-1, 1), ivec2(-1, -1), ivec2(1, -1));
+
+// The weights of the equilibrium of LABSWE, for the rest, the axis and the
+// diagonal directions.
+const double w[9] = double[9](1., 1. / 6., 1. / 6., 1. / 6., 1. / 6.,
+                              1. / 24., 1. / 24., 1. / 24., 1. / 24.);
+
+
+// Get the first and second double from a texture.
+double get1f( in usampler2D textr, in ivec2 loc ) {
+    return packDouble2x32(texelFetch(textr, loc, 0).rg);
+}
+
+double get2f( in usampler2D textr, in ivec2 loc ) {
+    return packDouble2x32(texelFetch(textr, loc, 0).ba);
+}
+
+// The LABSWE equilibrium, with c = 1.
+double calc_feq( in uint i, in double h, in dvec2 u ) {
+    double udotu = dot(u, u);
+    if (i == 0) {
+        return h - 5.0 * g * h * h / 6.0 - 2.0 * h * udotu / 3.0;
+    }
+    double edotu = dot(dvec2(e[i]), u);
+    return w[i] * (g * h * h + 2.0 * h * edotu + 3.0 * h * edotu * edotu -
+                   h * udotu);
+}
+
+
+void main() {
+
+    ivec2 texture_size = textureSize(u_textures[0], 0);
+    ivec2 loc = ivec2(gl_FragCoord.xy);
+
+    uvec4 gridData = texelFetch(u_textures[0], loc, 0);
+    bool isIndestructible = gridData.r != 0;
+    bool addWall = gridData.g != 0;
+    bool isSource = gridData.b != 0;
+    bool isWall = gridData.a != 0;
+
+    // The elevation of the bed and the still water depth, in cells.
+    double bed = double(texelFetch(u_elevation, loc, 0).r) * u_relief;
+    double depth = max(u_surface * u_relief - bed, h_min);
+
+    double f[9];
+    double h = 0.0;
+    dvec2 u = dvec2(0.0);
+
+    if (u_initialise) {
+
+        // The cells which are too shallow to simulate become walls.
+        if (depth < h_dry * u_relief) {
+            addWall = !isWall;
+        }
+
+        // Still water up to the surface. The walls bounce back the still
+        // water of their neighbours, as if they were filled up.
+        h = depth;
+        if (isWall || addWall) {
+            h = 0.0;
+            for (uint i = 1; i < 9; i++) {
+                ivec2 nb = (loc + e[i] + texture_size) % texture_size;
+                double nb_bed = double(texelFetch(u_elevation, nb, 0).r) *
+                                u_relief;
+                h = max(h, u_surface * u_relief - nb_bed);
+            }
+            h = max(h, h_min);
+        }
+        for (uint i = 0; i < 9; i++) {
+            f[i] = calc_feq(i, h, u);
+        }
+    }
+    else {
+        // Get the f values and stream at the same time.
+        for (uint i = 0; i < 9; i++) {
+            ivec2 from = (loc - e[i] + texture_size) % texture_size;
+            f[i] = i % 2 == 1 ? get1f(u_textures[3 + (i - 1) / 2], from)
+                              : get2f(u_textures[2 + i / 2], from);
+        }
+
+        // Make the wall.
+        if (addWall) {
+            isWall = true;
+            addWall = false;
+            for (uint i = 1; i < 9; i++) {
+                f[i] = -abs(f[i]);
+            }
+        }
+
+        // The depth and velocity.
+        for (uint i = 0; i < 9; i++) {
+            h += abs(f[i]);
+            u += dvec2(e[i]) * abs(f[i]);
+        }
+        u /= max(h, h_min);
+
+        // Collision, with the bed slope between the cell and the cell the
+        // f_i value streams to, evaluated at their middle (the centred
+        // scheme of LABSWE), and the friction and slope force. The
+        // friction is limited to stopping the flow, which it would
+        // overshoot in shallow water.
+        if (!isWall) {
+            double omega = 2 / (6 * u_viscosity + 1);
+            dvec2 force = -h * u * min(bed_friction * length(u) /
+                                       max(h, h_min), 1.0);
+            if (u_settings[3]) {
+                force.x += g * h * bed_slope;
+            }
+            for (uint i = 0; i < 9; i++) {
+                f[i] = (1 - omega) * abs(f[i]) + omega * calc_feq(i, h, u);
+                if (i > 0) {
+                    ivec2 to = (loc + e[i] + texture_size) % texture_size;
+                    f[i] += dot(dvec2(e[i]), force) / 6.0;
+                    if (texelFetch(u_textures[0], to, 0).a == 0) {
+                        double bed_to = double(texelFetch(u_elevation, to,
+                                                          0).r) * u_relief;
+                        double h_to = get1f(u_textures[2], to);
+                        f[i] -= g * (h + h_to) / 2.0 * (bed_to - bed) / 6.0;
+                    }
+                }
+
+                // The f_i values of the fluid are non-negative, as walls
+                // store theirs negated. The equilibrium of f0 becomes
+                // negative in deep water (h > 6 / (5 g) at rest), so it is
+                // clamped as well.
+                f[i] = max(0.0, f[i]);
+            }
+        }
+
+        // Wall bounce back, as in `lbm.frag`, without the collision.
+        else {
+            double f2[9] = double[9](abs(f[0]), abs(f[1]), abs(f[2]),
+                                     abs(f[3]), abs(f[4]), abs(f[5]),
+                                     abs(f[6]), abs(f[7]), abs(f[8]));
+            f[2] = -f2[4];
+            f[3] = -f2[1];
+            f[4] = -f2[2];
+            f[1] = -f2[3];
+            f[6] = -f2[8];
+            f[7] = -f2[5];
+            f[8] = -f2[6];
+            f[5] = -f2[7];
+        }
+
+        // Flow to the right, at the still water depth.
+        if (u_settings[0] && isSource) {
+            u = u0;
+            h = depth;
+            for (uint i = 0; i < 9; i++) {
+                f[i] = calc_feq(i, h, u);
+            }
+        }
+    }
+
+
+    // Ouput to the textures, with the depth in place of the density.
+    o_color[0] = uvec4(isIndestructible, addWall, isSource, isWall);
+    o_color[1] = uvec4(unpackDouble2x32(u.x),  unpackDouble2x32(u.y));
+    o_color[2] = uvec4(unpackDouble2x32(h),    unpackDouble2x32(f[0]));
+    o_color[3] = uvec4(unpackDouble2x32(f[1]), unpackDouble2x32(f[2]));
+    o_color[4] = uvec4(unpackDouble2x32(f[3]), unpackDouble2x32(f[4]));
+    o_color[5] = uvec4(unpackDouble2x32(f[5]), unpackDouble2x32(f[6]));
+    o_color[6] = uvec4(unpackDouble2x32(f[7]), unpackDouble2x32(f[8]));
+
+    // Write the visualisation, the same as `lbm.frag`.
+    if (u_display) {
+        vec4 color = isWall ? vec4(251./255., 243./255., 239./255., 1.0)
+                            : vec4(vec3(length(vec2(u)) * 4.0), 1.0);
+        imageStore(u_display_image, loc, color);
+    }
+}
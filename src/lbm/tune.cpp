@@ -0,0 +1,338 @@
+/**
+ * The autotuner. See tune.hpp for details.
+ *
+ * @file tune.cpp
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#include "tune.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "importer.hpp"
+#include "../print.hpp"
+
+using namespace pcs;
+
+
+// The candidates, see `runAutotune()`.
+static const int tileSizes[] = {0, 512, 256, 128, 64};
+static const unsigned blockSteps[] = {2, 3, 4};
+static const unsigned framesteps[] = {1, 2, 5, 10, 20, 50};
+
+// The framestep is the smallest within this fraction of the fastest.
+static constexpr double framestepTolerance = 0.9;
+
+
+// Get an OpenGL string, like the vendor or renderer.
+static std::string glString( GLenum name ) {
+    const GLubyte* str = glGetString(name);
+    return str == nullptr ? "" : std::string((const char*) str);
+}
+
+// Parse a line of the cache: the width and height, followed by key=value
+// pairs. Returns false if it is not an entry, or if a value is invalid: the
+// framestep and block must be at least 1 (and the block at most
+// `LatticeBoltzmann::maxBlockSteps`), the tile size can be 0 for no tiles.
+static bool parseEntry( const std::string& line, int& width, int& height,
+                        TuneConfig& config ) {
+    std::istringstream words(line);
+    std::string word;
+    unsigned w, h;
+    if (!(words >> word) || !parseNumber(word, w) || w == 0 ||
+        !(words >> word) || !parseNumber(word, h) || h == 0) {
+        return false;
+    }
+    width = w;
+    height = h;
+
+    while (words >> word) {
+        const size_t split = word.find('=');
+        const std::string key = word.substr(0, split);
+        const std::string value = split == std::string::npos ?
+                                  "" : word.substr(split + 1);
+        unsigned number;
+        if (key == "fused") {
+            if (value != "0" && value != "1") return false;
+            config.fusedDisplay = value == "1";
+            continue;
+        }
+        if (key != "framestep" && key != "tile" && key != "block") {
+            continue;
+        }
+        if (!parseNumber(value, number)) {
+            return false;
+        }
+        if (key == "framestep") {
+            if (number < 1) return false;
+            config.framestep = number;
+        }
+        else if (key == "tile") {
+            if (number > (unsigned) INT_MAX) return false;
+            config.tileSize = number;
+        }
+        else {
+            if (number < 1 || number > LatticeBoltzmann::maxBlockSteps) {
+                return false;
+            }
+            config.blockSteps = number;
+        }
+    }
+    return true;
+}
+
+// Run the loop of the window for about `steps` frames, rendering the
+// display to `target`, and return the throughput in MLUPS.
+static double measure( GLRenderer& renderer, LatticeBoltzmann& lbm,
+                       const TuneConfig& config, GLuint target,
+                       int targetWidth, int targetHeight, unsigned steps ) {
+
+    applyTuning(lbm, config);
+    const unsigned loops = std::max(1u, steps / config.framestep);
+    auto loop = [&]() {
+        lbm.step(renderer, config.framestep);
+        renderer.renderToTexture(target);
+        lbm.renderFields(renderer, 0.f, 0.f, targetWidth, targetHeight,
+                         targetWidth, targetHeight);
+    };
+
+    // Warm up, so that the fused display texture and such exist.
+    for (unsigned i = 0; i < std::max(1u, loops / 10); ++i) {
+        loop();
+    }
+    glFinish();
+
+    const auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < loops; ++i) {
+        loop();
+    }
+    glFinish();
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    const double mlups = (double) lbm.getWidth() * lbm.getHeight() *
+                         loops * config.framestep / elapsed.count() / 1e6;
+    print("  framestep", config.framestep, "tile", config.tileSize,
+          "fused", config.fusedDisplay, "block", config.blockSteps, ":",
+          mlups, "MLUPS");
+    return mlups;
+}
+
+
+std::string pcs::tuneCachePath() {
+
+    std::string directory;
+    if (const char* cache = std::getenv("XDG_CACHE_HOME")) {
+        directory = cache;
+    }
+    else if (const char* home = std::getenv("HOME")) {
+        directory = std::string(home) + "/.cache";
+    }
+    else {
+        directory = ".";
+    }
+    directory += "/pcs-lbm";
+
+    // Name the file after the device, keeping it a plain file name.
+    std::string device = glString(GL_VENDOR) + "-" + glString(GL_RENDERER);
+    for (char& c : device) {
+        if (!std::isalnum((unsigned char) c) && c != '-' && c != '.') {
+            c = '_';
+        }
+    }
+    return directory + "/" + device + ".tune";
+}
+
+bool pcs::loadTuning( const std::string& path, int width, int height,
+                      TuneConfig& config ) {
+
+    std::ifstream file(path);
+    const double cells = (double) width * height;
+    double closest = -1.0;
+    for (std::string line; std::getline(file, line);) {
+        int w, h;
+        TuneConfig entry;
+        if (line.empty() || line[0] == '#' ||
+            !parseEntry(line, w, h, entry)) {
+            continue;
+        }
+
+        // The same size always wins, otherwise the closest amount of cells
+        // on a logarithmic scale.
+        const double distance = w == width && h == height ?
+                                0.0 : std::abs(std::log(w * (double) h /
+                                                        cells)) + 1e-9;
+        if (closest < 0.0 || distance < closest) {
+            closest = distance;
+            config = entry;
+        }
+    }
+    return closest >= 0.0;
+}
+
+void pcs::applyTuning( LatticeBoltzmann& lbm, const TuneConfig& config ) {
+    lbm.setFramestep(config.framestep);
+    lbm.setTileSize(config.tileSize);
+    lbm.setFusedDisplay(config.fusedDisplay);
+    lbm.setBlockSteps(config.blockSteps);
+}
+
+int pcs::runAutotune( GLRenderer& renderer, const std::string& riverFile,
+                      double waterLevel, const std::string& path,
+                      unsigned steps ) {
+
+    MapImporter importer = MapImporter(riverFile, waterLevel);
+    GLuint flags = 0;
+    if (importer.isOpen()) {
+        flags = gl::genUTexture(importer.getWidth(), importer.getHeight());
+        if (!importer.upload(flags)) {
+            glDeleteTextures(1, &flags);
+            flags = 0;
+        }
+    }
+    const int width = importer.getWidth(), height = importer.getHeight();
+    importer.close();
+    if (flags == 0) {
+        print(INFO_, "Failed to import", riverFile);
+        return 1;
+    }
+
+    LatticeBoltzmann lbm = LatticeBoltzmann(renderer, flags, width, height);
+
+    // The display is rendered at most at the size of a large window.
+    const float scale = std::min(1.f, 1024.f / std::max(width, height));
+    const int targetWidth = std::max(1, (int) (width * scale));
+    const int targetHeight = std::max(1, (int) (height * scale));
+    const GLuint target = gl::genTexture(targetWidth, targetHeight);
+
+    print("Tuning for", glString(GL_RENDERER), "on a lattice of", width,
+          "x", height);
+
+    // Tune the tile size, then the temporal blocking (which replaces the
+    // tiles, if it is faster), then the fused display, with the default
+    // framestep.
+    TuneConfig best;
+    double bestMlups = 0.0;
+    for (int tileSize : tileSizes) {
+        if (tileSize >= std::max(width, height)) {
+            continue;
+        }
+        TuneConfig config = best;
+        config.tileSize = tileSize;
+        const double mlups = measure(renderer, lbm, config, target,
+                                     targetWidth, targetHeight, steps);
+        if (mlups > bestMlups) {
+            bestMlups = mlups;
+            best = config;
+        }
+    }
+    for (unsigned block : blockSteps) {
+
+        // Without the compute shader, `step()` would run single frames.
+        if (!lbm.hasBlocking()) {
+            break;
+        }
+        TuneConfig config = best;
+        config.tileSize = 0;
+        config.blockSteps = block;
+        const double mlups = measure(renderer, lbm, config, target,
+                                     targetWidth, targetHeight, steps);
+        if (mlups > bestMlups) {
+            bestMlups = mlups;
+            best = config;
+        }
+    }
+    {
+        TuneConfig config = best;
+        config.fusedDisplay = !best.fusedDisplay;
+        const double mlups = measure(renderer, lbm, config, target,
+                                     targetWidth, targetHeight, steps);
+        if (mlups > bestMlups) {
+            bestMlups = mlups;
+            best = config;
+        }
+    }
+
+    // Take the smallest framestep which is nearly as fast as the fastest.
+    std::vector<double> results;
+    double fastest = 0.0;
+    for (unsigned framestep : framesteps) {
+        TuneConfig config = best;
+        config.framestep = framestep;
+        results.push_back(measure(renderer, lbm, config, target,
+                                  targetWidth, targetHeight, steps));
+        fastest = std::max(fastest, results.back());
+    }
+    for (size_t i = 0; i < results.size(); ++i) {
+        if (results[i] >= framestepTolerance * fastest) {
+            best.framestep = framesteps[i];
+            bestMlups = results[i];
+            break;
+        }
+    }
+
+    glDeleteTextures(1, &target);
+    lbm.close();
+    renderer.renderToScreen();
+    if (gl::checkErrors("autotune")) {
+        return 1;
+    }
+
+    // Replace the entry of this size in the cache, keeping the others.
+    std::vector<std::string> lines;
+    {
+        std::ifstream file(path);
+        for (std::string line; std::getline(file, line);) {
+            int w, h;
+            TuneConfig entry;
+            if (!line.empty() && line[0] != '#' &&
+                parseEntry(line, w, h, entry) &&
+                (w != width || h != height)) {
+                lines.push_back(line);
+            }
+        }
+    }
+    std::stringstream entry;
+    entry << width << " " << height << " framestep=" << best.framestep
+          << " tile=" << best.tileSize << " fused=" << best.fusedDisplay
+          << " block=" << best.blockSteps << " mlups=" << bestMlups;
+    lines.push_back(entry.str());
+
+    const size_t slash = path.rfind('/');
+    if (slash != std::string::npos) {
+        // Create the directories of the path, one at a time.
+        for (size_t i = 1; i <= slash; ++i) {
+            if (path[i] == '/') {
+                mkdir(path.substr(0, i).c_str(), 0755);
+            }
+        }
+    }
+    std::ofstream out(path);
+    out << "# Tuned configurations of " << glString(GL_RENDERER)
+        << ", see src/lbm/tune.hpp\n";
+    for (const std::string& line : lines) {
+        out << line << "\n";
+    }
+    if (!out) {
+        print(INFO_, "Failed to write the tuning cache", path);
+        return 1;
+    }
+
+    print("Tuned framestep", best.framestep, "tile", best.tileSize, "fused",
+          best.fusedDisplay, "block", best.blockSteps, "at", bestMlups,
+          "MLUPS, written to", path);
+    return 0;
+}
@@ -0,0 +1,83 @@
+/**
+ * Tuning the submission of the work to the device.
+ *
+ * @file tune.hpp
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#pragma once
+
+#include <string>
+
+#include "lbm.hpp"
+
+namespace pcs {
+
+    /**
+     * A configuration of how the work is submitted, see
+     * `LatticeBoltzmann::setFramestep()`, `setTileSize()`,
+     * `setFusedDisplay()` and `setBlockSteps()`.
+     */
+    struct TuneConfig {
+        unsigned framestep = 10;
+        int tileSize = 0;
+        bool fusedDisplay = false;
+        unsigned blockSteps = 1;
+    };
+
+    /**
+     * Get the default path of the tuning cache of the current device: a file
+     * named after the OpenGL vendor and renderer in `$XDG_CACHE_HOME/pcs-lbm`
+     * or `~/.cache/pcs-lbm`.
+     *
+     * @return The path
+     */
+    std::string tuneCachePath();
+
+    /**
+     * Find the tuned configuration for a lattice size in a cache file: the
+     * entry of the same size, or else of the closest amount of cells.
+     *
+     * @param path The path of the cache file
+     * @param width The width of the lattice
+     * @param height The height of the lattice
+     * @param config Returns the configuration
+     * @return False if the cache has no entries.
+     */
+    bool loadTuning( const std::string& path, int width, int height,
+                     TuneConfig& config );
+
+    /**
+     * Apply a configuration to a lattice.
+     *
+     * @param lbm The model
+     * @param config The configuration
+     */
+    void applyTuning( LatticeBoltzmann& lbm, const TuneConfig& config );
+
+    /**
+     * Benchmark the configurations on a river file, and store the fastest
+     * in the cache file, replacing the entry of the same size.
+     *
+     * Every configuration runs the loop of the window, simulating
+     * `framestep` frames and rendering the display offscreen, for about
+     * `steps` frames. The tile size is tuned first, then the temporal
+     * blocking (if the compute shader is available), the fused display,
+     * and finally the framestep. The framestep trades throughput for
+     * responsiveness, so the smallest one within 10% of the fastest is
+     * chosen.
+     *
+     * @param renderer The OpenGL instance
+     * @param riverFile The river file, whose size is tuned for
+     * @param waterLevel The water level, if it is a heightmap
+     * @param path The path of the cache file
+     * @param steps The frames to time per configuration
+     * @return The exit code, 0 on success.
+     */
+    int runAutotune( GLRenderer& renderer, const std::string& riverFile,
+                     double waterLevel, const std::string& path,
+                     unsigned steps );
+}
@@ -0,0 +1,62 @@
+/**
+ * A physics validation suite, which checks the simulation against known
+ * results and records the performance alongside the errors.
+ *
+ * @file validate.hpp
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#pragma once
+
+#include <string>
+
+#include "../opengl/opengl.hpp"
+
+namespace pcs {
+
+    /**
+     * Options for a validation run.
+     */
+    struct ValidateOptions {
+        unsigned maxSteps = 200000; // Maximum frames per case.
+        unsigned interval = 1000;   // Frames between convergence checks.
+        double tolerance = 1e-5;    // Relative change for convergence.
+        std::string output = "build/validate.json"; // Path of the results.
+    };
+
+    /**
+     * Run the validation cases without a window:
+     *  - Poiseuille: `assets/poiseuille.bmp` driven by the slope is run until
+     *    the velocity profile through the middle of the tube has converged,
+     *    and its shape is compared against the analytic parabola.
+     *  - Mass conservation: during the Poiseuille case (no sources, periodic
+     *    boundaries) the total density must stay constant.
+     *  - Both are repeated with the TRT and MRT collision operators (see
+     *    `LatticeBoltzmann::setCollision()`).
+     *  - Omega bias: the flow through the top of the bend in
+     *    `assets/Omega.bmp` must be biased towards the inner bank, by 1 to
+     *    5 percent of the half width of the channel.
+     *  - Temporal blocking: `assets/river.bmp` with erosion and
+     *    sedimentation must reach exactly the same state in 101 frames
+     *    with blocks of 4 frames as with a pass per frame.
+     *  - Wall reset: a script erodes `assets/river.bmp` for an odd amount
+     *    of frames and presses `O`, after which the walls must be exactly
+     *    the initial ones.
+     *  - Sediment conservation: with the suspended sediment, after the
+     *    sources of `assets/river.bmp` are turned off, the suspended,
+     *    settled and deposited sediment must stay the same while the
+     *    walls erode and the sediment settles.
+     *
+     * For every case the error, the frames and time until convergence, and
+     * the MLUPS are printed and written to a JSON file, so both the accuracy
+     * and speed of a change are checked in a single run.
+     *
+     * @param renderer The OpenGL instance
+     * @param options The validation options
+     * @return The exit code, 0 if all checks passed.
+     */
+    int runValidation( GLRenderer& renderer, const ValidateOptions& options );
+}
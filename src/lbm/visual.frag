@@ -18,6 +18,13 @@ layout(location = 0) out vec4 o_color;
 
 layout(location = 2) uniform vec4 u_color;
 layout(location = 3) uniform usampler2D u_textures[7];
+layout(location = 10) uniform int u_view; // See `LatticeBoltzmann::View`.
+layout(location = 11) uniform usampler2D u_derived[3];
+
+// The scales of the derived fields, for which the colours saturate.
+const float vorticity_scale = 0.02;
+const float strain_scale = 0.05;
+const float shear_scale = 0.02;
 
 
 void main() {
@@ -33,9 +40,30 @@ void main() {
     vec2 u = vec2(float(packDouble2x32(color_1.rg)),
                     float(packDouble2x32(color_1.ba)));
 
-    if (isWall) {
+    // The derived fields, see `derived.frag`.
+    uvec4 derived_0 = texture(u_derived[0], v_tex_coords);
+    uvec4 derived_2 = texture(u_derived[2], v_tex_coords);
+
+    if (u_view == 3) {
+        // The shear on the walls, on top of a dimmed velocity.
+        float shear = float(packDouble2x32(derived_2.ba)) / shear_scale;
+        o_color = isWall ? vec4(mix(vec3(0.25, 0.2, 0.2), vec3(1.0, 0.6, 0.1),
+                                    clamp(shear, 0.0, 1.0)), 1.0)
+                         : vec4(vec3(length(u)), 1.0);
+    }
+    else if (isWall) {
         o_color = vec4(251./255., 243./255., 239./255., 1.0);
     }
+    else if (u_view == 1) {
+        // The vorticity, red for counterclockwise and blue for clockwise.
+        float vorticity = float(packDouble2x32(derived_0.rg)) /
+                          vorticity_scale;
+        o_color = vec4(max(vorticity, 0.0), 0.0, max(-vorticity, 0.0), 1.0);
+    }
+    else if (u_view == 2) {
+        float strain = float(packDouble2x32(derived_0.ba)) / strain_scale;
+        o_color = vec4(vec3(0.2, 1.0, 0.4) * strain, 1.0);
+    }
     else {
 
         o_color = vec4(u_color.rgb * length(u) * 4.0, u_color.a);
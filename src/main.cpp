@@ -10,8 +10,14 @@
  * @date 08-01-2020
  */
 
+#include <algorithm>
+#include <cstdio>
 #include <iostream>
 #include <cmath>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include <SDL2/SDL.h>
 
@@ -19,56 +25,713 @@
 #include "sdl/window.hpp"
 #include "sdl/input.hpp"
 #include "opengl/opengl.hpp"
+#include "opengl/profiler.hpp"
 
 #include "lbm/lbm.hpp"
+#include "lbm/batch.hpp"
+#include "lbm/bench.hpp"
+#include "lbm/validate.hpp"
+#include "lbm/decompose.hpp"
+#include "lbm/importer.hpp"
+#include "lbm/memory.hpp"
+#include "lbm/output.hpp"
+#include "lbm/capture.hpp"
+#include "lbm/morphology.hpp"
+#include "lbm/server.hpp"
+#include "lbm/stream.hpp"
+#include "lbm/script.hpp"
+#include "lbm/tune.hpp"
 
 using namespace pcs;
 
 
+// Run a function with a renderer in a hidden window, for runs without any
+// visual output. Returns the exit code of the function.
+template <typename Function>
+static int runHidden( const std::string& title, Function function ) {
+    Window window = createOpenGLWindow(title, 400, 400, true);
+    int code;
+    {
+        GLRenderer renderer = GLRenderer();
+        code = function(renderer);
+    }
+    destroyWindow(window);
+    print("~end~");
+    return code;
+}
+
+// Parse a comma separated list of integers, like "1,2,4".
+static std::vector<int> parseList( const std::string& list ) {
+    std::vector<int> values;
+    std::stringstream ss(list);
+    std::string value;
+    while (std::getline(ss, value, ',')) {
+        values.push_back(std::stoi(value));
+    }
+    return values;
+}
+
+
 int main( int argc, char** argv ) {
 
     print("~start~");
 
+    // Parse the command line arguments. Options are followed by a value,
+    // the other arguments are river files.
+    //   --seed {{seed}}    The seed for erosion and sedimentation.
+    //   --batch {{steps}}  Run all river files together without a window.
+    //   --bench            Benchmark all river files without a window.
+    //   --bench-steps {{steps}}, --bench-warmup {{steps}},
+    //   --bench-scales {{1,2,4}}, --bench-out {{file.json}}
+    //                      Options for the benchmark, see bench.hpp.
+    //   --validate         Run the physics validation suite.
+    //   --validate-steps {{steps}}, --validate-out {{file.json}}
+    //                      Options for the validation, see validate.hpp.
+    //   --viscosity {{viscosity}}  The viscosity of the fluid.
+    //   --collision {{bgk|trt|mrt}}  The collision operator of the flow.
+    //   --smagorinsky {{constant}}  Add the eddy viscosity of the Smagorinsky
+    //                      subgrid model, with a constant like 0.1.
+    //   --water-level {{level}}  The relative water level of heightmaps.
+    //   --model {{flow|swe}}  Simulate the flow with erosion, or the shallow
+    //                      water model on the elevation of heightmaps.
+    //   --relief {{cells}}  For the shallow water model, the height of the
+    //                      heightmap from its lowest to highest elevation.
+    //   --slabs {{count}}  Split the river file into slabs, which are run
+    //                      by worker processes without a window.
+    //   --slabs-steps {{steps}}  The frames to simulate with --slabs.
+    //   --dump-every {{frames}}  Save the fields every amount of frames.
+    //   --dump-dir {{directory}}, --dump-policy {{block|drop}}
+    //                      Options for saving fields, see output.hpp.
+    //   --capture {{file.y4m|directory}}  Record the visualisation.
+    //   --capture-every {{frames}}, --capture-size {{width}}x{{height}},
+    //   --capture-fps {{fps}}  Options for the capture, see capture.hpp.
+    //   --headless {{steps}}  Run without a window for an amount of frames,
+    //                      only saving fields and capturing.
+    //   --fused-display    Render the display in the last simulated frame.
+    //   --block-steps {{frames}}  Simulate this amount of frames per pass
+    //                      with temporal blocking, at most 4.
+    //   --suspended-sediment  Carry the sediment with the flow, instead of
+    //                      depositing it anywhere at random.
+    //   --refine {{factor}}  Refine the squares along the banks 2 to 4 times.
+    //   --refine-size {{cells}}, --refine-every {{frames}}  The size of the
+    //                      squares, and the frames between placing them.
+    //   --stats-every {{frames}}  Accumulate the time averaged statistics
+    //                      every amount of frames, saved with the fields.
+    //   --stats-from {{frame}}  Start the statistics from this frame.
+    //   --derived-every {{frames}}  Compute the derived fields every amount
+    //                      of frames, saved with the fields.
+    //   --view {{velocity|vorticity|strain|shear}}  The field to show.
+    //   --memory-budget {{MiB}}  The GPU memory the run may use, by default
+    //                      the free memory of the device, if it reports it.
+    //   --morphology-every {{frames}}  Measure the river every amount of
+    //                      frames, see morphology.hpp.
+    //   --morphology-out {{file.csv}}  The log of the measurements.
+    //   --stream {{port|socket}}  Stream the visualisation to viewers.
+    //   --stream-fps {{fps}}, --stream-size {{width}}x{{height}}
+    //                      Options for the stream, see stream.hpp.
+    //   --script {{file}}  Run an experiment script, see script.hpp.
+    //   --autotune         Tune the work submission for the river file on
+    //                      this device, and store it in the tuning cache.
+    //   --tune-steps {{steps}}  The frames to time per configuration.
+    //   --tune-cache {{file}}  The tuning cache, by default per device.
+    //   --no-tune          Do not use the tuning cache.
+    //   --profile {{file.json}}  Write a trace of the CPU and GPU timeline.
+    //   --profile-from {{frame}}, --profile-frames {{frames}}
+    //                      The frames to profile, see profiler.hpp.
+    //   --server {{socket}}  Run the job server on a Unix domain socket.
+    //   --server-slice {{frames}}, --server-jobs {{count}},
+    //   --server-pool {{count}}  Options for the server, see server.hpp.
+    std::vector<std::string> files;
+    unsigned seed = 0;
+    unsigned batchSteps = 0;
+    bool batch = false;
+    bool bench = false;
+    BenchOptions benchOptions;
+    bool validate = false;
+    ValidateOptions validateOptions;
+    double viscosity = 0.005;
+    LatticeBoltzmann::Collision collision = LatticeBoltzmann::Collision::BGK;
+    double smagorinsky = 0.0;
+    bool suspendedSediment = false;
+    unsigned refine = 1;
+    int refineSize = 32;
+    unsigned refineEvery = 500;
+    double waterLevel = 0.1;
+    LatticeBoltzmann::Model model = LatticeBoltzmann::Model::Flow;
+    double relief = 1.0;
+    int slabs = 0;
+    unsigned slabSteps = 1000;
+    unsigned dumpEvery = 0;
+    std::string dumpDir = "output";
+    OutputPolicy dumpPolicy = OutputPolicy::Drop;
+    std::string captureOutput;
+    unsigned captureEvery = 10;
+    int captureWidth = 0, captureHeight = 0;
+    int captureFps = 30;
+    unsigned headlessSteps = 0;
+    bool fusedDisplay = false;
+    unsigned blockSteps = 0;
+    unsigned statsEvery = 0;
+    unsigned statsFrom = 0;
+    unsigned derivedEvery = 0;
+    LatticeBoltzmann::View view = LatticeBoltzmann::View::Velocity;
+    size_t memoryBudget = 0;
+    unsigned morphologyEvery = 0;
+    std::string morphologyOutput;
+    std::string streamAddress;
+    double streamFps = 10.0;
+    int streamWidth = 0, streamHeight = 0;
+    std::string scriptFile;
+    bool autotune = false;
+    bool useTuning = true;
+    unsigned tuneSteps = 500;
+    std::string tuneCache;
+    std::string profileOutput;
+    unsigned profileFrom = 0, profileFrames = 1000;
+    std::string serverSocket;
+    ServerOptions serverOptions;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--seed" && i + 1 < argc) {
+            seed = std::stoul(argv[++i]);
+        }
+        else if (arg == "--batch" && i + 1 < argc) {
+            batch = true;
+            batchSteps = std::stoul(argv[++i]);
+        }
+        else if (arg == "--bench") {
+            bench = true;
+        }
+        else if (arg == "--bench-steps" && i + 1 < argc) {
+            benchOptions.steps = std::stoul(argv[++i]);
+        }
+        else if (arg == "--bench-warmup" && i + 1 < argc) {
+            benchOptions.warmup = std::stoul(argv[++i]);
+        }
+        else if (arg == "--bench-scales" && i + 1 < argc) {
+            benchOptions.scales = parseList(argv[++i]);
+        }
+        else if (arg == "--bench-out" && i + 1 < argc) {
+            benchOptions.output = argv[++i];
+        }
+        else if (arg == "--validate") {
+            validate = true;
+        }
+        else if (arg == "--validate-steps" && i + 1 < argc) {
+            validateOptions.maxSteps = std::stoul(argv[++i]);
+        }
+        else if (arg == "--validate-out" && i + 1 < argc) {
+            validateOptions.output = argv[++i];
+        }
+        else if (arg == "--viscosity" && i + 1 < argc) {
+            viscosity = std::stod(argv[++i]);
+        }
+        else if (arg == "--collision" && i + 1 < argc) {
+            const std::string name = argv[++i];
+            collision = name == "trt" ? LatticeBoltzmann::Collision::TRT :
+                        name == "mrt" ? LatticeBoltzmann::Collision::MRT :
+                                        LatticeBoltzmann::Collision::BGK;
+        }
+        else if (arg == "--smagorinsky" && i + 1 < argc) {
+            smagorinsky = std::stod(argv[++i]);
+        }
+        else if (arg == "--water-level" && i + 1 < argc) {
+            waterLevel = std::stod(argv[++i]);
+        }
+        else if (arg == "--model" && i + 1 < argc) {
+            model = std::string(argv[++i]) == "swe" ?
+                    LatticeBoltzmann::Model::ShallowWater :
+                    LatticeBoltzmann::Model::Flow;
+        }
+        else if (arg == "--relief" && i + 1 < argc) {
+            relief = std::stod(argv[++i]);
+        }
+        else if (arg == "--slabs" && i + 1 < argc) {
+            slabs = std::stoi(argv[++i]);
+        }
+        else if (arg == "--slabs-steps" && i + 1 < argc) {
+            slabSteps = std::stoul(argv[++i]);
+        }
+        else if (arg == "--dump-every" && i + 1 < argc) {
+            dumpEvery = std::stoul(argv[++i]);
+        }
+        else if (arg == "--dump-dir" && i + 1 < argc) {
+            dumpDir = argv[++i];
+        }
+        else if (arg == "--dump-policy" && i + 1 < argc) {
+            dumpPolicy = std::string(argv[++i]) == "block" ?
+                         OutputPolicy::Block : OutputPolicy::Drop;
+        }
+        else if (arg == "--capture" && i + 1 < argc) {
+            captureOutput = argv[++i];
+        }
+        else if (arg == "--capture-every" && i + 1 < argc) {
+            captureEvery = std::max(1ul, std::stoul(argv[++i]));
+        }
+        else if (arg == "--capture-size" && i + 1 < argc) {
+            std::sscanf(argv[++i], "%dx%d", &captureWidth, &captureHeight);
+        }
+        else if (arg == "--capture-fps" && i + 1 < argc) {
+            captureFps = std::stoi(argv[++i]);
+        }
+        else if (arg == "--headless" && i + 1 < argc) {
+            headlessSteps = std::stoul(argv[++i]);
+        }
+        else if (arg == "--fused-display") {
+            fusedDisplay = true;
+        }
+        else if (arg == "--block-steps" && i + 1 < argc) {
+            blockSteps = std::stoul(argv[++i]);
+        }
+        else if (arg == "--suspended-sediment") {
+            suspendedSediment = true;
+        }
+        else if (arg == "--refine" && i + 1 < argc) {
+            refine = std::stoul(argv[++i]);
+        }
+        else if (arg == "--refine-size" && i + 1 < argc) {
+            refineSize = std::stoi(argv[++i]);
+        }
+        else if (arg == "--refine-every" && i + 1 < argc) {
+            refineEvery = std::stoul(argv[++i]);
+        }
+        else if (arg == "--stats-every" && i + 1 < argc) {
+            statsEvery = std::stoul(argv[++i]);
+        }
+        else if (arg == "--stats-from" && i + 1 < argc) {
+            statsFrom = std::stoul(argv[++i]);
+        }
+        else if (arg == "--derived-every" && i + 1 < argc) {
+            derivedEvery = std::stoul(argv[++i]);
+        }
+        else if (arg == "--memory-budget" && i + 1 < argc) {
+            memoryBudget = (size_t) (std::stod(argv[++i]) * 1048576.0);
+        }
+        else if (arg == "--morphology-every" && i + 1 < argc) {
+            morphologyEvery = std::stoul(argv[++i]);
+        }
+        else if (arg == "--morphology-out" && i + 1 < argc) {
+            morphologyOutput = argv[++i];
+        }
+        else if (arg == "--stream" && i + 1 < argc) {
+            streamAddress = argv[++i];
+        }
+        else if (arg == "--stream-fps" && i + 1 < argc) {
+            streamFps = std::stod(argv[++i]);
+        }
+        else if (arg == "--stream-size" && i + 1 < argc) {
+            std::sscanf(argv[++i], "%dx%d", &streamWidth, &streamHeight);
+        }
+        else if (arg == "--script" && i + 1 < argc) {
+            scriptFile = argv[++i];
+        }
+        else if (arg == "--autotune") {
+            autotune = true;
+        }
+        else if (arg == "--tune-steps" && i + 1 < argc) {
+            tuneSteps = std::stoul(argv[++i]);
+        }
+        else if (arg == "--tune-cache" && i + 1 < argc) {
+            tuneCache = argv[++i];
+        }
+        else if (arg == "--no-tune") {
+            useTuning = false;
+        }
+        else if (arg == "--profile" && i + 1 < argc) {
+            profileOutput = argv[++i];
+        }
+        else if (arg == "--profile-from" && i + 1 < argc) {
+            profileFrom = std::stoul(argv[++i]);
+        }
+        else if (arg == "--profile-frames" && i + 1 < argc) {
+            profileFrames = std::stoul(argv[++i]);
+        }
+        else if (arg == "--server" && i + 1 < argc) {
+            serverSocket = argv[++i];
+        }
+        else if (arg == "--server-slice" && i + 1 < argc) {
+            serverOptions.sliceSteps = std::stoul(argv[++i]);
+        }
+        else if (arg == "--server-jobs" && i + 1 < argc) {
+            serverOptions.maxActive = std::stoul(argv[++i]);
+        }
+        else if (arg == "--server-pool" && i + 1 < argc) {
+            serverOptions.poolSize = std::stoul(argv[++i]);
+        }
+        else if (arg == "--view" && i + 1 < argc) {
+            const std::string name = argv[++i];
+            const char* names[] = {"velocity", "vorticity", "strain", "shear"};
+            for (int j = 0; j < LatticeBoltzmann::viewCount; ++j) {
+                if (name == names[j]) {
+                    view = (LatticeBoltzmann::View) j;
+                }
+            }
+        }
+        else {
+            files.push_back(arg);
+        }
+    }
+
+    // A batch run packs several river files into one lattice, and runs
+    // without showing a window.
+    if (batch) {
+        return runHidden("LBM batch", [&]( GLRenderer& renderer ) {
+            return runBatch(renderer, files, batchSteps, seed, viscosity,
+                            waterLevel);
+        });
+    }
+
+    // The benchmark runs a fixed matrix of cases for every river file.
+    if (bench) {
+        benchOptions.waterLevel = waterLevel;
+        return runHidden("LBM benchmark", [&]( GLRenderer& renderer ) {
+            return runBenchmark(renderer, files, benchOptions);
+        });
+    }
+
+    // The validation suite uses fixed river files and parameters.
+    if (validate) {
+        return runHidden("LBM validation", [&]( GLRenderer& renderer ) {
+            return runValidation(renderer, validateOptions);
+        });
+    }
+
+    // The job server keeps one hidden context for all jobs. The window is
+    // needed for the output threads of the jobs.
+    if (!serverSocket.empty()) {
+        Window window = createOpenGLWindow("LBM server", 400, 400, true);
+        int code;
+        {
+            GLRenderer renderer = GLRenderer();
+            code = runServer(window, renderer, serverSocket, serverOptions);
+        }
+        destroyWindow(window);
+        print("~end~");
+        return code;
+    }
+
     // Get the river file we want to simulate as command line argument.
     std::string riverFile = "assets/river.bmp";
-    if (argc > 1)
-        riverFile = argv[1];
+    if (!files.empty())
+        riverFile = files[0];
+
+    // The autotuner tunes for the size of the river file.
+    if (autotune) {
+        return runHidden("LBM autotune", [&]( GLRenderer& renderer ) {
+            return runAutotune(renderer, riverFile, waterLevel,
+                               tuneCache.empty() ? tuneCachePath() : tuneCache,
+                               tuneSteps);
+        });
+    }
+
+    // A decomposed run creates a context per slab in the worker processes.
+    // The slabs only exchange the streamed f_i values, while the shallow
+    // water model also reads the depth and bed of its neighbours, and the
+    // suspended sediment their concentration.
+    if (slabs > 0) {
+        if (model == LatticeBoltzmann::Model::ShallowWater) {
+            print("The shallow water model is not available with --slabs");
+            print("~end~");
+            return 1;
+        }
+        if (suspendedSediment) {
+            print("The suspended sediment is not available with --slabs");
+            print("~end~");
+            return 1;
+        }
+        const int code = runDecomposed(riverFile, waterLevel, slabs,
+                                       slabSteps, seed, viscosity,
+                                       collision, smagorinsky);
+        print("~end~");
+        return code;
+    }
 
+    // The experiment script is checked before anything is set up.
+    std::unique_ptr<Script> script;
+    if (!scriptFile.empty()) {
+        script.reset(new Script());
+        if (!script->load(scriptFile)) {
+            print("~end~");
+            return 1;
+        }
+    }
 
-    // Create a window and the renderer object.
-    Window window = createOpenGLWindow("Bumpy 3: LBM River Flowinator");
+    // Create a window and the renderer object. A headless run uses a
+    // hidden window instead.
+    const bool headless = headlessSteps > 0;
+    Window window = createOpenGLWindow("Bumpy 3: LBM River Flowinator",
+                                       400, 400, headless);
     GLRenderer renderer = GLRenderer();
 
     // Store the input data here.
     InputData input;
 
+    // Fit the storage of the run in the memory budget, before anything is
+    // allocated, and report it. The derived fields are allocated when they
+    // are saved or shown.
+    StoragePlan plan;
+    plan.lattice.model = model;
+    plan.lattice.sediment = suspendedSediment;
+    plan.lattice.statistics = statsEvery > 0;
+    plan.lattice.derived = derivedEvery > 0 ||
+                           view != LatticeBoltzmann::View::Velocity;
+    plan.lattice.refineFactor = std::max(1u, refine);
+    plan.lattice.patchSize = refineSize;
+    plan.saveDerived = derivedEvery > 0;
+    MapImporter header = MapImporter(riverFile, waterLevel);
+    if (header.isOpen()) {
+        const int width = header.getWidth(), height = header.getHeight();
+
+        // The capture is by default at the size of the lattice, and the
+        // stream fitted in 640 x 640 pixels.
+        if (captureWidth <= 0 || captureHeight <= 0) {
+            captureWidth = width;
+            captureHeight = height;
+        }
+        if (streamWidth <= 0 || streamHeight <= 0) {
+            const float scale = 640.f / std::max(width, height);
+            streamWidth = std::max(1, (int) (width * scale));
+            streamHeight = std::max(1, (int) (height * scale));
+        }
+        if (!captureOutput.empty()) {
+            plan.captureWidth = captureWidth;
+            plan.captureHeight = captureHeight;
+        }
+        if (!streamAddress.empty()) {
+            plan.streamWidth = streamWidth;
+            plan.streamHeight = streamHeight;
+        }
+
+        if (!fitMemory(width, height, memoryBudget > 0 ? memoryBudget
+                                                       : deviceMemory(),
+                       plan)) {
+            header.close();
+            renderer.close();
+            destroyWindow(window);
+            print("~end~");
+            return 1;
+        }
+        printMemory(width, height, memoryUsage(width, height, plan));
+    }
+    header.close();
+
     // Create the LBM executor.
-    LatticeBoltzmann lbm = LatticeBoltzmann(renderer, riverFile);
+    LatticeBoltzmann lbm = LatticeBoltzmann(renderer, riverFile, waterLevel,
+                                            model, relief);
+    lbm.setSeed(seed);
+    lbm.setViscosity(viscosity);
+    lbm.setCollision(collision);
+    lbm.setSmagorinsky(smagorinsky);
+    lbm.setSuspendedSediment(suspendedSediment);
+
+    // Use the tuned configuration of this device, if there is one. The
+    // fused display and the temporal blocking can also be set by hand.
+    TuneConfig tuning;
+    if (useTuning &&
+        loadTuning(tuneCache.empty() ? tuneCachePath() : tuneCache,
+                   lbm.getWidth(), lbm.getHeight(), tuning)) {
+        applyTuning(lbm, tuning);
+        print("Using the tuned framestep", tuning.framestep, "tile",
+              tuning.tileSize, "fused", tuning.fusedDisplay, "block",
+              tuning.blockSteps);
+    }
+    if (fusedDisplay) {
+        lbm.setFusedDisplay(true);
+    }
+    if (blockSteps > 0) {
+        lbm.setBlockSteps(blockSteps);
+    }
+    if (refine > 1) {
+        lbm.setRefinement(renderer, refine, refineSize, refineEvery);
+    }
+    lbm.setDerivedInterval(derivedEvery);
+    lbm.setView(view);
+
+    // Fields (and statistics and derived fields) are saved on a separate
+    // thread, with `S` or every `dumpEvery` frames. Two saves can be queued,
+    // unless the memory budget only fits one.
+    OutputThread output(window, lbm.getWidth(), lbm.getHeight(),
+                        dumpDir, plan.snapshots(), dumpPolicy);
+    unsigned nextDump = dumpEvery;
+
+    // The visualisation is captured every `captureEvery` frames, by default
+    // at the size of the lattice (see above).
+    std::unique_ptr<Capture> capture;
+    unsigned nextCapture = 0;
+    if (!captureOutput.empty()) {
+        if (captureWidth <= 0 || captureHeight <= 0) {
+            captureWidth = lbm.getWidth();
+            captureHeight = lbm.getHeight();
+        }
+        capture.reset(new Capture(captureOutput, captureWidth, captureHeight,
+                                  captureFps));
+    }
+
+    // The river is measured every `morphologyEvery` frames, by default
+    // logged next to the saved fields.
+    std::unique_ptr<Morphology> morphology;
+    unsigned nextMorphology = 0;
+    if (morphologyEvery > 0) {
+        if (morphologyOutput.empty()) {
+            morphologyOutput = dumpDir + "/morphology.csv";
+        }
+        morphology.reset(new Morphology(lbm.getWidth(), lbm.getHeight(),
+                                        morphologyOutput));
+    }
+
+    // The visualisation is streamed to viewers at most `streamFps` times
+    // per second, by default fitted in 640 x 640 pixels (see above). Without
+    // a window, the keys of the viewers are handled here, and the simulation
+    // runs in chunks of frames between which a frame can be streamed.
+    std::unique_ptr<Stream> stream;
+    const unsigned streamSteps = 100;
+    if (!streamAddress.empty()) {
+        if (streamWidth <= 0 || streamHeight <= 0) {
+            const float scale = 640.f / std::max(lbm.getWidth(),
+                                                 lbm.getHeight());
+            streamWidth = std::max(1, (int) (lbm.getWidth() * scale));
+            streamHeight = std::max(1, (int) (lbm.getHeight() * scale));
+        }
+        stream.reset(new Stream(streamAddress, streamWidth, streamHeight,
+                                streamFps));
+    }
+
+    // The timeline of the chosen frames is profiled.
+    if (!profileOutput.empty()) {
+        profiler::start(profileOutput, profileFrom, profileFrames);
+    }
 
 
     // We now update untill the window gets closed.
     while (!input.quit) {
+        profiler::frame(lbm.getFrame());
+        PROFILE_SCOPE("frame");
+
+        // Start the statistics once the flow has developed.
+        if (statsEvery > 0 && !lbm.hasStatistics() &&
+            lbm.getFrame() >= statsFrom) {
+            lbm.enableStatistics(statsEvery);
+        }
 
-        // Update the input (like key presses, window events) we got this frame.
-        updateInput(window, input);
+        if (headless) {
 
-        // Update the viewport if the window size has changed.
-        if (window.sizeChanged) {
-            window.sizeChanged = false;
-            renderer.updateViewport(window.width, window.height);
+            // The keys of the viewers and the script are pressed this
+            // frame only.
+            input.keyMap.clear();
+            if (stream) {
+                stream->pollKeys(input);
+            }
+            if (script) {
+                PROFILE_SCOPE("script");
+                script->run(renderer, lbm, input);
+            }
+            lbm.handleInput(renderer, input);
+
+            // Simulate up to the next output, or the next command.
+            unsigned target = input.quit ? 0 : headlessSteps;
+            if (script) target = std::min(target, script->nextFrame());
+            target = std::min(target, profiler::nextFrame());
+            if (dumpEvery > 0) target = std::min(target, nextDump);
+            if (capture) target = std::min(target, nextCapture);
+            if (morphology) target = std::min(target, nextMorphology);
+            if (statsEvery > 0 && !lbm.hasStatistics()) {
+                target = std::min(target, statsFrom);
+            }
+            if (stream) {
+                target = std::min(target, lbm.getFrame() + streamSteps);
+                if (lbm.isPaused()) {
+                    target = lbm.getFrame();
+                    SDL_Delay(10);
+                }
+            }
+            lbm.step(renderer, target - std::min(target, lbm.getFrame()));
+            input.quit = input.quit || lbm.getFrame() >= headlessSteps;
+        }
+        else {
+            // Update the input (like key presses, window events) we got
+            // this frame.
+            {
+                PROFILE_SCOPE("input");
+                updateInput(window, input);
+                if (stream) {
+                    stream->pollKeys(input);
+                }
+            }
+            if (script) {
+                PROFILE_SCOPE("script");
+                script->run(renderer, lbm, input);
+            }
+
+            // Update the viewport if the window size has changed.
+            if (window.sizeChanged) {
+                window.sizeChanged = false;
+                renderer.updateViewport(window.width, window.height);
+            }
+
+            // Clear the screen so we can draw the new frame.
+            renderer.clear(0.f, 0.f, 0.5f, 1.f);
+
+            // Update the LBM model (which also renders it).
+            PROFILE_SCOPE("update");
+            lbm.update(renderer, input, window.width, window.height);
         }
 
-        // Clear the screen so we can draw the new frame.
-        renderer.clear(0.f, 0.f, 0.5f, 1.f);
+        // Queue the fields to be saved.
+        if (input.keyMap[SDL_SCANCODE_S] == 2 ||
+            (dumpEvery > 0 && lbm.getFrame() >= nextDump)) {
+            PROFILE_SCOPE("queue fields");
+            output.queueFields(lbm);
+            output.queueStatistics(lbm);
+            if (derivedEvery > 0) {
+                lbm.updateDerived(renderer);
+                output.queueDerived(lbm);
+                renderer.renderToScreen();
+            }
+            if (dumpEvery > 0) {
+                nextDump = (lbm.getFrame() / dumpEvery + 1) * dumpEvery;
+            }
+        }
 
-        // Update the LBM model (which also renders it).
-        lbm.update(renderer, input, window.width, window.height);
+        // Capture the visualisation.
+        if (capture && lbm.getFrame() >= nextCapture) {
+            capture->capture(renderer, lbm);
+            nextCapture = (lbm.getFrame() / captureEvery + 1) * captureEvery;
+        }
+
+        // Measure the river.
+        if (morphology && lbm.getFrame() >= nextMorphology) {
+            PROFILE_SCOPE("morphology");
+            morphology->evaluate(lbm);
+            renderer.renderToScreen();
+            nextMorphology = (lbm.getFrame() / morphologyEvery + 1) *
+                             morphologyEvery;
+        }
+
+        // Stream the visualisation.
+        if (stream && stream->due()) {
+            stream->publish(renderer, lbm);
+        }
 
         // Swap the buffer we have rendered to with the display buffer.
-        SDL_GL_SwapWindow(window.sdlData);
+        if (!headless) {
+            PROFILE_SCOPE("swap");
+            SDL_GL_SwapWindow(window.sdlData);
+        }
     }
 
     // Shutdown, close everything neatly.
+    profiler::finish();
+    if (capture) {
+        capture->close();
+    }
+    if (stream) {
+        stream->close();
+    }
+    output.close();
+    if (morphology) {
+        morphology->close();
+    }
     lbm.close();
     renderer.close();
     destroyWindow(window);
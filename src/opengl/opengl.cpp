@@ -15,6 +15,7 @@
 
 #include <sstream>
 #include <fstream>
+#include <vector>
 
 using namespace pcs;
 
@@ -207,6 +208,7 @@ GLuint gl::compileShader( const std::string& source, GLenum type ) {
         switch (type) {
         case GL_VERTEX_SHADER: shaderName = "vertex"; break;
         case GL_FRAGMENT_SHADER: shaderName = "fragment"; break;
+        case GL_COMPUTE_SHADER: shaderName = "compute"; break;
         default: break;
         }
 
@@ -266,6 +268,38 @@ GLuint gl::compileProgram( const std::string& vertexSource,
     return programId;
 }
 
+GLuint gl::compileComputeProgram( const std::string& computeSource ) {
+
+    GLuint computeId = compileShader(computeSource, GL_COMPUTE_SHADER);
+    if (computeId == 0) {
+        return 0;
+    }
+
+    GLuint programId = glCreateProgram();
+    glAttachShader(programId, computeId);
+    glLinkProgram(programId);
+    glDetachShader(programId, computeId);
+    glDeleteShader(computeId);
+
+    GLint succes = GL_FALSE;
+    glGetProgramiv(programId, GL_LINK_STATUS, &succes);
+
+    if (succes == GL_FALSE) {
+        int maxLength = 0, actualLength = 0;
+        glGetProgramiv(programId, GL_INFO_LOG_LENGTH, &maxLength);
+        std::string infoLog(maxLength, 0);
+        glGetProgramInfoLog(programId, maxLength, &actualLength,
+                            (char*) infoLog.c_str());
+        glDeleteProgram(programId);
+
+        print(INFO_, "Failed to create an OpenGL compute program!");
+        print(INFO_, "GL program info: ", infoLog.substr(0, actualLength));
+        return 0;
+    }
+
+    return programId;
+}
+
 
 GLuint gl::genTexture( int width, int height, const float* data ) {
 
@@ -316,10 +350,8 @@ GLuint gl::genUTexture( int width, int height, const uint32_t* data ) {
 }
 
 
-GLuint gl::loadTexture( const std::string& filePath,
-                        int* widthPtr, int* heightPtr ) {
-
-
+bool gl::loadBitmap( const std::string& filePath, std::vector<float>& pixels,
+                     int* widthPtr, int* heightPtr ) {
 
     // Load the file.
     std::ifstream file(filePath, std::ios::binary);
@@ -327,7 +359,7 @@ GLuint gl::loadTexture( const std::string& filePath,
     if (!file) {
         print(INFO_, "Failed to load the texture at", "["+filePath+"]",
               "! Does it exists?");
-        return 0;
+        return false;
     }
 
     // Read the header of the bitmap.
@@ -350,7 +382,7 @@ GLuint gl::loadTexture( const std::string& filePath,
         height < 0) {                             // No upside down bitmaps.
 
         print(INFO_, "Bitmap type from", "["+filePath+"]", "is not supported!");
-        return 0;
+        return false;
     }
 
     // Find the row and image size of the bitmap.
@@ -364,8 +396,8 @@ GLuint gl::loadTexture( const std::string& filePath,
     file.close();
 
     // Convert the bitmap data to pixel data.
-    float* const pixels = new float[width * height * 4];
-    float* ptr = pixels;
+    pixels.resize(width * height * 4);
+    float* ptr = pixels.data();
 
     for (int y = 0; y < std::abs(height); ++y) {
         for (int x = 0; x < width; ++x) {
@@ -378,9 +410,26 @@ GLuint gl::loadTexture( const std::string& filePath,
     }
     delete[] source;
 
+    // 'Return' the width and height of the bitmap.
+    if (widthPtr != nullptr)
+        *widthPtr = width;
+    if (heightPtr != nullptr)
+        *heightPtr = height;
+
+    return true;
+}
+
+GLuint gl::loadTexture( const std::string& filePath,
+                        int* widthPtr, int* heightPtr ) {
+
+    std::vector<float> pixels;
+    int width, height;
+    if (!loadBitmap(filePath, pixels, &width, &height)) {
+        return 0;
+    }
+
     // Create the texture using the acquired pixel data.
-    GLuint texture = gl::genTexture(width, height, pixels);
-    delete[] pixels;
+    GLuint texture = gl::genTexture(width, height, pixels.data());
 
     // 'Return' the width and height of the texture.
     if (widthPtr != nullptr)
@@ -440,10 +489,18 @@ bool gl::checkErrors( const std::string& identifier ) {
 }
 
 
+// The directory relative paths are read from, see setResourceDirectory().
+static std::string resourceDirectory;
+
+void pcs::setResourceDirectory( const std::string& directory ) {
+    resourceDirectory = directory;
+}
+
 std::string pcs::readFile( const std::string& path ) {
 
     // Open the file and create a buffer to read it.
-    std::ifstream file(path);
+    std::ifstream file(resourceDirectory.empty() || path[0] == '/' ?
+                       path : resourceDirectory + "/" + path);
     std::stringstream buffer;
 
     // Read the file if it exists, and print an warning otherwise.
@@ -456,3 +513,29 @@ std::string pcs::readFile( const std::string& path ) {
         return "";
     }
 }
+
+std::string pcs::readShader( const std::string& path ) {
+
+    const std::string source = readFile(path);
+    const size_t slash = path.rfind('/');
+    const std::string directory = slash == std::string::npos ?
+                                  "" : path.substr(0, slash + 1);
+
+    // Replace every `#include "file"` line by the contents of the file.
+    std::stringstream input(source), output;
+    for (std::string line; std::getline(input, line);) {
+        const size_t start = line.find_first_not_of(" \t");
+        if (start != std::string::npos &&
+            line.compare(start, 9, "#include ") == 0) {
+            const size_t open = line.find('"', start);
+            const size_t close = line.find('"', open + 1);
+            if (open != std::string::npos && close != std::string::npos) {
+                output << readShader(directory +
+                                     line.substr(open + 1, close - open - 1));
+                continue;
+            }
+        }
+        output << line << "\n";
+    }
+    return output.str();
+}
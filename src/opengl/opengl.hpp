@@ -11,6 +11,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 #define GL_GLEXT_PROTOTYPES yes please
 #include <GL/gl.h>
@@ -240,8 +241,8 @@ namespace pcs {
          * printed to stdout.
          *
          * @param source The source code of the shader.
-         * @param type The GL shader type, which can be GL_VERTEX_SHADER
-         *             or GL_FRAGMENT_SHADER.
+         * @param type The GL shader type, which can be GL_VERTEX_SHADER,
+         *             GL_FRAGMENT_SHADER or GL_COMPUTE_SHADER.
          * @return The shader ID, or 0 if the compilation has failed.
          */
         GLuint compileShader( const std::string& source, GLenum type );
@@ -258,6 +259,16 @@ namespace pcs {
         GLuint compileProgram( const std::string& vertexSource,
                                const std::string& fragmentSource );
 
+        /**
+         * Compile an OpenGL program which consists of a glsl compute shader.
+         * Returns the program ID, or 0 if there are compilation or linkage
+         * errors, which are printed to stdout.
+         *
+         * @param computeSource The source of the compute shader.
+         * @return The program ID, or 0 if the compilation has failed.
+         */
+        GLuint compileComputeProgram( const std::string& computeSource );
+
         /**
          * Generate an OpenGL texture of width 'width' and height 'height'.
          * Pixel data can be supplied by setting 'data', and must be formated
@@ -276,6 +287,20 @@ namespace pcs {
         GLuint genUTexture( int width, int height,
                             const uint32_t* data = nullptr );
 
+        /**
+         * Load a bitmap file into host memory, formatted the same way as the
+         * pixel data for genTexture(): 4 floats per pixel in RGBA format,
+         * starting at the bottom row. Only 24 bit .bmp files are supported.
+         *
+         * @param filePath The path to the bitmap file.
+         * @param pixels Returns the pixel data.
+         * @param width Returns the width of the bitmap.
+         * @param height Returns the height of the bitmap.
+         * @return True if the bitmap was loaded, false otherwise.
+         */
+        bool loadBitmap( const std::string& filePath, std::vector<float>& pixels,
+                         int* width, int* height );
+
         /**
          * Load a texture from a file. Supported file formats are .bmp and .png.
          *
@@ -303,11 +328,34 @@ namespace pcs {
 
     /**
      * Read a binary file as an ascii string. (Included here because
-     * it is only used to read shader files in this project.)
+     * it is only used to read shader files in this project.) Relative paths
+     * are relative to the resource directory.
+     *
+     * @see pcs::setResourceDirectory()
      *
      * @param path The path to the file.
      * @return The file contents.
      */
     std::string readFile( const std::string& path );
 
+    /**
+     * Read a shader with `readFile()`, replacing every `#include "file"`
+     * line by the contents of the file, relative to the directory of the
+     * shader. This way the shaders can share code.
+     *
+     * @param path The path to the shader.
+     * @return The shader source.
+     */
+    std::string readShader( const std::string& path );
+
+    /**
+     * Set the directory relative to which `readFile()` reads files, which
+     * should contain the `src` directory with the shaders. By default this
+     * is the working directory, which does not work for programs embedding
+     * the model elsewhere.
+     *
+     * @param directory The resource directory.
+     */
+    void setResourceDirectory( const std::string& directory );
+
 }
@@ -0,0 +1,240 @@
+/**
+ * The profiler for the CPU and GPU timeline. See profiler.hpp for details.
+ *
+ * @file profiler.cpp
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#include "profiler.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+#include "../print.hpp"
+
+using namespace pcs;
+
+
+std::atomic<bool> profiler::recording(false);
+
+namespace {
+
+    // A complete event, with times in microseconds since `origin`. The
+    // GPU events have thread 0.
+    struct Event {
+        const char* name;
+        double start, duration;
+        int thread;
+    };
+
+    // A GPU scope waiting for its timestamps.
+    struct Pending {
+        const char* name;
+        GLuint queries[2];
+    };
+
+    enum class State { Idle, Waiting, Recording, Done };
+
+    State state = State::Idle;
+    std::string tracePath;
+    unsigned firstFrame, lastFrame;
+
+    std::chrono::steady_clock::time_point origin;
+    double gpuOffset; // The CPU time minus the GPU time, in microseconds.
+
+    std::mutex mutex; // Guards `events`.
+    std::vector<Event> events;
+    std::vector<std::pair<double, unsigned>> frames;
+
+    // The GPU scopes are only used on the thread of the context.
+    std::deque<Pending> pending;
+    std::vector<GLuint> freeQueries;
+
+    std::atomic<int> threadCount(0);
+    thread_local int threadId = 0;
+}
+
+// The time since the start of the recording, in microseconds.
+static double now() {
+    return std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - origin).count();
+}
+
+// The thread of the events of this thread, numbered from 1 in order of
+// their first event.
+static int currentThread() {
+    if (threadId == 0) {
+        threadId = ++threadCount;
+    }
+    return threadId;
+}
+
+// Turn the finished timestamps into events, waiting for all of them if
+// `wait` is set.
+static void collect( bool wait ) {
+    while (!pending.empty()) {
+        Pending& scope = pending.front();
+        GLint available = GL_TRUE;
+        if (!wait) {
+            glGetQueryObjectiv(scope.queries[1], GL_QUERY_RESULT_AVAILABLE,
+                               &available);
+        }
+        if (!available) {
+            break;
+        }
+
+        GLuint64 times[2];
+        glGetQueryObjectui64v(scope.queries[0], GL_QUERY_RESULT, &times[0]);
+        glGetQueryObjectui64v(scope.queries[1], GL_QUERY_RESULT, &times[1]);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            events.push_back({scope.name, times[0] / 1000.0 + gpuOffset,
+                              (times[1] - times[0]) / 1000.0, 0});
+        }
+        freeQueries.insert(freeQueries.end(), scope.queries,
+                           scope.queries + 2);
+        pending.pop_front();
+    }
+}
+
+// Write the recorded events as a Chrome trace.
+static bool write() {
+    std::ofstream file(tracePath);
+    file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    file << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+            "\"tid\": 0, \"args\": {\"name\": \"GPU\"}}";
+    for (int thread = 1; thread <= threadCount; ++thread) {
+        file << ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+                "\"tid\": " << thread << ", \"args\": {\"name\": \""
+             << (thread == 1 ? "main" : "thread " + toString(thread))
+             << "\"}}";
+    }
+
+    file.precision(3);
+    file << std::fixed;
+    for (const Event& event : events) {
+        file << ",\n{\"name\": \"" << event.name << "\", \"ph\": \"X\", "
+                "\"pid\": 1, \"tid\": " << event.thread << ", \"ts\": "
+             << event.start << ", \"dur\": " << event.duration << "}";
+    }
+    for (const std::pair<double, unsigned>& frame : frames) {
+        file << ",\n{\"name\": \"frame\", \"ph\": \"C\", \"pid\": 1, "
+                "\"ts\": " << frame.first << ", \"args\": {\"frame\": "
+             << frame.second << "}}";
+    }
+    file << "\n]}\n";
+    return (bool) file;
+}
+
+
+void profiler::start( const std::string& path, unsigned first,
+                      unsigned count ) {
+    tracePath = path;
+    firstFrame = first;
+    lastFrame = first + count;
+    state = State::Waiting;
+
+    // The thread which starts the profiler is shown as the main thread.
+    currentThread();
+}
+
+void profiler::frame( unsigned frame ) {
+
+    if (state == State::Waiting && frame >= firstFrame) {
+
+        // Align the GPU timestamps to the CPU time.
+        origin = std::chrono::steady_clock::now();
+        GLint64 gpuTime;
+        glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+        gpuOffset = now() - gpuTime / 1000.0;
+
+        state = State::Recording;
+        recording = true;
+    }
+    if (state != State::Recording) {
+        return;
+    }
+
+    if (frame >= lastFrame) {
+        finish();
+        return;
+    }
+    frames.push_back({now(), frame});
+    collect(false);
+}
+
+unsigned profiler::nextFrame() {
+    if (state == State::Waiting) return firstFrame;
+    if (state == State::Recording) return lastFrame;
+    return UINT_MAX;
+}
+
+void profiler::finish() {
+
+    if (state == State::Waiting) {
+        print("The profiled frames were not reached, no trace was written");
+    }
+    if (state != State::Recording) {
+        return;
+    }
+
+    recording = false;
+    state = State::Done;
+    collect(true);
+    if (!freeQueries.empty()) {
+        glDeleteQueries(freeQueries.size(), freeQueries.data());
+        freeQueries.clear();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (write()) {
+        print("Wrote", events.size(), "profiled events of frames", firstFrame,
+              "to", lastFrame, "to", tracePath);
+    }
+    else {
+        print(INFO_, "Failed to write", tracePath);
+    }
+    events.clear();
+    frames.clear();
+}
+
+
+void profiler::Scope::begin( const char* name_ ) {
+    name = name_;
+    startTime = now();
+}
+
+void profiler::Scope::end() {
+    const double endTime = now();
+    std::lock_guard<std::mutex> lock(mutex);
+    if (recording) {
+        events.push_back({name, startTime, endTime - startTime,
+                          currentThread()});
+    }
+}
+
+void profiler::GPUScope::begin( const char* name_ ) {
+    name = name_;
+    if (freeQueries.size() < 2) {
+        freeQueries.resize(freeQueries.size() + 2);
+        glGenQueries(2, &freeQueries[freeQueries.size() - 2]);
+    }
+    queries[0] = freeQueries.back();
+    freeQueries.pop_back();
+    queries[1] = freeQueries.back();
+    freeQueries.pop_back();
+    glQueryCounter(queries[0], GL_TIMESTAMP);
+}
+
+void profiler::GPUScope::end() {
+    glQueryCounter(queries[1], GL_TIMESTAMP);
+    pending.push_back({name, {queries[0], queries[1]}});
+}
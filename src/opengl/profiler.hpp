@@ -0,0 +1,119 @@
+/**
+ * A profiler for the CPU and GPU timeline, which writes Chrome trace files.
+ *
+ * @file profiler.hpp
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#pragma once
+
+#include <atomic>
+#include <string>
+
+#include "opengl.hpp"
+
+
+// Profile the rest of the enclosing scope on the CPU, or on the GPU (which
+// records timestamp queries around the OpenGL commands of the scope). The
+// name must be a string literal.
+#define PROFILE_NAME_(line) profileScope_##line
+#define PROFILE_LINE_(line) PROFILE_NAME_(line)
+#define PROFILE_SCOPE(name) \
+    pcs::profiler::Scope PROFILE_LINE_(__LINE__)(name)
+#define PROFILE_GPU(name) \
+    pcs::profiler::GPUScope PROFILE_LINE_(__LINE__)(name)
+
+
+namespace pcs {
+
+    namespace profiler {
+
+        // If events are being recorded. Only read this through the macros
+        // and `isRecording()`.
+        extern std::atomic<bool> recording;
+
+        inline bool isRecording() {
+            return recording.load(std::memory_order_acquire);
+        }
+
+        /**
+         * Start profiling a window of frames. Events are recorded from the
+         * first call to `frame()` with a frame of at least `first`, up to
+         * the first call with a frame of at least `first + count`, after
+         * which the trace is written.
+         *
+         * The trace is a Chrome trace event JSON file, which can be opened
+         * in chrome://tracing or https://ui.perfetto.dev. CPU scopes are
+         * shown per thread, and GPU scopes on their own track, aligned to
+         * the CPU time.
+         *
+         * @param path The path of the trace file
+         * @param first The first frame to record
+         * @param count The amount of frames to record
+         */
+        void start( const std::string& path, unsigned first, unsigned count );
+
+        /**
+         * Mark the start of a frame of the main loop, which starts or ends
+         * the recording, and collects the finished GPU timestamps. Must be
+         * called from the thread of the OpenGL context.
+         *
+         * @param frame The current frame of the simulation
+         */
+        void frame( unsigned frame );
+
+        /**
+         * Get the next frame at which `frame()` starts or ends the
+         * recording, so a run without a window can stop there.
+         *
+         * @return The frame, or the largest value if there is none.
+         */
+        unsigned nextFrame();
+
+        /**
+         * Stop the recording, if it runs, and write the trace.
+         */
+        void finish();
+
+        /**
+         * Record an event on the current thread, as a Chrome trace complete
+         * event. Use the `PROFILE_SCOPE` macro instead.
+         */
+        class Scope {
+        public:
+            inline Scope( const char* name_ ) : name(nullptr) {
+                if (isRecording()) begin(name_);
+            }
+            inline ~Scope() {
+                if (name != nullptr) end();
+            }
+        private:
+            void begin( const char* name );
+            void end();
+            const char* name;
+            double startTime;
+        };
+
+        /**
+         * Record an event on the GPU, with a timestamp query before and
+         * after. Use the `PROFILE_GPU` macro instead.
+         */
+        class GPUScope {
+        public:
+            inline GPUScope( const char* name_ ) : name(nullptr) {
+                if (isRecording()) begin(name_);
+            }
+            inline ~GPUScope() {
+                if (name != nullptr) end();
+            }
+        private:
+            void begin( const char* name );
+            void end();
+            const char* name;
+            GLuint queries[2];
+        };
+    }
+}
@@ -10,7 +10,9 @@
 
 #pragma once
 
+#include <cstdlib>
 #include <sstream>
+#include <string>
 #include <iostream>
 #include <typeinfo>
 #include <iomanip>
@@ -70,6 +72,24 @@ std::string toString( const T& it ) {
     return ss.str();
 }
 
+// Parse a number, returning false if `text` is not entirely a number.
+inline bool parseNumber( const std::string& text, double& value ) {
+    char* end;
+    value = std::strtod(text.c_str(), &end);
+    return !text.empty() && *end == '\0';
+}
+
+// Parse a whole number which fits in an unsigned int, the same way.
+inline bool parseNumber( const std::string& text, unsigned& value ) {
+    double number;
+    if (!parseNumber(text, number) || number < 0 || number > 4294967295.0 ||
+        number != (unsigned) number) {
+        return false;
+    }
+    value = (unsigned) number;
+    return true;
+}
+
 /** A macro to add to logging functions, so that useful info, like the file
  * and line number, will be remembered. */
 #define INFO_ std::string(__func__) + "() at " + __FILE__ + ":" + toString(__LINE__) + ":"
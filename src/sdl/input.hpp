@@ -27,10 +27,10 @@ namespace pcs {
     struct InputData {
 
         // If the size of the window has changed.
-        bool windowSizeChanged;
+        bool windowSizeChanged = false;
 
         // If and exit event was received and we should shut down.
-        bool quit;
+        bool quit = false;
 
         // And keyboard input map, where the value corresponding to a key key
         // is 2 if the button was pressed this frame, 1 if the button is held
@@ -38,7 +38,7 @@ namespace pcs {
         std::map<int, char> keyMap;
 
         // The x and y position of the mouse on the screen.
-        int cursorX, cursorY;
+        int cursorX = 0, cursorY = 0;
     };
 
     /**
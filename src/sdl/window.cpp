@@ -15,7 +15,8 @@
 using namespace pcs;
 
 
-Window pcs::createOpenGLWindow( const std::string& title, int width, int height ) {
+Window pcs::createOpenGLWindow( const std::string& title, int width, int height,
+                                bool hidden ) {
 
     Window window;
     window.width = width;
@@ -33,7 +34,8 @@ Window pcs::createOpenGLWindow( const std::string& title, int width, int height
                                       SDL_WINDOWPOS_CENTERED,
                                       SDL_WINDOWPOS_CENTERED,
                                       window.width, window.height,
-                                      SDL_WINDOW_SHOWN |
+                                      (hidden ? SDL_WINDOW_HIDDEN
+                                              : SDL_WINDOW_SHOWN) |
                                       SDL_WINDOW_RESIZABLE |
                                       SDL_WINDOW_OPENGL);
 
@@ -34,6 +34,8 @@ namespace pcs {
      * Create a SDL window along with an OpenGL context bound to this window.
      * This functions also initialises SDL, so this needs not be done
      * independently. A title, width and height of the window can be specified.
+     * A hidden window can be created for runs without any visual output, in
+     * which case the window only serves to own the OpenGL context.
      * Windows should be destroyed using the destroyWindow() function below.
      *
      * @see pcs::Window
@@ -42,9 +44,11 @@ namespace pcs {
      * @param title The title of the window.
      * @param width The width of the window.
      * @param height The height of the window.
+     * @param hidden If the window should be hidden.
      * @return A Window object storing the data of the created window.
      */
-    Window createOpenGLWindow( const std::string& title, int width = 400, int height = 400 );
+    Window createOpenGLWindow( const std::string& title, int width = 400, int height = 400,
+                               bool hidden = false );
 
     /**
      * Destroy and free a window.
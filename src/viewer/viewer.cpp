@@ -0,0 +1,275 @@
+/**
+ * A viewer for the stream of a running simulation (see stream.hpp), for
+ * watching runs without a window, like runs on a remote machine through an
+ * SSH tunnel.
+ *
+ * Usage: ./build/viewer.o {{port|socket}}
+ *
+ * The arrow keys pan, - and = zoom out and in, and 0 shows the whole
+ * lattice. The keys Q, W, E, R, T, P, F, G, O and A are sent to the
+ * simulation, where they do the same as in its window.
+ *
+ * @file viewer.cpp
+ * @author Jurriaan van den Berg
+ * @author Maxim van den Berg
+ * @author Melvin Seitner
+ * @date 19-10-2026
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <SDL2/SDL.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../print.hpp"
+#include "../sdl/window.hpp"
+#include "../sdl/input.hpp"
+#include "../opengl/opengl.hpp"
+#include "../lbm/stream.hpp"
+
+using namespace pcs;
+
+
+// Connect to a local TCP port, or a Unix domain socket. Returns -1 on
+// failure.
+static int connectTo( const std::string& address ) {
+
+    int fd;
+    if (!address.empty() &&
+        address.find_first_not_of("0123456789") == std::string::npos) {
+        sockaddr_in remote;
+        std::memset(&remote, 0, sizeof remote);
+        remote.sin_family = AF_INET;
+        remote.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        remote.sin_port = htons(std::stoi(address));
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (connect(fd, (sockaddr*) &remote, sizeof remote) != 0) {
+            close(fd);
+            return -1;
+        }
+    }
+    else {
+        sockaddr_un remote;
+        std::memset(&remote, 0, sizeof remote);
+        remote.sun_family = AF_UNIX;
+        std::strncpy(remote.sun_path, address.c_str(),
+                     sizeof remote.sun_path - 1);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (connect(fd, (sockaddr*) &remote, sizeof remote) != 0) {
+            close(fd);
+            return -1;
+        }
+    }
+
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    return fd;
+}
+
+// Apply the run length encoded delta of a frame to the pixels, see
+// `StreamHeader`. Returns false if the data is malformed.
+static bool decode( const uint8_t* data, size_t size,
+                    std::vector<uint8_t>& pixels ) {
+    size_t i = 0, p = 0;
+    while (i + 4 <= size) {
+        const size_t zeros = data[i] | data[i + 1] << 8;
+        const size_t literals = data[i + 2] | data[i + 3] << 8;
+        i += 4;
+        p += zeros;
+        if (p + literals > pixels.size() || i + literals > size) {
+            return false;
+        }
+        for (size_t j = 0; j < literals; ++j) {
+            pixels[p++] ^= data[i++];
+        }
+    }
+    return i == size;
+}
+
+
+int main( int argc, char** argv ) {
+
+    print("~start~");
+    if (argc < 2) {
+        print("Usage:", argv[0], "{{port|socket}}");
+        return 1;
+    }
+
+    const int fd = connectTo(argv[1]);
+    if (fd < 0) {
+        print("Failed to connect to", argv[1]);
+        return 1;
+    }
+
+    Window window = createOpenGLWindow("LBM viewer", 800, 600);
+    GLRenderer renderer = GLRenderer();
+    renderer.updateViewport(window.width, window.height);
+    InputData input;
+
+    // The last frame, and the region to show, which is sent to the
+    // simulation when it changes.
+    StreamHeader header;
+    std::memset(&header, 0, sizeof header);
+    std::vector<uint8_t> pixels;
+    GLuint texture = 0;
+    int region[4] = {0, 0, 0, 0};
+    bool hasRegion = false;
+
+    auto sendLine = [&]( const std::string& line ) {
+        const std::string data = line + "\n";
+        if (send(fd, data.data(), data.size(), MSG_NOSIGNAL) < 0) {
+            input.quit = true;
+        }
+    };
+
+    std::vector<uint8_t> received;
+    while (!input.quit) {
+
+        updateInput(window, input);
+        if (window.sizeChanged) {
+            window.sizeChanged = false;
+            renderer.updateViewport(window.width, window.height);
+        }
+
+        // Receive the frames.
+        uint8_t buffer[65536];
+        ssize_t count;
+        while ((count = read(fd, buffer, sizeof buffer)) > 0) {
+            received.insert(received.end(), buffer, buffer + count);
+        }
+        if (count == 0) {
+            print("The simulation closed the stream");
+            break;
+        }
+
+        while (received.size() >= sizeof header) {
+            StreamHeader next;
+            std::memcpy(&next, received.data(), sizeof next);
+            if (std::memcmp(next.magic, "PCSV", 4) != 0) {
+                print("Invalid stream data");
+                input.quit = true;
+                break;
+            }
+            if (received.size() < sizeof next + next.size) {
+                break;
+            }
+
+            // A key frame starts from zeros, other frames from the last.
+            const size_t bytes = (size_t) next.width * next.height * 3;
+            if (next.flags & Stream::KeyFrame) {
+                pixels.assign(bytes, 0);
+            }
+            if (pixels.size() == bytes &&
+                decode(received.data() + sizeof next, next.size, pixels)) {
+                if (texture == 0 || next.width != header.width ||
+                    next.height != header.height) {
+                    glDeleteTextures(1, &texture);
+                    texture = gl::genTexture(next.width, next.height);
+                }
+                glBindTexture(GL_TEXTURE_2D, texture);
+                glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, next.width,
+                                next.height, GL_RGB, GL_UNSIGNED_BYTE,
+                                pixels.data());
+                glBindTexture(GL_TEXTURE_2D, 0);
+                header = next;
+            }
+            received.erase(received.begin(),
+                           received.begin() + sizeof next + next.size);
+
+            if (!hasRegion) {
+                std::copy(header.region, header.region + 4, region);
+                hasRegion = true;
+            }
+
+            const char* views[] = {"velocity", "vorticity", "strain rate",
+                                   "wall shear"};
+            const std::string title = "LBM viewer - frame " +
+                toString(header.frame) + ", " +
+                toString((int) header.mlups) + " MLUPS, " +
+                views[(header.flags >> 8) % 4] +
+                (header.flags & Stream::Paused ? ", paused" : "");
+            SDL_SetWindowTitle(window.sdlData, title.c_str());
+        }
+
+        // Send the toggles to the simulation.
+        for (const char* key = "QWERTPFGOA"; *key != '\0'; ++key) {
+            if (input.keyMap[SDL_SCANCODE_A + (*key - 'A')] == 2) {
+                sendLine(std::string("key ") + *key);
+            }
+        }
+
+        // Pan and zoom the region.
+        if (hasRegion) {
+            int changed[4];
+            std::copy(region, region + 4, changed);
+            const int stepX = std::max(1, region[2] / 20);
+            const int stepY = std::max(1, region[3] / 20);
+            if (input.keyMap[SDL_SCANCODE_LEFT]) changed[0] -= stepX;
+            if (input.keyMap[SDL_SCANCODE_RIGHT]) changed[0] += stepX;
+            if (input.keyMap[SDL_SCANCODE_DOWN]) changed[1] -= stepY;
+            if (input.keyMap[SDL_SCANCODE_UP]) changed[1] += stepY;
+            if (input.keyMap[SDL_SCANCODE_EQUALS] == 2 && region[2] > 8) {
+                changed[0] += region[2] / 4;
+                changed[1] += region[3] / 4;
+                changed[2] = region[2] / 2;
+                changed[3] = region[3] / 2;
+            }
+            if (input.keyMap[SDL_SCANCODE_MINUS] == 2) {
+                changed[0] -= region[2] / 2;
+                changed[1] -= region[3] / 2;
+                changed[2] = region[2] * 2;
+                changed[3] = region[3] * 2;
+            }
+            if (input.keyMap[SDL_SCANCODE_0] == 2) {
+                changed[0] = changed[1] = 0;
+                changed[2] = header.latticeWidth;
+                changed[3] = header.latticeHeight;
+            }
+            if (!std::equal(region, region + 4, changed)) {
+                std::copy(changed, changed + 4, region);
+                sendLine("view " + toString(region[0]) + " " +
+                         toString(region[1]) + " " + toString(region[2]) +
+                         " " + toString(region[3]));
+            }
+        }
+
+        // Show the frame as large as possible.
+        renderer.clear(0.f, 0.f, 0.5f, 1.f);
+        if (texture != 0) {
+            const float scale = std::min((float) window.width / header.width,
+                                         (float) window.height /
+                                         header.height);
+            renderer.renderTexture(texture,
+                                   (window.width - header.width * scale) / 2,
+                                   (window.height - header.height * scale) / 2,
+                                   header.width * scale,
+                                   header.height * scale);
+        }
+
+        // Show the settings, as in the window of the simulation.
+        constexpr int size = 10;
+        for (int i = 0; i < 4; i++) {
+            if (header.flags & (1 << i)) {
+                renderer.setRenderColor(i % 2, i % 3, (i+1) % 2);
+                renderer.renderRectangle(size*i, 0, size, size);
+            }
+        }
+
+        SDL_GL_SwapWindow(window.sdlData);
+        SDL_Delay(10);
+    }
+
+    close(fd);
+    glDeleteTextures(1, &texture);
+    renderer.close();
+    destroyWindow(window);
+    print("~end~");
+    return 0;
+}